@@ -23,12 +23,17 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <denali/contour_tree.h>
+#include <denali/external.h>
 #include <denali/fileio.h>
 
 // the following two functions are pasted from a stack overflow post
@@ -49,11 +54,214 @@ bool cmdOptionExists(char** begin, char** end, const std::string& option)
     return std::find(begin, end, option) != end;
 }
 
+
+// reads a positive integer option, returning false if it is malformed
+bool parsePositiveOption(const char* arg, unsigned long int& value)
+{
+    char* err;
+    long int n = strtol(arg, &err, 10);
+
+    if (*err != 0 || n < 1) {
+        return false;
+    }
+
+    value = n;
+    return true;
+}
+
+
+// reads the --compress option into binary tree flags, returning false if it
+// names no known encoding
+bool parseCompressOption(const char* arg, boost::uint32_t& flags)
+{
+    std::string encoding(arg);
+    if (encoding == "lossless") {
+        flags = denali::BINARY_TREE_COMPRESSED_MEMBERS;
+    } else if (encoding == "float32") {
+        flags = denali::BINARY_TREE_COMPRESSED_MEMBERS |
+                denali::BINARY_TREE_FLOAT32_VALUES;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// computes the contour tree and writes it, and possibly the join and split
+// trees, to disk
+template <typename ScalarSimplicialComplex, typename ContourTreeAlgorithm>
+void computeAndWriteTrees(
+    const ScalarSimplicialComplex& plex,
+    ContourTreeAlgorithm& algorithm,
+    const char* tree_file,
+    const char* join_file,
+    const char* split_file,
+    bool binary,
+    boost::uint32_t binary_flags)
+{
+    denali::ContourTree contour_tree =
+        denali::ContourTree::compute(plex, algorithm);
+
+    if (join_file)
+    {
+        denali::writeJoinSplitTreeFile(join_file, algorithm.getJoinTree(), plex);
+    }
+
+    if (split_file)
+    {
+        denali::writeJoinSplitTreeFile(split_file, algorithm.getSplitTree(), plex);
+    }
+
+    // write it to disk
+    if (binary)
+    {
+        denali::writeBinaryContourTreeFile(tree_file, contour_tree, binary_flags);
+    }
+    else
+    {
+        denali::writeContourTreeFile(tree_file, contour_tree);
+    }
+}
+
+// writes the component label of each vertex, one per line
+void writeComponentFile(const char* filename, const std::vector<unsigned int>& labels)
+{
+    std::ofstream fh(filename);
+    if (!fh) {
+        throw std::runtime_error(
+                std::string("Couldn't open file '") + filename + "'");
+    }
+
+    for (size_t i=0; i<labels.size(); ++i) {
+        fh << labels[i] << "\n";
+    }
+}
+
+// copies a contour tree computed on a component into a new tree, giving
+// each vertex its index in the whole complex
+denali::ContourTree relabelContourTree(
+    const denali::ContourTree& tree,
+    const std::vector<unsigned int>& ids)
+{
+    typedef denali::ContourTree::Graph Graph;
+    typedef Graph::Member Member;
+    typedef Graph::Members Members;
+
+    boost::shared_ptr<Graph> graph(new Graph);
+    graph->reserve(tree.numberOfNodes(), tree.numberOfEdges());
+
+    for (denali::NodeIterator<denali::ContourTree> it(tree); !it.done(); ++it)
+    {
+        Graph::Node node = graph->addNode(ids[tree.getID(it.node())],
+                                          tree.getValue(it.node()));
+
+        // the first member of a node is the node itself
+        const Members& members = tree.getNodeMembers(it.node());
+        for (size_t i=1; i<members.size(); ++i) {
+            graph->insertNodeMember(node,
+                    Member(ids[members[i].getID()], members[i].getValue()));
+        }
+    }
+
+    for (denali::EdgeIterator<denali::ContourTree> it(tree); !it.done(); ++it)
+    {
+        Graph::Edge edge = graph->addEdge(
+                graph->getNode(ids[tree.getID(tree.u(it.edge()))]),
+                graph->getNode(ids[tree.getID(tree.v(it.edge()))]));
+
+        const Members& members = tree.getEdgeMembers(it.edge());
+        Members relabelled;
+        relabelled.reserve(members.size());
+        for (Members::const_iterator m_it = members.begin();
+                m_it != members.end(); ++m_it) {
+            relabelled.push_back(Member(ids[m_it->getID()], m_it->getValue()));
+        }
+        graph->setEdgeMembers(edge, relabelled);
+    }
+
+    return denali::ContourTree::fromPrecomputed(graph);
+}
+
+// computes the contour tree of each connected component separately, writing
+// the tree of component k to "<tree_file>.<k>". The vertices keep their
+// indices in the whole complex
+void computeAndWriteComponentTrees(
+    const denali::CompactScalarSimplicialComplex& plex,
+    const std::vector<unsigned int>& labels,
+    unsigned int n_components,
+    const char* tree_file,
+    unsigned int n_threads,
+    bool binary,
+    boost::uint32_t binary_flags)
+{
+    typedef denali::CompactScalarSimplicialComplex Complex;
+
+    // the vertices of each component, in order, and their values
+    std::vector<std::vector<unsigned int> > ids(n_components);
+    std::vector<std::vector<double> > values(n_components);
+    std::vector<unsigned int> local(labels.size());
+    for (unsigned int i=0; i<labels.size(); ++i)
+    {
+        if (labels[i] == (unsigned int) -1) {
+            continue;
+        }
+
+        local[i] = ids[labels[i]].size();
+        ids[labels[i]].push_back(i);
+        values[labels[i]].push_back(plex.getValue(plex.getNode(i)));
+    }
+
+    // the edges of each component, as consecutive pairs of local indices.
+    // Bucketing them in one pass keeps the cost linear in the number of
+    // components
+    std::vector<std::vector<unsigned int> > edges(n_components);
+    for (denali::EdgeIterator<Complex> it(plex); !it.done(); ++it)
+    {
+        unsigned int u = plex.getID(plex.u(it.edge()));
+        unsigned int v = plex.getID(plex.v(it.edge()));
+        edges[labels[u]].push_back(local[u]);
+        edges[labels[u]].push_back(local[v]);
+    }
+    std::vector<unsigned int>().swap(local);
+
+    for (unsigned int k=0; k<n_components; ++k)
+    {
+        Complex component;
+        component.addNodes(&values[k][0], values[k].size());
+        component.freeze(edges[k].empty() ? 0 : &edges[k][0], edges[k].size() / 2);
+        std::vector<double>().swap(values[k]);
+        std::vector<unsigned int>().swap(edges[k]);
+
+        denali::CarrsAlgorithm carrs_algorithm;
+        carrs_algorithm.setNumberOfThreads(n_threads);
+
+        denali::ContourTree contour_tree = relabelContourTree(
+                denali::ContourTree::compute(component, carrs_algorithm), ids[k]);
+
+        std::stringstream filename;
+        filename << tree_file << "." << k;
+
+        if (binary)
+        {
+            denali::writeBinaryContourTreeFile(filename.str().c_str(),
+                                               contour_tree, binary_flags);
+        }
+        else
+        {
+            denali::writeContourTreeFile(filename.str().c_str(), contour_tree);
+        }
+    }
+}
+
 int main(int argc, char ** argv) try
 {
     std::string usage =
         "usage: ctree <vertex value file> <edge file> <tree file>\n"
         "             [--join <filename>] [--split <filename>]\n"
+        "             [--threads <n>] [--external <directory>]\n"
+        "             [--memory <megabytes>] [--bridge]\n"
+        "             [--components <filename>] [--binary]\n"
+        "             [--compress <lossless|float32>]\n"
         "\n"
         "Given the 1-skeleton of a simplicial complex in the form of a list of\n"
         "vertex values and a list of edges, prints the edges of the contour\n"
@@ -70,6 +278,9 @@ int main(int argc, char ** argv) try
         "\tthe vertices it connects, where indexing starts at zero. For more\n"
         "\tinformation, see the documentation, or an example edge file.\n"
         "\n"
+        "\tEither input file may instead be in the binary format produced by\n"
+        "\tctree-convert. The format is detected automatically.\n"
+        "\n"
         "<tree file>\n"
         "\tThe file in which to place the output. The file will be overwritten\n"
         "\twithout warning.\n"
@@ -79,7 +290,47 @@ int main(int argc, char ** argv) try
         "\tAlso output the join tree to the specified file.\n"
         "\n"
         "--split <filename>\n"
-        "\tAlso output the split tree to the specified file.\n";
+        "\tAlso output the split tree to the specified file.\n"
+        "\n"
+        "--threads <n>\n"
+        "\tUse up to n threads. With two or more, the vertices are sorted in\n"
+        "\tparallel and the join and split trees are computed concurrently.\n"
+        "\tVery large inputs are sorted in parallel even without this option.\n"
+        "\tThe output does not depend on n. Not available with --external.\n"
+        "\n"
+        "--external <directory>\n"
+        "\tKeep the edges on disk rather than in memory, so that edge files\n"
+        "\tlarger than memory can be processed. Sorted copies of the edges\n"
+        "\tare written to temporary files in the directory, which needs room\n"
+        "\tfor about 16 bytes per edge. The output is the same.\n"
+        "\n"
+        "--memory <megabytes>\n"
+        "\tWith --external, the memory used to buffer edges. Default: 1024.\n"
+        "\n"
+        "--bridge\n"
+        "\tIf the input graph is not connected, join its components at a\n"
+        "\tvirtual vertex below every other, rather than stopping with an\n"
+        "\terror. The vertex is given the next unused index, and the tree\n"
+        "\tof each component hangs from it by the component's minimum.\n"
+        "\n"
+        "--components <filename>\n"
+        "\tWrite the connected component of each vertex to the file, one\n"
+        "\tper line, numbered from zero in order of the first vertex. If\n"
+        "\tthe input graph is not connected, and --bridge is not given,\n"
+        "\tcompute the contour tree of each component instead of stopping\n"
+        "\twith an error: the tree of component k is written to the tree\n"
+        "\tfile with \".k\" appended, and the vertices keep their indices.\n"
+        "\tThis cannot be combined with --join or --split.\n"
+        "\n"
+        "--binary\n"
+        "\tWrite the contour tree in the binary .dtree format, which is much\n"
+        "\tfaster to load than the text format. ctree-convert converts\n"
+        "\tbetween the two.\n"
+        "\n"
+        "--compress <lossless|float32>\n"
+        "\tWrite the binary format with each edge's members delta-encoded,\n"
+        "\twhich is smaller. lossless keeps every value exactly; float32\n"
+        "\trounds them to single precision first. Implies --binary.\n";
 
     if (cmdOptionExists(argv, argv + argc, "-h") ||
             cmdOptionExists(argv, argv + argc, "--help")) {
@@ -95,49 +346,145 @@ int main(int argc, char ** argv) try
 
     char* join_file = getCmdOption(argv, argv + argc, "--join");
     char* split_file = getCmdOption(argv, argv + argc, "--split");
+    char* threads_arg = getCmdOption(argv, argv + argc, "--threads");
+    char* external_dir = getCmdOption(argv, argv + argc, "--external");
+    char* memory_arg = getCmdOption(argv, argv + argc, "--memory");
+    char* components_file = getCmdOption(argv, argv + argc, "--components");
+    bool bridge = cmdOptionExists(argv, argv + argc, "--bridge");
+    char* compress_arg = getCmdOption(argv, argv + argc, "--compress");
+    bool binary = cmdOptionExists(argv, argv + argc, "--binary");
+
+    boost::uint32_t binary_flags = 0;
+    if (compress_arg)
+    {
+        if (!parseCompressOption(compress_arg, binary_flags))
+        {
+            std::cerr << "Error: --compress expects lossless or float32."
+                      << std::endl;
+            return 1;
+        }
+        binary = true;
+    }
+
+    unsigned long int n_threads = 1;
+    if (threads_arg && !parsePositiveOption(threads_arg, n_threads))
+    {
+        std::cerr << "Error: --threads expects a positive integer." << std::endl;
+        return 1;
+    }
+
+    unsigned long int memory_mb = 1024;
+    if (memory_arg && !parsePositiveOption(memory_arg, memory_mb))
+    {
+        std::cerr << "Error: --memory expects a positive integer." << std::endl;
+        return 1;
+    }
+
+    if (external_dir && (bridge || components_file))
+    {
+        std::cerr << "Error: --bridge and --components cannot be used with "
+                  << "--external." << std::endl;
+        return 1;
+    }
+
+    if (external_dir && threads_arg)
+    {
+        std::cerr << "Error: --threads cannot be used with --external."
+                  << std::endl;
+        return 1;
+    }
 
     try {
-        // create a simplicial complex
-        denali::ScalarSimplicialComplex plex;
+        if (external_dir)
+        {
+            // keep only the vertices in memory; the edges are sorted on disk
+            denali::ExternalScalarSimplicialComplex plex(
+                    external_dir, (size_t) memory_mb << 20);
+
+            if (denali::isBinaryVertexFile(argv[1])) {
+                denali::readBinaryVertexFile(argv[1], plex);
+            } else {
+                denali::readSimplicialVertexFile(argv[1], plex);
+            }
+
+            if (denali::isBinaryEdgeFile(argv[2])) {
+                denali::readBinaryEdgeFile(argv[2], plex);
+            } else {
+                denali::readSimplicialEdgeFile(argv[2], plex);
+            }
+            plex.freeze();
+
+            // connectivity is checked while computing the tree
+            denali::ExternalCarrsAlgorithm external_algorithm;
+            computeAndWriteTrees(plex, external_algorithm, argv[3],
+                                 join_file, split_file, binary, binary_flags);
+            return 0;
+        }
+
+        // create a simplicial complex. It is never modified after loading,
+        // so we use the compact representation
+        denali::CompactScalarSimplicialComplex plex;
 
         // read the vertices and edges into it
-        denali::readSimplicialVertexFile(argv[1], plex);
-        denali::readSimplicialEdgeFile(argv[2], plex);
+        if (denali::isBinaryVertexFile(argv[1])) {
+            denali::readBinaryVertexFile(argv[1], plex);
+        } else {
+            denali::readSimplicialVertexFile(argv[1], plex);
+        }
 
-        // check that the input graph is connected
-        if (!denali::isConnected(plex))
-        {
-            std::cerr << "Error: The input graph is not connected." << std::endl;
-            return 1;
+        if (denali::isBinaryEdgeFile(argv[2])) {
+            denali::readBinaryEdgeFile(argv[2], plex);
+        } else {
+            denali::readSimplicialEdgeFile(argv[2], plex);
+            plex.freeze();
         }
 
-        // compute the contour tree
-        denali::CarrsAlgorithm carrs_algorithm;
+        // label the connected components of the input graph
+        std::vector<unsigned int> labels;
+        unsigned int n_components =
+            denali::labelConnectedComponents(plex, labels, n_threads);
 
-        if (join_file || split_file)
+        if (components_file)
         {
-            carrs_algorithm.setCopyJoinSplitTrees(true);
+            writeComponentFile(components_file, labels);
         }
 
-        denali::ContourTree contour_tree =
-            denali::ContourTree::compute(plex, carrs_algorithm);
+        if (n_components > 1 && !bridge)
+        {
+            if (!components_file)
+            {
+                std::cerr << "Error: The input graph is not connected. It has "
+                          << n_components << " components; use --bridge to "
+                          << "join them, or --components to compute a tree "
+                          << "for each." << std::endl;
+                return 1;
+            }
 
-        typedef denali::CarrsAlgorithm::JoinSplitTree JoinSplitTree;
+            if (join_file || split_file)
+            {
+                std::cerr << "Error: --join and --split cannot be used when "
+                          << "a tree is computed for each component."
+                          << std::endl;
+                return 1;
+            }
 
-        if (join_file)
-        {
-            const JoinSplitTree& join_tree = carrs_algorithm.getJoinTree();
-            denali::writeJoinSplitTreeFile(join_file, join_tree, plex);
+            computeAndWriteComponentTrees(plex, labels, n_components, argv[3],
+                                          n_threads, binary, binary_flags);
+            return 0;
         }
 
-        if (split_file)
+        if (n_components > 1)
         {
-            const JoinSplitTree& split_tree = carrs_algorithm.getSplitTree();
-            denali::writeJoinSplitTreeFile(split_file, split_tree, plex);
+            denali::bridgeComponents(plex, labels, n_components);
+            plex.freeze();
         }
 
-        // write it to disk
-        denali::writeContourTreeFile(argv[3], contour_tree);
+        // compute the contour tree
+        denali::CarrsAlgorithm carrs_algorithm;
+        carrs_algorithm.setNumberOfThreads(n_threads);
+
+        computeAndWriteTrees(plex, carrs_algorithm, argv[3], join_file, split_file,
+                             binary, binary_flags);
     }
     catch (std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
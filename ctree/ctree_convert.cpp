@@ -0,0 +1,118 @@
+// Copyright (c) 2014, Justin Eldridge, Mikhail Belkin, and Yusu Wang
+// at The Ohio State University. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <denali/fileio.h>
+
+// converts a contour tree between the text and binary formats, in whichever
+// direction the input calls for. If compression flags are given, the output
+// is always binary
+void convertTreeFile(const char* input, const char* output, boost::uint32_t flags)
+{
+    denali::ContourTreeSnapshot tree = denali::readContourTreeSnapshotFile(input);
+
+    if (flags) {
+        denali::writeBinaryContourTreeFile(output, tree, flags);
+    } else if (denali::isBinaryContourTreeFile(input)) {
+        // enough digits to read back every value exactly
+        denali::writeContourTreeFile(output, tree, 17);
+    } else {
+        denali::writeBinaryContourTreeFile(output, tree);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    std::string usage =
+        "usage: ctree-convert <vertex value file> <edge file>\n"
+        "                     <binary vertex file> <binary edge file>\n"
+        "       ctree-convert --tree <tree file> <output tree file>\n"
+        "                     [--compress <lossless|float32>]\n"
+        "\n"
+        "Converts the tab-delimited vertex value and edge files accepted by\n"
+        "ctree to the binary format. The binary files can be given to ctree\n"
+        "in place of the originals, and are much faster to load.\n"
+        "\n"
+        "With --tree, converts a contour tree from the text .tree format to\n"
+        "the binary .dtree format, or, given a binary tree, back to text.\n"
+        "No values are rounded in either direction, though the edges may be\n"
+        "listed in a different order.\n"
+        "\n"
+        "With --compress, the output is always a binary tree, with its\n"
+        "members delta-encoded. lossless keeps every value exactly; float32\n"
+        "rounds them to single precision.\n";
+
+    bool compress = argc == 6 && std::string(argv[4]) == "--compress";
+    if ((argc == 4 || compress) && std::string(argv[1]) == "--tree") {
+        boost::uint32_t flags = 0;
+        if (compress) {
+            std::string encoding(argv[5]);
+            if (encoding == "lossless") {
+                flags = denali::BINARY_TREE_COMPRESSED_MEMBERS;
+            } else if (encoding == "float32") {
+                flags = denali::BINARY_TREE_COMPRESSED_MEMBERS |
+                        denali::BINARY_TREE_FLOAT32_VALUES;
+            } else {
+                std::cerr << "Error: --compress expects lossless or float32."
+                          << std::endl;
+                return 1;
+            }
+        }
+
+        try {
+            convertTreeFile(argv[2], argv[3], flags);
+        }
+        catch (std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (argc != 5) {
+        std::cerr << usage << std::endl;
+        return 1;
+    }
+
+    try {
+        denali::BinaryVertexFileWriter vertex_writer(argv[3]);
+        denali::readSimplicialVertexFile(argv[1], vertex_writer);
+        vertex_writer.close();
+
+        denali::BinaryEdgeFileWriter edge_writer(argv[4]);
+        denali::readSimplicialEdgeFile(argv[2], edge_writer);
+        edge_writer.close();
+    }
+    catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
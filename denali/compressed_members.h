@@ -0,0 +1,468 @@
+// Copyright (c) 2014, Justin Eldridge, Mikhail Belkin, and Yusu Wang
+// at The Ohio State University. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef DENALI_COMPRESSED_MEMBERS_H
+#define DENALI_COMPRESSED_MEMBERS_H
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <denali/contour_tree.h>
+#include <denali/graph_iterators.h>
+#include <denali/graph_structures.h>
+
+namespace denali {
+
+////////////////////////////////////////////////////////////////////////////
+//
+// Member encoding
+//
+////////////////////////////////////////////////////////////////////////////
+
+/*
+ *  A compressed member list is a string of bytes holding, for each member,
+ *  the difference of its ID from the previous member's, and the difference
+ *  of the bit pattern of its value from the previous member's. The first
+ *  member is taken relative to zero. Each difference is zigzag encoded, so
+ *  that small negative numbers are small, and written as a varint: seven
+ *  bits per byte, least significant first, with the high bit set on every
+ *  byte but the last.
+ *
+ *  The bit patterns of doubles of the same sign are ordered as the doubles
+ *  are, so along a monotone arc, where the members are sorted by value,
+ *  neighboring values differ in the low bits only.
+ */
+
+/// \brief Encodes member values exactly, by their 64 bit patterns.
+struct LosslessValues
+{
+    typedef boost::uint64_t Bits;
+
+    static Bits toBits(double value)
+    {
+        Bits bits;
+        memcpy(&bits, &value, sizeof(double));
+        return bits;
+    }
+
+    static double fromBits(Bits bits)
+    {
+        double value;
+        memcpy(&value, &bits, sizeof(double));
+        return value;
+    }
+};
+
+
+/// \brief Encodes member values rounded to single precision.
+/*!
+ *  Values keep about seven significant digits, and take roughly half the
+ *  space of lossless ones.
+ */
+struct Float32Values
+{
+    typedef boost::uint32_t Bits;
+
+    static Bits toBits(double value)
+    {
+        float single = (float) value;
+        Bits bits;
+        memcpy(&bits, &single, sizeof(float));
+        return bits;
+    }
+
+    static double fromBits(Bits bits)
+    {
+        float single;
+        memcpy(&single, &bits, sizeof(float));
+        return single;
+    }
+};
+
+
+/// \brief Appends the zigzag varint encoding of `value - previous` to `bytes`.
+template <typename UInt>
+void appendVarintDelta(std::vector<unsigned char>& bytes, UInt value, UInt previous)
+{
+    const int top_bit = 8 * sizeof(UInt) - 1;
+
+    UInt delta = value - previous;
+    UInt zigzag = (delta << 1) ^ (UInt) (0 - (delta >> top_bit));
+
+    while (zigzag >= 0x80) {
+        bytes.push_back((unsigned char) (zigzag | 0x80));
+        zigzag >>= 7;
+    }
+    bytes.push_back((unsigned char) zigzag);
+}
+
+
+/// \brief Reads a delta written by appendVarintDelta(), and applies it to `previous`.
+/*!
+ *  \returns The position just past the encoded delta.
+ *
+ *  \throws std::runtime_error if the varint is longer than a UInt can
+ *  hold, as happens when the bytes are corrupt.
+ */
+template <typename UInt>
+const unsigned char* readVarintDelta(const unsigned char* bytes, UInt& previous)
+{
+    const int width = 8 * sizeof(UInt);
+
+    UInt zigzag = 0;
+    int shift = 0;
+    while (*bytes & 0x80) {
+        zigzag |= (UInt) (*bytes++ & 0x7f) << shift;
+        shift += 7;
+        if (shift >= width) {
+            throw std::runtime_error("A compressed member is malformed.");
+        }
+    }
+    zigzag |= (UInt) *bytes++ << shift;
+
+    previous += (zigzag >> 1) ^ (UInt) (0 - (zigzag & 1));
+    return bytes;
+}
+
+
+/// \brief Appends the encoding of a member to `bytes`.
+/*!
+ *  `id` and `bits` hold the previous member's ID and value bits, and are
+ *  updated to the new member's.
+ */
+template <typename ValueCodec>
+void appendMember(
+        std::vector<unsigned char>& bytes,
+        unsigned int member_id,
+        double member_value,
+        boost::uint32_t& id,
+        typename ValueCodec::Bits& bits)
+{
+    typename ValueCodec::Bits member_bits = ValueCodec::toBits(member_value);
+
+    appendVarintDelta<boost::uint32_t>(bytes, member_id, id);
+    appendVarintDelta<typename ValueCodec::Bits>(bytes, member_bits, bits);
+
+    id = member_id;
+    bits = member_bits;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+//
+// CompressedMemberList
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief A list of members, encoded as deltas.
+/// \ingroup contour_tree
+/*!
+ *  Takes the place of a std::vector of members in a member ID graph. The
+ *  list can only be appended to; iterating over it decodes the members
+ *  one at a time, into a copy held by the iterator. A reference obtained
+ *  from an iterator is therefore only good until the iterator is advanced
+ *  or destroyed.
+ */
+template <typename Member, typename ValueCodec = LosslessValues>
+class CompressedMemberList
+{
+    typedef typename ValueCodec::Bits Bits;
+
+    std::vector<unsigned char> _bytes;
+    unsigned int _size;
+
+    // the last member, from which the next is encoded
+    boost::uint32_t _last_id;
+    Bits _last_bits;
+
+public:
+
+    typedef Member value_type;
+
+    /// \brief Decodes the members of a list.
+    class const_iterator
+    {
+        friend class CompressedMemberList;
+
+        // the encoding of the current member, and of the next
+        const unsigned char* _position;
+        const unsigned char* _next;
+        const unsigned char* _end;
+
+        boost::uint32_t _id;
+        Bits _bits;
+        Member _member;
+
+        void decode()
+        {
+            if (_position != _end) {
+                _next = readVarintDelta(_position, _id);
+                _next = readVarintDelta(_next, _bits);
+                _member = Member(_id, ValueCodec::fromBits(_bits));
+            }
+        }
+
+    public:
+        const_iterator(const unsigned char* begin, const unsigned char* end)
+            : _position(begin), _next(begin), _end(end),
+              _id(0), _bits(0), _member(0, 0.)
+        {
+            decode();
+        }
+
+        const Member& operator*() const {
+            return _member;
+        }
+
+        const Member* operator->() const {
+            return &_member;
+        }
+
+        const_iterator& operator++()
+        {
+            _position = _next;
+            decode();
+            return *this;
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            return _position == rhs._position;
+        }
+
+        bool operator!=(const const_iterator& rhs) const {
+            return _position != rhs._position;
+        }
+    };
+
+    typedef const_iterator iterator;
+
+    CompressedMemberList()
+        : _size(0), _last_id(0), _last_bits(0) {}
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    /// \brief The number of bytes used by the encoded members.
+    size_t numberOfBytes() const {
+        return _bytes.size();
+    }
+
+    const_iterator begin() const {
+        return const_iterator(data(), data() + _bytes.size());
+    }
+
+    const_iterator end() const {
+        return const_iterator(data() + _bytes.size(), data() + _bytes.size());
+    }
+
+    /// \brief Reserve room for about `n` members.
+    void reserve(size_t n) {
+        _bytes.reserve(4 * n);
+    }
+
+    void clear()
+    {
+        _bytes.clear();
+        _size = 0;
+        _last_id = 0;
+        _last_bits = 0;
+    }
+
+    void push_back(const Member& member)
+    {
+        // grow by a quarter rather than doubling, so that lists which are
+        // filled one member at a time don't end up mostly empty space
+        if (_bytes.capacity() - _bytes.size() < 16) {
+            _bytes.reserve(_bytes.size() + _bytes.size() / 4 + 16);
+        }
+
+        appendMember<ValueCodec>(_bytes, member.getID(), member.getValue(),
+                                 _last_id, _last_bits);
+        _size++;
+    }
+
+    /// \brief Append the members in [first, last).
+    /*!
+     *  Members can only be appended, so `position` must be end().
+     */
+    template <typename InputIterator>
+    void insert(const_iterator position, InputIterator first, InputIterator last)
+    {
+        if (position != end()) {
+            throw std::logic_error(
+                    "Members can only be appended to a compressed member list.");
+        }
+
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+
+    /// \brief Release any room held for members that were never added.
+    void shrinkToFit()
+    {
+        std::vector<unsigned char>(_bytes).swap(_bytes);
+    }
+
+    void swap(CompressedMemberList& other)
+    {
+        _bytes.swap(other._bytes);
+        std::swap(_size, other._size);
+        std::swap(_last_id, other._last_id);
+        std::swap(_last_bits, other._last_bits);
+    }
+
+private:
+
+    const unsigned char* data() const {
+        return _bytes.empty() ? 0 : &_bytes[0];
+    }
+};
+
+
+/// \brief Member storage policy keeping members in CompressedMemberLists.
+/// \ingroup contour_tree
+/*!
+ *  See VectorMemberStorage. `ValueCodec` is LosslessValues or
+ *  Float32Values.
+ */
+template <typename ValueCodec = LosslessValues>
+struct CompressedMemberStorage
+{
+    template <typename Member>
+    struct List { typedef CompressedMemberList<Member, ValueCodec> Type; };
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+//
+// CompressedContourTree
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief A contour tree whose members are stored compressed.
+/// \ingroup contour_tree
+/*!
+ *  Conforms to concepts::ContourTree, like ContourTree, but keeps each
+ *  member in a few bytes rather than sixteen. getNodeMembers() and
+ *  getEdgeMembers() return CompressedMemberLists, which decode as they
+ *  are iterated.
+ *
+ *  Compressed trees are loaded, rather than computed; see
+ *  readCompressedContourTreeFile(), or fromContourTree().
+ */
+template <typename ValueCodec = LosslessValues>
+class CompressedContourTree :
+    public
+    ContourTreeBase <UndirectedScalarMemberIDGraphBase <UndirectedGraph,
+                                        CompressedMemberStorage<ValueCodec> > >
+{
+public:
+    typedef
+    UndirectedScalarMemberIDGraphBase <UndirectedGraph,
+                                      CompressedMemberStorage<ValueCodec> >
+    Graph;
+
+private:
+    typedef ContourTreeBase<Graph> Base;
+
+    CompressedContourTree(boost::shared_ptr<Graph> graph)
+        : Base(graph) {}
+
+public:
+
+    /// \brief Load a contour tree from a graph. See ContourTree::fromPrecomputed().
+    static CompressedContourTree
+    fromPrecomputed(boost::shared_ptr<Graph>& graph)
+    {
+        boost::shared_ptr<Graph> old_graph = graph;
+        graph = boost::shared_ptr<Graph>(new Graph);
+
+        if (old_graph->numberOfNodes() != old_graph->numberOfEdges() + 1)
+        {
+            throw std::runtime_error("The precomputed graph does not "
+                "appear to be a tree.");
+        }
+
+        return CompressedContourTree(old_graph);
+    }
+
+    /// \brief Compress the members of a contour tree.
+    /*!
+     *  The tree may be anything conforming to concepts::ContourTree.
+     */
+    template <typename ContourTree>
+    static CompressedContourTree fromContourTree(const ContourTree& tree)
+    {
+        typedef typename ContourTree::Members Members;
+        typedef typename Graph::Member Member;
+
+        boost::shared_ptr<Graph> graph(new Graph);
+        graph->reserve(tree.numberOfNodes(), tree.numberOfEdges());
+
+        for (NodeIterator<ContourTree> it(tree); !it.done(); ++it)
+        {
+            typename Graph::Node node = graph->addNode(
+                    tree.getID(it.node()), tree.getValue(it.node()));
+
+            // the node was made its own member, so the rest are added after it
+            const Members& members = tree.getNodeMembers(it.node());
+            for (typename Members::const_iterator m_it = members.begin();
+                    m_it != members.end(); ++m_it) {
+                if (m_it->getID() != tree.getID(it.node())) {
+                    graph->insertNodeMember(node, Member(m_it->getID(), m_it->getValue()));
+                }
+            }
+        }
+
+        for (EdgeIterator<ContourTree> it(tree); !it.done(); ++it)
+        {
+            typename Graph::Edge edge = graph->addEdge(
+                    graph->getNode(tree.getID(tree.u(it.edge()))),
+                    graph->getNode(tree.getID(tree.v(it.edge()))));
+
+            const Members& members = tree.getEdgeMembers(it.edge());
+            for (typename Members::const_iterator m_it = members.begin();
+                    m_it != members.end(); ++m_it) {
+                graph->insertEdgeMember(edge, Member(m_it->getID(), m_it->getValue()));
+            }
+        }
+
+        return fromPrecomputed(graph);
+    }
+};
+
+
+} // namespace denali
+
+#endif
@@ -57,10 +57,23 @@ public:
     /// \brief Add a node to the complex, with associated scalar value.
     Node addNode(double value) { return Node(); }
 
+    /// \brief Add several nodes at once, with the given scalar values.
+    /*!
+     *  Equivalent to calling addNode() on each value in turn.
+     */
+    void addNodes(const double* values, size_t n_nodes) { }
+
     /// \brief Add an edge to the complex.
     /// \pre The nodes must be in the complex.
     Edge addEdge(Node u, Node v) { return Edge(); }
 
+    /// \brief Add several edges at once.
+    /*!
+     *  `edges` holds `n_edges` consecutive pairs of node IDs. Equivalent
+     *  to calling addEdge() on each pair in turn.
+     */
+    void addEdges(const unsigned int* edges, size_t n_edges) { }
+
     /// \brief Retrieve the scalar value of a node.
     double getValue(Node node) const {
         return 0.0;
@@ -93,6 +106,8 @@ public:
 
             _Node node = _plex.addNode(42.42);
             _Edge edge = _plex.addEdge(_Node(), _Node());
+            _plex.addNodes((const double*) 0, 0);
+            _plex.addEdges((const unsigned int*) 0, 0);
             double value = _plex.getValue(_Node());
             node = _plex.getNode(0);
             unsigned int id = _plex.getID(_Node());
@@ -150,10 +165,10 @@ public:
     typedef std::set<concepts::Member>::iterator iterator;
     typedef std::set<concepts::Member>::const_iterator const_iterator;
 
-    const_iterator begin() {
+    const_iterator begin() const {
         return const_iterator();
     }
-    const_iterator end() {
+    const_iterator end() const {
         return const_iterator();
     }
     size_t size() const {
@@ -315,6 +330,16 @@ public:
         return Edge();
     }
 
+    /// \brief Add several nodes at once.
+    /*!
+     *  Equivalent to calling addNode() on each ID and value in turn.
+     */
+    void addNodes(const unsigned int* ids, const double* values,
+                  size_t n_nodes) { }
+
+    /// \brief Reserve room for the given number of nodes and edges.
+    void reserve(size_t n_nodes, size_t n_edges) { }
+
     /// \brief Remove the node.
     void removeNode(Node node) { }
 
@@ -333,6 +358,10 @@ public:
     /// \brief Insert multiple members.
     void insertEdgeMembers(Edge edge, const Members& members) { }
 
+    /// \brief Insert the members in [first, last), growing the member set once.
+    template <typename ForwardIterator>
+    void insertEdgeMembers(Edge edge, ForwardIterator first, ForwardIterator last) { }
+
     /// \brief Get a node's scalar value
     double getValue(Node node) const {
         return 0.;
@@ -361,6 +390,13 @@ public:
     /// \brief Clear the graph.
     void clear() { }
 
+    /// \brief Renumber the nodes and edges densely.
+    /*!
+     *  IDs, values and members are kept, but Node and Edge handles held
+     *  outside of the graph are invalidated.
+     */
+    void compact() { }
+
     template <typename _UndirectedScalarMemberIDGraph>
     struct Constraints
     {
@@ -374,10 +410,13 @@ public:
 
             _Node node = _graph.addNode(14, 42.);
             _Edge edge = _graph.addEdge(_Node(), _Node());
+            _graph.addNodes((const unsigned int*) 0, (const double*) 0, 0);
+            _graph.reserve(0, 0);
             _graph.insertNodeMember(_Node(), member);
             _graph.insertEdgeMember(_Edge(), member);
             _graph.insertNodeMembers(_Node(), members);
             _graph.insertEdgeMembers(_Edge(), members);
+            _graph.insertEdgeMembers(_Edge(), members.begin(), members.end());
 
             double value = _graph.getValue(_Node());
             unsigned int id = _graph.getID(_Node());
@@ -385,6 +424,7 @@ public:
             node = _graph.getNode(id);
             const _Members& edge_members = _graph.getEdgeMembers(_Edge());
             _graph.clear();
+            _graph.compact();
             _graph.removeNode(_Node());
             _graph.removeEdge(_Edge());
 
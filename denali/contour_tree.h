@@ -26,12 +26,18 @@
 #ifndef DENALI_CONTOUR_TREE_H
 #define DENALI_CONTOUR_TREE_H
 
+#include <algorithm>
+#include <iterator>
 #include <map>
 #include <queue>
 #include <set>
 #include <stdexcept>
+#include <string>
 
+#include <boost/exception_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <denali/graph_iterators.h>
 #include <denali/graph_maps.h>
@@ -95,6 +101,23 @@ public:
         return node;
     }
 
+    /// \brief Add several nodes at once, with the given scalar values.
+    /*!
+     *  The nodes receive consecutive IDs, in order. The maps on the
+     *  graph are resized once, rather than once per node.
+     */
+    void addNodes(const double* values, size_t n_nodes)
+    {
+        size_t first = _nodes.size();
+        reserveGeometrically(_nodes, first + n_nodes);
+        _graph.addNodes(n_nodes, std::back_inserter(_nodes));
+
+        for (size_t i=0; i<n_nodes; ++i) {
+            _node_to_value[_nodes[first + i]] = values[i];
+            _node_to_id[_nodes[first + i]] = first + i;
+        }
+    }
+
     /// \brief Add an edge to the complex.
     /// \pre The nodes must be in the complex.
     Edge addEdge(Node u, Node v)
@@ -102,6 +125,30 @@ public:
         return _graph.addEdge(u,v);
     }
 
+    /// \brief Add several edges at once.
+    /*!
+     *  `edges` holds `n_edges` consecutive pairs of node IDs.
+     *
+     *  \throws std::runtime_error if an edge refers to a nonexistent node.
+     */
+    void addEdges(const unsigned int* edges, size_t n_edges)
+    {
+        _graph.reserve(_graph.getMaxNodeIdentifier(),
+                       _graph.getMaxEdgeIdentifier() + n_edges);
+
+        GraphBatch<GraphType> batch(_graph);
+        for (size_t i=0; i<n_edges; ++i) {
+            unsigned int u = edges[2*i];
+            unsigned int v = edges[2*i + 1];
+
+            if (u >= _nodes.size() || v >= _nodes.size()) {
+                throw std::runtime_error("Edge refers to a nonexistent node.");
+            }
+
+            _graph.addEdge(_nodes[u], _nodes[v]);
+        }
+    }
+
     /// \brief Retrieve the scalar value of a node.
     double getValue(Node node) const
     {
@@ -138,6 +185,133 @@ public:
 };
 
 
+/// \brief A read-only scalar simplicial complex with a compact layout.
+/// \ingroup contour_tree
+/*!
+ *  Values are kept in a flat array, and the 1-skeleton in a
+ *  CompactUndirectedGraph. Nodes and edges are added as usual, but the
+ *  edges only become visible after freeze() is called. Freezing again
+ *  rebuilds the graph, which is as costly as the first freeze, so the
+ *  complex is meant to be built once and then only read.
+ *
+ *  Provides an implementation of concepts::ScalarSimplicialComplex
+ */
+class CompactScalarSimplicialComplex :
+    public
+    ReadableUndirectedGraphMixin <CompactUndirectedGraph,
+    BaseGraphMixin <CompactUndirectedGraph> >
+{
+    typedef
+    ReadableUndirectedGraphMixin <CompactUndirectedGraph,
+                                 BaseGraphMixin <CompactUndirectedGraph> >
+                                 Mixin;
+
+    CompactUndirectedGraph _graph;
+    std::vector<double> _values;
+
+    // edges added since the last freeze, as consecutive pairs of node ids
+    std::vector<unsigned int> _pending_edges;
+
+public:
+    typedef Mixin::Node Node;
+    typedef Mixin::Edge Edge;
+
+    CompactScalarSimplicialComplex() : Mixin(_graph) {}
+
+    /// \brief Add a node to the complex, with associated scalar value.
+    Node addNode(double value)
+    {
+        _values.push_back(value);
+        return _graph.getNodeFromIdentifier(_values.size() - 1);
+    }
+
+    /// \brief Add several nodes at once, with the given scalar values.
+    void addNodes(const double* values, size_t n_nodes)
+    {
+        _values.insert(_values.end(), values, values + n_nodes);
+    }
+
+    /// \brief Add an edge to the complex.
+    /*!
+     *  Edges are numbered when the complex is frozen, so the returned
+     *  edge is always invalid.
+     *
+     *  \pre The nodes must be in the complex.
+     */
+    Edge addEdge(Node u, Node v)
+    {
+        _pending_edges.push_back(_graph.getNodeIdentifier(u));
+        _pending_edges.push_back(_graph.getNodeIdentifier(v));
+        return _graph.getInvalidEdge();
+    }
+
+    /// \brief Add several edges at once.
+    /*!
+     *  `edges` holds `n_edges` consecutive pairs of node ids. Like those
+     *  given to addEdge(), they become visible when the complex is frozen.
+     */
+    void addEdges(const unsigned int* edges, size_t n_edges)
+    {
+        _pending_edges.insert(_pending_edges.end(), edges, edges + 2*n_edges);
+    }
+
+    /// \brief Build the compact graph from the nodes and edges added so far.
+    void freeze()
+    {
+        freeze(0, 0);
+    }
+
+    /// \brief Build the compact graph, adding the given edges.
+    /*!
+     *  `edges` holds `n_edges` consecutive pairs of node ids. They are
+     *  added after any edges given to addEdge(). If there are no such
+     *  edges, the graph is built directly from the array without copying
+     *  it, so the array may, for instance, live in a memory-mapped file.
+     *
+     *  If the complex was frozen before, its edges are kept, though they
+     *  may be given new identifiers.
+     *
+     *  \throws std::runtime_error if an edge refers to a nonexistent node.
+     */
+    void freeze(const unsigned int* edges, size_t n_edges)
+    {
+        if (_graph.numberOfEdges() > 0) {
+            std::vector<unsigned int> pending;
+            _graph.appendEdges(pending);
+            pending.insert(pending.end(), _pending_edges.begin(), _pending_edges.end());
+            _pending_edges.swap(pending);
+        }
+
+        if (!_pending_edges.empty()) {
+            _pending_edges.insert(_pending_edges.end(), edges, edges + 2*n_edges);
+            edges = &_pending_edges[0];
+            n_edges = _pending_edges.size() / 2;
+        }
+
+        _graph.build(_values.size(), edges, n_edges);
+
+        std::vector<unsigned int>().swap(_pending_edges);
+    }
+
+    /// \brief Retrieve the scalar value of a node.
+    double getValue(Node node) const
+    {
+        return _values[_graph.getNodeIdentifier(node)];
+    }
+
+    Node getNode(unsigned int index) const
+    {
+        return _graph.getNodeFromIdentifier(index);
+    }
+
+    unsigned int getID(Node node) const
+    {
+        return _graph.getNodeIdentifier(node);
+    }
+
+};
+
+
 /// \brief Adapts a scalar simplicial complex so that it
 ///      may be used by a concepts::RandomAccessComparisonFunctor
 /// \ingroup contour_tree
@@ -150,7 +324,7 @@ public:
     ScalarSimplicialComplexRandomAccessAdapter(const ScalarSimplicialComplex& plex)
         : _plex(plex) { }
 
-    const double operator[](unsigned int index) const
+    double operator[](unsigned int index) const
     {
         return _plex.getValue(_plex.getNode(index));
     }
@@ -166,6 +340,131 @@ public:
 //
 ////////////////////////////////////////////////////////////////////////////
 
+/// \brief Maps node IDs to nodes.
+/*!
+ *  IDs are usually dense vertex indices, so they index directly into a
+ *  vector. If an ID arrives that is much larger than the number of IDs
+ *  stored, the index switches to a hash table, and stays that way until
+ *  it is cleared.
+ */
+template <typename Node>
+class NodeIDIndex
+{
+    typedef boost::unordered_map<unsigned int, Node> SparseIndex;
+
+    Node _invalid_node;
+    std::vector<Node> _dense;
+    SparseIndex _sparse;
+    bool _is_sparse;
+    size_t _size;
+
+    // an ID is too sparse for the vector if it is larger than this
+    size_t denseLimit() const
+    {
+        return 4 * _size + 1024;
+    }
+
+    void makeSparse()
+    {
+        for (size_t id=0; id<_dense.size(); ++id) {
+            if (_dense[id] != _invalid_node) {
+                _sparse.insert(std::make_pair((unsigned int) id, _dense[id]));
+            }
+        }
+
+        std::vector<Node>().swap(_dense);
+        _is_sparse = true;
+    }
+
+public:
+    NodeIDIndex(Node invalid_node)
+        : _invalid_node(invalid_node), _is_sparse(false), _size(0) {}
+
+    /// \brief Map the ID to the node, replacing any previous node.
+    void insert(unsigned int id, Node node)
+    {
+        if (!_is_sparse && id >= _dense.size() && id > denseLimit()) {
+            makeSparse();
+        }
+
+        if (_is_sparse) {
+            std::pair<typename SparseIndex::iterator, bool> result =
+                _sparse.insert(std::make_pair(id, node));
+
+            if (result.second) {
+                _size++;
+            } else {
+                result.first->second = node;
+            }
+            return;
+        }
+
+        if (id >= _dense.size()) {
+            // grow geometrically, so that ascending IDs are cheap to add
+            _dense.resize(std::max((size_t) id + 1, 2 * _dense.size()), _invalid_node);
+        }
+
+        if (_dense[id] == _invalid_node) {
+            _size++;
+        }
+        _dense[id] = node;
+    }
+
+    /// \brief Forget the ID.
+    void erase(unsigned int id)
+    {
+        if (_is_sparse) {
+            _size -= _sparse.erase(id);
+        } else if (id < _dense.size() && _dense[id] != _invalid_node) {
+            _dense[id] = _invalid_node;
+            _size--;
+        }
+    }
+
+    /// \brief Find the node with the ID, or the invalid node if there is none.
+    Node find(unsigned int id) const
+    {
+        if (_is_sparse) {
+            typename SparseIndex::const_iterator it = _sparse.find(id);
+            return it == _sparse.end() ? _invalid_node : it->second;
+        }
+
+        return id < _dense.size() ? _dense[id] : _invalid_node;
+    }
+
+    void clear()
+    {
+        std::vector<Node>().swap(_dense);
+        SparseIndex().swap(_sparse);
+        _is_sparse = false;
+        _size = 0;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    bool isSparse() const
+    {
+        return _is_sparse;
+    }
+};
+
+
+/// \brief Member storage policy keeping members in std::vectors.
+/*!
+ *  A member storage policy chooses the container which holds the members
+ *  of each node and edge of an UndirectedScalarMemberIDGraphBase. See
+ *  CompressedMemberStorage for an alternative.
+ */
+struct VectorMemberStorage
+{
+    template <typename Member>
+    struct List { typedef std::vector<Member> Type; };
+};
+
+
 /// \brief An implementation of concepts::UndirectedScalarMemberIDGraph
 /*!
  *  Requires that GraphType meets
@@ -173,12 +472,14 @@ public:
  *   - concepts::NodeObservable
  *   - concepts::EdgeObservable
  *
+ *  MemberStorage is VectorMemberStorage or CompressedMemberStorage.
+ *
  *  Conforms to
  *   - concepts::UndirectedScalarMemberIDGraph
  *   - concepts::NodeObservable
  *   - concepts::EdgeObservable
  */
-template <typename GraphType>
+template <typename GraphType, typename MemberStorage = VectorMemberStorage>
 class UndirectedScalarMemberIDGraphBase :
     public
     EdgeObservableMixin < GraphType,
@@ -213,7 +514,7 @@ public:
         }
     };
 
-    typedef std::vector<Member> Members;
+    typedef typename MemberStorage::template List<Member>::Type Members;
 
 private:
     typedef
@@ -227,8 +528,7 @@ private:
 
     ObservingNodeMap<GraphType, unsigned int> _node_to_id;
     ObservingNodeMap<GraphType, double> _node_to_value;
-    typedef std::map<unsigned int, typename GraphType::Node> IDToNode;
-    IDToNode _id_to_node;
+    NodeIDIndex<typename GraphType::Node> _id_to_node;
 
     ObservingNodeMap<GraphType, Members> _node_to_members;
     ObservingEdgeMap<GraphType, Members> _edge_to_members;
@@ -242,7 +542,8 @@ public:
     typedef typename GraphType::Edge Edge;
 
     UndirectedScalarMemberIDGraphBase()
-        : Mixin(_graph), _node_to_id(_graph), _node_to_value(_graph), _node_to_members(_graph),
+        : Mixin(_graph), _node_to_id(_graph), _node_to_value(_graph),
+          _id_to_node(_graph.getInvalidNode()), _node_to_members(_graph),
           _edge_to_members(_graph), _nodes_plus_members(0)
     {
     }
@@ -257,7 +558,7 @@ public:
         Node node = _graph.addNode();
         _node_to_id[node] = id;
         _node_to_value[node] = value;
-        _id_to_node[id] = node;
+        _id_to_node.insert(id, node);
 
         _nodes_plus_members++;
 
@@ -267,6 +568,31 @@ public:
         return node;
     }
 
+    /// \brief Add several nodes at once.
+    /*!
+     *  Adds a node for each of the `n_nodes` IDs and values. The maps on
+     *  the graph are resized once, rather than once per node. The new
+     *  nodes can be retrieved with getNode().
+     */
+    void addNodes(const unsigned int* ids, const double* values, size_t n_nodes)
+    {
+        std::vector<Node> nodes;
+        nodes.reserve(n_nodes);
+        _graph.addNodes(n_nodes, std::back_inserter(nodes));
+
+        for (size_t i=0; i<n_nodes; ++i) {
+            Node node = nodes[i];
+            _node_to_id[node] = ids[i];
+            _node_to_value[node] = values[i];
+            _id_to_node.insert(ids[i], node);
+
+            _node_to_members[node].clear();
+            _node_to_members[node].push_back(Member(ids[i], values[i]));
+        }
+
+        _nodes_plus_members += n_nodes;
+    }
+
     /// \brief Add an edge to the graph.
     Edge addEdge(Node u, Node v)
     {
@@ -275,6 +601,17 @@ public:
         return edge;
     }
 
+    /// \brief Reserve room for the given number of nodes and edges.
+    /*!
+     *  Growing the member maps one node or edge at a time copies every
+     *  member list each time the maps are reallocated, so reserving up
+     *  front pays off when the final size is known.
+     */
+    void reserve(size_t n_nodes, size_t n_edges)
+    {
+        _graph.reserve(n_nodes, n_edges);
+    }
+
     /// \brief Remove the node.
     void removeNode(Node node)
     {
@@ -300,7 +637,7 @@ public:
         _nodes_plus_members -= _edge_to_members[edge].size();
 
         // an idiom to reduce the capacity of a vector
-        std::vector<Member>().swap(_edge_to_members[edge]);
+        Members().swap(_edge_to_members[edge]);
 
         _graph.removeEdge(edge);
     }
@@ -333,12 +670,36 @@ public:
     /// \brief Insert members into edge member set.
     void insertEdgeMembers(Edge edge, const Members& members)
     {
-        for (typename Members::const_iterator it = members.begin();
-                it != members.end();
-                ++it) {
-            _edge_to_members[edge].push_back(*it);
-            _nodes_plus_members++;
-        }
+        Members& edge_members = _edge_to_members[edge];
+        edge_members.reserve(edge_members.size() + members.size());
+        edge_members.insert(edge_members.end(), members.begin(), members.end());
+        _nodes_plus_members += members.size();
+    }
+
+    /// \brief Insert the members in [first, last) into the edge's member set.
+    /*!
+     *  The edge's member set is grown once, to fit every new member.
+     */
+    template <typename ForwardIterator>
+    void insertEdgeMembers(Edge edge, ForwardIterator first, ForwardIterator last)
+    {
+        size_t n_members = std::distance(first, last);
+        Members& edge_members = _edge_to_members[edge];
+        edge_members.reserve(edge_members.size() + n_members);
+        edge_members.insert(edge_members.end(), first, last);
+        _nodes_plus_members += n_members;
+    }
+
+    /// \brief Replace the edge's member set.
+    /*!
+     *  Unlike insertEdgeMembers(), the list is copied as it is, so a
+     *  LazyMemberList whose members haven't been read yet stays that way.
+     */
+    void setEdgeMembers(Edge edge, const Members& members)
+    {
+        _nodes_plus_members -= _edge_to_members[edge].size();
+        _edge_to_members[edge] = members;
+        _nodes_plus_members += members.size();
     }
 
     /// \brief Get a node's scalar value
@@ -360,15 +721,12 @@ public:
     }
 
     /// \brief Retrieve a node by its ID.
-    Node getNode(unsigned int id)
+    /*!
+     *  \returns The node, or an invalid node if no node has the ID.
+     */
+    Node getNode(unsigned int id) const
     {
-        typename IDToNode::const_iterator it = _id_to_node.find(id);
-
-        if (it == _id_to_node.end()) {
-            return _graph.getInvalidNode();
-        } else {
-            return it->second;
-        }
+        return _id_to_node.find(id);
     }
 
     /// \brief Retrieve the members of the edge.
@@ -380,9 +738,26 @@ public:
     /// \brief Clear the nodes of the graph
     void clear() {
         _nodes_plus_members = 0;
+        _id_to_node.clear();
         return _graph.clear();
     }
 
+    /// \brief Renumber the nodes and edges densely, in iteration order.
+    /*!
+     *  Releases the space held by removed nodes and edges. IDs, values
+     *  and members are kept, but Node and Edge handles held outside of
+     *  the graph are invalidated.
+     */
+    void compact()
+    {
+        _graph.compact();
+
+        _id_to_node.clear();
+        for (NodeIterator<GraphType> it(_graph); !it.done(); ++it) {
+            _id_to_node.insert(_node_to_id[it.node()], it.node());
+        }
+    }
+
     size_t numberNodesPlusMembers() const {
         return _nodes_plus_members;
     }
@@ -677,6 +1052,72 @@ typename GraphType::Node findMaxNode(
     return max_node;
 }
 
+/// \brief Join the components of a simplicial complex at a new global minimum.
+/// \ingroup contour_tree
+/*!
+ *  Given the labels computed by labelConnectedComponents(), adds a node
+ *  below every other node, along with an edge from it to the minimum of
+ *  each component. The contour tree of the result is made of the contour
+ *  trees of the components, each hanging from the new node by its minimum.
+ *
+ *  The new node lies below the minimum by the range of the values, so the
+ *  bridging edges are more persistent than any edge within a component,
+ *  and are the last to be simplified.
+ *
+ *  A CompactScalarSimplicialComplex must be frozen again afterwards.
+ *
+ *  \returns The new node.
+ */
+template <typename ScalarSimplicialComplex>
+typename ScalarSimplicialComplex::Node bridgeComponents(
+    ScalarSimplicialComplex& plex,
+    const std::vector<unsigned int>& labels,
+    unsigned int n_components)
+{
+    typedef typename ScalarSimplicialComplex::Node Node;
+
+    // the minimum of each component, ties going to the smaller index as
+    // in the TotalOrder
+    std::vector<unsigned int> minima(n_components, (unsigned int) -1);
+    double min_value = 0.;
+    double max_value = 0.;
+    bool found = false;
+
+    for (unsigned int i=0; i<labels.size(); ++i)
+    {
+        if (labels[i] == (unsigned int) -1) {
+            continue;
+        }
+
+        double value = plex.getValue(plex.getNodeFromIdentifier(i));
+        unsigned int& minimum = minima[labels[i]];
+        if (minimum == (unsigned int) -1 ||
+                value < plex.getValue(plex.getNodeFromIdentifier(minimum))) {
+            minimum = i;
+        }
+
+        if (!found || value < min_value) {
+            min_value = value;
+        }
+        if (!found || value > max_value) {
+            max_value = value;
+        }
+        found = true;
+    }
+
+    double drop = max_value - min_value;
+    if (!(drop > 0.)) {
+        drop = 1.;
+    }
+
+    Node root = plex.addNode(min_value - drop);
+    for (size_t i=0; i<minima.size(); ++i) {
+        plex.addEdge(root, plex.getNodeFromIdentifier(minima[i]));
+    }
+
+    return root;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // DisjointSetForest
@@ -685,29 +1126,39 @@ typename GraphType::Node findMaxNode(
 
 /// \brief A disjoint set forest class.
 /// \ingroup contour_tree
+/*!
+ *  Each set remembers its maximum and minimum elements with respect to
+ *  the TotalOrder. The forest uses union by size and path halving, and
+ *  keeps everything about an element in one record, so that a find touches
+ *  as little memory as possible. The extremes are stored as positions in
+ *  the order, so a union needs no lookups in the TotalOrder.
+ */
 template <typename TotalOrder>
 class DisjointSetForest
 {
-    const TotalOrder& order;
-    std::vector<unsigned int> parent;
-    std::vector<unsigned int> rank;
-    std::vector<unsigned int> max_element;
-    std::vector<unsigned int> min_element;
+    struct Element
+    {
+        unsigned int parent;
+        unsigned int size;
+        unsigned int max_position;
+        unsigned int min_position;
+    };
+
+    const TotalOrder& _order;
+    std::vector<Element> _elements;
 
 public:
 
     DisjointSetForest(const TotalOrder& order)
-        : order(order),
-          parent(order.size()),
-          rank(order.size()),
-          max_element(order.size()),
-          min_element(order.size())
+        : _order(order),
+          _elements(order.size())
     {
         for (size_t i=0; i<order.size(); ++i) {
-            parent[i] = i;
-            max_element[i] = i;
-            min_element[i] = i;
-            rank[i] = 0;
+            Element& element = _elements[i];
+            element.parent = i;
+            element.size = 1;
+            element.max_position = order.elementToPosition(i);
+            element.min_position = element.max_position;
         }
     }
 
@@ -715,31 +1166,35 @@ public:
     unsigned int
     findSet(unsigned int x)
     {
-        if (this->parent[x] != x) {
-            this->parent[x] = findSet(this->parent[x]);
+        // path halving: point every other element on the path at its
+        // grandparent
+        while (_elements[x].parent != x) {
+            unsigned int grandparent = _elements[_elements[x].parent].parent;
+            _elements[x].parent = grandparent;
+            x = grandparent;
         }
 
-        return this->parent[x];
+        return x;
     }
 
     unsigned int
     findMax(unsigned int x)
     {
-        return this->max_element[this->findSet(x)];
+        return _order.positionToElement(_elements[findSet(x)].max_position);
     }
 
 
     unsigned int
     findMin(unsigned int x)
     {
-        return this->min_element[this->findSet(x)];
+        return _order.positionToElement(_elements[findSet(x)].min_position);
     }
 
 
     void
     setUnion(unsigned int x, unsigned int y)
     {
-        this->link(this->findSet(x), this->findSet(y));
+        link(findSet(x), findSet(y));
     }
 
 
@@ -747,38 +1202,22 @@ private:
     void
     link(unsigned int x, unsigned int y)
     {
+        if (x == y) {
+            return;
+        }
 
-        unsigned int max_x_id = this->order.elementToPosition(this->max_element[x]);
-        unsigned int min_x_id = this->order.elementToPosition(this->min_element[x]);
-        unsigned int max_y_id = this->order.elementToPosition(this->max_element[y]);
-        unsigned int min_y_id = this->order.elementToPosition(this->min_element[y]);
-
-        if (this->rank[x] > this->rank[y]) {
-            this->parent[y] = x;
-
-            if (max_x_id < max_y_id) {
-                this->max_element[x] = this->max_element[y];
-            }
-
-            if (min_x_id > min_y_id) {
-                this->min_element[x] = this->min_element[y];
-            }
-
-        } else {
-            this->parent[x] = y;
-
-            if (this->rank[x] == this->rank[y]) {
-                this->rank[y] += 1;
-            }
+        // the smaller set goes below the larger one
+        if (_elements[x].size > _elements[y].size) {
+            std::swap(x, y);
+        }
 
-            if (max_y_id < max_x_id) {
-                this->max_element[y] = this->max_element[x];
-            }
+        Element& child = _elements[x];
+        Element& root = _elements[y];
 
-            if (min_y_id > min_x_id) {
-                this->min_element[y] = this->min_element[x];
-            }
-        }
+        child.parent = y;
+        root.size += child.size;
+        root.max_position = std::max(root.max_position, child.max_position);
+        root.min_position = std::min(root.min_position, child.min_position);
     }
 };
 
@@ -803,8 +1242,113 @@ private:
     TotalOrder(size_t n)
         : _element_to_position(n), _position_to_element(n) { }
 
+    typedef PositionToElement::iterator Iterator;
+
+    template <typename ComparisonFunctor>
+    class SortWorker
+    {
+        Iterator _first, _last;
+        ComparisonFunctor _cmp;
+
+    public:
+        SortWorker(Iterator first, Iterator last, ComparisonFunctor cmp)
+            : _first(first), _last(last), _cmp(cmp) {}
+
+        void operator()() {
+            std::sort(_first, _last, _cmp);
+        }
+    };
+
+    template <typename ComparisonFunctor>
+    class MergeWorker
+    {
+        Iterator _first, _middle, _last, _out;
+        ComparisonFunctor _cmp;
+
+    public:
+        MergeWorker(Iterator first, Iterator middle, Iterator last,
+                    Iterator out, ComparisonFunctor cmp)
+            : _first(first), _middle(middle), _last(last), _out(out), _cmp(cmp) {}
+
+        void operator()() {
+            std::merge(_first, _middle, _middle, _last, _out, _cmp);
+        }
+    };
+
+    /// \brief Sorts the elements with a parallel merge sort.
+    template <typename ComparisonFunctor>
+    static void parallelSort(
+        PositionToElement& elements,
+        ComparisonFunctor& cmp,
+        unsigned int n_threads)
+    {
+        size_t n = elements.size();
+
+        // split the elements into one run per thread
+        std::vector<size_t> bounds;
+        for (size_t i=0; i<n_threads; ++i) {
+            bounds.push_back(i * n / n_threads);
+        }
+        bounds.push_back(n);
+
+        boost::thread_group sorters;
+        for (size_t i=0; i+1<bounds.size(); ++i) {
+            sorters.create_thread(SortWorker<ComparisonFunctor>(
+                    elements.begin() + bounds[i],
+                    elements.begin() + bounds[i+1],
+                    cmp));
+        }
+        sorters.join_all();
+
+        // merge neighboring runs until only one is left
+        PositionToElement buffer(n);
+        PositionToElement* source = &elements;
+        PositionToElement* target = &buffer;
+
+        while (bounds.size() > 2)
+        {
+            std::vector<size_t> merged_bounds;
+            boost::thread_group mergers;
+
+            size_t i = 0;
+            for (; i+2<bounds.size(); i+=2)
+            {
+                mergers.create_thread(MergeWorker<ComparisonFunctor>(
+                        source->begin() + bounds[i],
+                        source->begin() + bounds[i+1],
+                        source->begin() + bounds[i+2],
+                        target->begin() + bounds[i],
+                        cmp));
+                merged_bounds.push_back(bounds[i]);
+            }
+
+            // an odd run out is carried over as it is
+            if (i+1 < bounds.size()) {
+                std::copy(source->begin() + bounds[i], source->end(),
+                          target->begin() + bounds[i]);
+                merged_bounds.push_back(bounds[i]);
+            }
+
+            merged_bounds.push_back(n);
+            mergers.join_all();
+
+            bounds.swap(merged_bounds);
+            std::swap(source, target);
+        }
+
+        if (source != &elements) {
+            elements.swap(buffer);
+        }
+    }
+
 public:
 
+    /// Inputs of at least this size are sorted in parallel by default.
+    static const size_t PARALLEL_SORT_THRESHOLD = 1 << 20;
+
+    /// The smallest run that is worth sorting on its own thread.
+    static const size_t MIN_ELEMENTS_PER_THREAD = 1 << 14;
+
     unsigned int elementToPosition(unsigned int element) const
     {
         return _element_to_position[element];
@@ -830,6 +1374,30 @@ public:
     static TotalOrder compute(
         const Values& values,
         ComparisonFunctor& cmp)
+    {
+        unsigned int n_threads = 1;
+
+        // large orders are sorted in parallel, using every available core
+        if (values.size() >= PARALLEL_SORT_THRESHOLD)
+        {
+            n_threads = boost::thread::hardware_concurrency();
+        }
+
+        return compute(values, cmp, n_threads);
+    }
+
+    /// Compute a total ordering using up to n_threads threads.
+    /*!
+     *  The elements are split into one run per thread, each run is sorted
+     *  on its own thread, and the runs are then merged pairwise. As long as
+     *  ComparisonFunctor is a strict total order (see RandomAccessValueSorter)
+     *  the result does not depend on the number of threads.
+     */
+    template <typename Values, typename ComparisonFunctor>
+    static TotalOrder compute(
+        const Values& values,
+        ComparisonFunctor& cmp,
+        unsigned int n_threads)
     {
         // create a new total order object
         TotalOrder ordering(values.size());
@@ -845,8 +1413,18 @@ public:
             *it = index++;
         }
 
+        // don't bother with threads if each would get only a few elements
+        size_t max_threads = order_to_index.size() / MIN_ELEMENTS_PER_THREAD;
+        if (n_threads > max_threads) {
+            n_threads = max_threads;
+        }
+
         // now sort the ordering
-        std::sort(order_to_index.begin(), order_to_index.end(), cmp);
+        if (n_threads > 1) {
+            parallelSort(order_to_index, cmp, n_threads);
+        } else {
+            std::sort(order_to_index.begin(), order_to_index.end(), cmp);
+        }
 
         unsigned int order = 0;
         for (PositionToElement::iterator it = order_to_index.begin();
@@ -869,6 +1447,8 @@ public:
 /// \ingroup contour_tree
 /*!
  *  Calling the functor with u and v returns true if values[u] < values[v].
+ *  Ties are broken by index, so that the functor is a strict total order and
+ *  the resulting TotalOrder does not depend on the sorting algorithm.
  */
 template <typename Values>
 class RandomAccessValueSorter
@@ -879,7 +1459,16 @@ public:
     RandomAccessValueSorter(const Values& values) : values(values) { }
     bool operator()(unsigned int u, unsigned int v)
     {
-        return values[u] < values[v];
+        double u_value = values[u];
+        double v_value = values[v];
+
+        if (u_value < v_value) {
+            return true;
+        } else if (v_value < u_value) {
+            return false;
+        } else {
+            return u < v;
+        }
     }
 };
 
@@ -914,28 +1503,25 @@ public:
     DirectedIDGraph() : Mixin(_graph), _node_to_id(_graph) { }
     DirectedIDGraph(size_t n) : Mixin(_graph), _node_to_id(_graph)
     {
-        for (size_t i=0; i<n; ++i) {
-            addNode();
-        }
+        addNodes(n);
     }
 
     DirectedIDGraph(const DirectedIDGraph& other) : 
             Mixin(_graph), _node_to_id(_graph)
     {
         // copy the nodes
-        for (size_t i=0; i<other.numberOfNodes(); ++i)
-        {
-            this->addNode();
-        }
+        addNodes(other.numberOfNodes());
 
+        std::vector<std::pair<Node, Node> > arcs;
+        arcs.reserve(other.numberOfArcs());
         for (ArcIterator<DirectedIDGraph> arc_it(other);
                 !arc_it.done(); ++arc_it)
         {
-            Node parent = other.source(arc_it.arc());
-            Node child = other.target(arc_it.arc());
-
-            this->addArc(parent, child);
+            arcs.push_back(std::make_pair(
+                    other.source(arc_it.arc()), other.target(arc_it.arc())));
         }
+
+        _graph.addArcs(arcs.begin(), arcs.end());
     }
 
     Node addNode()
@@ -946,6 +1532,18 @@ public:
         return node;
     }
 
+    /// \brief Add n nodes, with consecutive IDs.
+    void addNodes(size_t n)
+    {
+        size_t first = _id_to_node.size();
+        reserveGeometrically(_id_to_node, first + n);
+        _graph.addNodes(n, std::back_inserter(_id_to_node));
+
+        for (size_t i=first; i<_id_to_node.size(); ++i) {
+            _node_to_id[_id_to_node[i]] = i;
+        }
+    }
+
     Arc addArc(Node u, Node v)
     {
         return _graph.addArc(u,v);
@@ -981,14 +1579,53 @@ public:
  */
 class CarrsAlgorithm
 {
-    bool _copy_join_split;
+    unsigned int _number_of_threads;
 
 public:
 
-    CarrsAlgorithm() : _copy_join_split(false) {}
+    CarrsAlgorithm() : _number_of_threads(1) {}
 
     typedef DirectedIDGraph<DirectedGraph> JoinSplitTree;
 
+private:
+
+    /// \brief Computes the join tree on a worker thread.
+    /*!
+     *  The sweep only reads the complex and the total order, so it is safe to
+     *  run alongside the split tree sweep. Exceptions cannot cross the thread
+     *  boundary, so the exception is stored and rethrown by the caller, with
+     *  its type intact.
+     */
+    template <typename ScalarSimplicialComplex, typename TotalOrder>
+    class JoinTreeWorker
+    {
+        const ScalarSimplicialComplex& _plex;
+        const TotalOrder& _order;
+        boost::shared_ptr<JoinSplitTree>& _join_tree;
+        boost::exception_ptr& _error;
+
+    public:
+        JoinTreeWorker(
+                const ScalarSimplicialComplex& plex,
+                const TotalOrder& order,
+                boost::shared_ptr<JoinSplitTree>& join_tree,
+                boost::exception_ptr& error)
+            : _plex(plex), _order(order), _join_tree(join_tree), _error(error) {}
+
+        void operator()()
+        {
+            try {
+                _join_tree = boost::shared_ptr<JoinSplitTree>(new JoinSplitTree(
+                        computeJoinTree(_plex, _order)));
+            }
+            catch (...) {
+                _error = boost::current_exception();
+            }
+        }
+    };
+
+public:
+
     /// \brief Compute a contour tree from a simplicial complex.
     template <typename ScalarSimplicialComplex, typename UndirectedScalarMemberIDGraph>
     void compute(
@@ -1007,35 +1644,84 @@ public:
 
         SortAdapter adapter(simplicial_complex);
 
+        // each comparison through the adapter costs two lookups, so we
+        // gather the values into a flat vector before sorting
+        std::vector<double> values(adapter.size());
+        for (size_t i=0; i<values.size(); ++i) {
+            values[i] = adapter[i];
+        }
+
         // now create a node sorter
-        RandomAccessValueSorter<SortAdapter> sorter(adapter);
+        RandomAccessValueSorter<std::vector<double> > sorter(values);
 
         // and compute the total order
-        TotalOrder order = TotalOrder::compute(adapter, sorter);
+        TotalOrder order = _number_of_threads > 1 ?
+                TotalOrder::compute(values, sorter, _number_of_threads) :
+                TotalOrder::compute(values, sorter);
 
-        _join_tree = boost::shared_ptr<JoinSplitTree>(new JoinSplitTree(
-                computeJoinTree(simplicial_complex, order)));
+        if (_number_of_threads > 1)
+        {
+            // the join and split sweeps are independent: compute the join
+            // tree on a second thread while this one computes the split tree
+            boost::exception_ptr join_error;
+            JoinTreeWorker<ScalarSimplicialComplex, TotalOrder> worker(
+                    simplicial_complex, order, _join_tree, join_error);
 
-        _split_tree = boost::shared_ptr<JoinSplitTree>(new JoinSplitTree(
-                computeSplitTree(simplicial_complex, order)));
+            boost::thread join_thread(worker);
 
-        if (_copy_join_split)
-        {
-            JoinSplitTree join_tree_copy = *_join_tree;
-            JoinSplitTree split_tree_copy = *_split_tree;
+            try {
+                _split_tree = boost::shared_ptr<JoinSplitTree>(new JoinSplitTree(
+                        computeSplitTree(simplicial_complex, order)));
+            }
+            catch (...) {
+                join_thread.join();
+                throw;
+            }
+
+            join_thread.join();
 
-            computeMergeTree(simplicial_complex, join_tree_copy, split_tree_copy, graph);
-        } 
+            if (join_error)
+            {
+                boost::rethrow_exception(join_error);
+            }
+        }
         else
         {
-            computeMergeTree(simplicial_complex, *_join_tree, *_split_tree, graph);
+            _join_tree = boost::shared_ptr<JoinSplitTree>(new JoinSplitTree(
+                    computeJoinTree(simplicial_complex, order)));
+
+            _split_tree = boost::shared_ptr<JoinSplitTree>(new JoinSplitTree(
+                    computeSplitTree(simplicial_complex, order)));
         }
 
+        computeMergeTree(simplicial_complex, *_join_tree, *_split_tree, graph);
+
         removeRegularNodes(graph, order);
+
+        // the contour tree is usually far smaller than the merge tree it
+        // was carved out of, so release the space of the removed nodes
+        graph.compact();
+    }
+
+    /// \brief Whether the join and split trees should be kept intact.
+    /*!
+     *  The merge no longer modifies the join and split trees, so they are
+     *  always available through getJoinTree() and getSplitTree(). This
+     *  setting has no effect, and is kept for compatibility.
+     */
+    void setCopyJoinSplitTrees(bool) {}
+
+    /// \brief Set the number of threads used to compute the tree.
+    /*!
+     *  With more than one thread, the join and split trees are computed
+     *  concurrently. The output is identical to the single threaded case.
+     */
+    void setNumberOfThreads(unsigned int n) {
+        _number_of_threads = n > 0 ? n : 1;
     }
 
-    void setCopyJoinSplitTrees(bool value) {
-        _copy_join_split = value;
+    unsigned int getNumberOfThreads() const {
+        return _number_of_threads;
     }
 
     const JoinSplitTree& getJoinTree() const {
@@ -1132,60 +1818,132 @@ public:
     };
 
 
-    /// \brief Reduce a node in the join or split tree.
+    /// \brief A join or split tree, flattened into arrays indexed by vertex ID.
     /*!
-     *  Reducing a node entails removing it from the tree and connecting
-     *  its parent to its children.
+     *  Every node of a join or split tree has at most one parent. Besides
+     *  its parent, each node records how many children it has and the xor
+     *  of their IDs, which is the ID of the child when there is only one.
+     *  That is all the merge needs, since it only ever reduces nodes with
+     *  at most one child.
      */
-    static void reduceNode(
-        JoinSplitTree& tree,
-        JoinSplitTree::Node node)
+    class ParentArrayTree
     {
-        // if the node has no parents, we just remove it
-        if (tree.inDegree(node) > 0) 
+        std::vector<unsigned int> _parent;
+        std::vector<unsigned int> _n_children;
+        std::vector<unsigned int> _children_xor;
+
+    public:
+        // an enumerator rather than a static const member, so that binding
+        // it to a reference doesn't need an out-of-class definition
+        enum { NO_PARENT = 0xffffffffu };
+
+        ParentArrayTree(const JoinSplitTree& tree)
+            : _parent(tree.numberOfNodes(), NO_PARENT),
+              _n_children(tree.numberOfNodes(), 0),
+              _children_xor(tree.numberOfNodes(), 0)
         {
-            // otherwise, we connect its parent to its child
-            // (THERE CAN BE ONLY ONE!)
-            assert(tree.inDegree(node) == 1);
-            JoinSplitTree::Node parent = tree.source(tree.getFirstInArc(node));
-            for (ChildIterator<JoinSplitTree> it(tree, node); !it.done(); ++it)
+            for (ArcIterator<JoinSplitTree> it(tree); !it.done(); ++it)
             {
-                tree.addArc(parent, it.child());
+                unsigned int parent = tree.getID(tree.source(it.arc()));
+                unsigned int child = tree.getID(tree.target(it.arc()));
+
+                _parent[child] = parent;
+                _n_children[parent]++;
+                _children_xor[parent] ^= child;
             }
         }
 
-        tree.removeNode(node);
-    }
+        unsigned int parent(unsigned int v) const
+        {
+            return _parent[v];
+        }
+
+        unsigned int numberOfChildren(unsigned int v) const
+        {
+            return _n_children[v];
+        }
+
+        /// \brief Remove a node, connecting its parent to its child.
+        /// \pre The node has at most one child.
+        void reduce(unsigned int v)
+        {
+            assert(_n_children[v] <= 1);
+
+            unsigned int parent = _parent[v];
+
+            if (parent != NO_PARENT) {
+                _n_children[parent]--;
+                _children_xor[parent] ^= v;
+            }
+
+            if (_n_children[v] == 1) {
+                unsigned int child = _children_xor[v];
+                _parent[child] = parent;
+
+                if (parent != NO_PARENT) {
+                    _n_children[parent]++;
+                    _children_xor[parent] ^= child;
+                }
+            }
+
+            _parent[v] = NO_PARENT;
+            _n_children[v] = 0;
+            _children_xor[v] = 0;
+        }
+    };
 
 
     /// \brief Compute the merge tree.
+    /*!
+     *  The join and split trees are not modified.
+     */
     template <typename ScalarSimplicialComplex, typename UndirectedScalarMemberIDGraph>
     static void computeMergeTree(
         ScalarSimplicialComplex& plex,
-        JoinSplitTree& join_tree,
-        JoinSplitTree& split_tree,
+        const JoinSplitTree& input_join_tree,
+        const JoinSplitTree& input_split_tree,
         UndirectedScalarMemberIDGraph& merge_tree)
     {
         typedef UndirectedScalarMemberIDGraph MergeTree;
 
+        ParentArrayTree join_tree(input_join_tree);
+        ParentArrayTree split_tree(input_split_tree);
+
         // add all of the nodes from the plex to the merge tree
         // simultaneously, add nodes to the merge queue if they have a total
-        // of one child in the join and split tree
+        // of one child in the join and split tree. Nothing is ever removed
+        // from the middle of the queue, so it is a vector with a moving front
+        size_t n_nodes = plex.numberOfNodes();
+
+        std::vector<unsigned int> ids(n_nodes);
+        std::vector<double> values(n_nodes);
+        for (size_t i=0; i<n_nodes; ++i) {
+            ids[i] = i;
+            values[i] = plex.getValue(plex.getNode(i));
+        }
+
+        // the merge tree is a tree on the nodes of the plex, so its size is
+        // known up front
+        merge_tree.reserve(n_nodes, n_nodes);
+        if (n_nodes > 0) {
+            merge_tree.addNodes(&ids[0], &values[0], n_nodes);
+        }
+
         std::vector<typename MergeTree::Node> merge_tree_nodes;
-        std::queue<unsigned int> merge_queue;
+        merge_tree_nodes.reserve(n_nodes);
+
+        std::vector<unsigned int> merge_queue;
+        merge_queue.reserve(n_nodes);
+        size_t queue_front = 0;
 
-        for (size_t i=0; i<plex.numberOfNodes(); ++i) 
+        for (size_t i=0; i<n_nodes; ++i) 
         {
-            // add to the merge tree
-            typename MergeTree::Node node =
-                merge_tree.addNode(i, plex.getValue(plex.getNode(i)));
-            merge_tree_nodes.push_back(node);
+            merge_tree_nodes.push_back(merge_tree.getNode(i));
 
             // see if we should add this to the merge queue
-            if (join_tree.outDegree(join_tree.getNode(i)) +
-                    split_tree.outDegree(split_tree.getNode(i)) <= 1)
+            if (join_tree.numberOfChildren(i) + split_tree.numberOfChildren(i) <= 1)
             {
-                merge_queue.push(i);
+                merge_queue.push_back(i);
             }
         }
 
@@ -1195,8 +1953,7 @@ public:
         unsigned int i = 0;
         while (i < merge_tree.numberOfNodes() - 1) 
         {
-            unsigned int vi = merge_queue.front();
-            merge_queue.pop();
+            unsigned int vi = merge_queue[queue_front++];
 
             if (visited[vi])
             {
@@ -1208,35 +1965,34 @@ public:
                 visited[vi] = true;
             }
 
-            if ((join_tree.outDegree(join_tree.getNode(vi)) == 0) && 
-                (split_tree.outDegree(split_tree.getNode(vi)) == 0))
+            if ((join_tree.numberOfChildren(vi) == 0) && 
+                (split_tree.numberOfChildren(vi) == 0))
             {
-                JoinSplitTree::Node vk_join_node = join_tree.source(
-                                                   join_tree.getFirstInArc(
-                                                   join_tree.getNode(vi)));
-
-                JoinSplitTree::Node vk_split_node = split_tree.source(
-                                                    split_tree.getFirstInArc(
-                                                    split_tree.getNode(vi)));
+                unsigned int vk_join = join_tree.parent(vi);
+                unsigned int vk_split = split_tree.parent(vi);
 
-                unsigned int vk_join = join_tree.getID(vk_join_node);
-                unsigned int vk_split = split_tree.getID(vk_split_node);
+                if (vk_join == ParentArrayTree::NO_PARENT ||
+                    vk_split == ParentArrayTree::NO_PARENT)
+                {
+                    throw std::runtime_error("While merging trees, invalid node encountered. "
+                            "Was the input simplicial complex connected?");
+                }
 
                 merge_tree.addEdge(merge_tree_nodes[vi], merge_tree_nodes[vk_join]);
 
-                reduceNode(join_tree, join_tree.getNode(vi));
-                reduceNode(split_tree, split_tree.getNode(vi));
+                join_tree.reduce(vi);
+                split_tree.reduce(vi);
 
-                if (join_tree.outDegree(join_tree.getNode(vk_join)) +
-                    split_tree.outDegree(split_tree.getNode(vk_join)) <= 1)
+                if (join_tree.numberOfChildren(vk_join) +
+                    split_tree.numberOfChildren(vk_join) <= 1)
                 {
-                    merge_queue.push(vk_join);
+                    merge_queue.push_back(vk_join);
                 }
 
-                if (join_tree.outDegree(join_tree.getNode(vk_split)) +
-                    split_tree.outDegree(split_tree.getNode(vk_split)) <= 1)
+                if (join_tree.numberOfChildren(vk_split) +
+                    split_tree.numberOfChildren(vk_split) <= 1)
                 {
-                    merge_queue.push(vk_split);
+                    merge_queue.push_back(vk_split);
                 }
 
             }
@@ -1244,39 +2000,31 @@ public:
             {
                 unsigned int vk;
 
-                if (join_tree.outDegree(join_tree.getNode(vi)) == 0) 
+                if (join_tree.numberOfChildren(vi) == 0) 
                 {
                     // get the parent in the join tree
-                    JoinSplitTree::Node vk_node = join_tree.source(
-                                                  join_tree.getFirstInArc(
-                                                  join_tree.getNode(vi)));
+                    vk = join_tree.parent(vi);
 
-                    // if the input was invalid, vk_node may be invalid. We'll error
-                    // check here:
-                    if (!join_tree.isNodeValid(vk_node))
+                    // if the input was invalid, there may be no parent. We'll
+                    // error check here:
+                    if (vk == ParentArrayTree::NO_PARENT)
                     {
                         throw std::runtime_error("While merging trees, invalid node encountered in join tree. "
                                 "Was the input simplicial complex connected?");
                     }
-
-                    vk = join_tree.getID(vk_node);
                 } 
                 else 
                 {
                     // get the parent in the split tree
-                    JoinSplitTree::Node vk_node = split_tree.source(
-                                                  split_tree.getFirstInArc(
-                                                  split_tree.getNode(vi)));
+                    vk = split_tree.parent(vi);
 
-                    // if the input was invalid, vk_node may be invalid. We'll error
-                    // check here:
-                    if (!split_tree.isNodeValid(vk_node))
+                    // if the input was invalid, there may be no parent. We'll
+                    // error check here:
+                    if (vk == ParentArrayTree::NO_PARENT)
                     {
                         throw std::runtime_error("While merging trees, invalid node encountered in split tree. "
                                 "Was the input simplicial complex connected?");
                     }
-
-                    vk = split_tree.getID(vk_node);
                 }
 
 
@@ -1284,14 +2032,14 @@ public:
                 merge_tree.addEdge(merge_tree_nodes[vi], merge_tree_nodes[vk]);
 
                 // reduce the node in the join and split trees
-                reduceNode(join_tree, join_tree.getNode(vi));
-                reduceNode(split_tree, split_tree.getNode(vi));
+                join_tree.reduce(vi);
+                split_tree.reduce(vi);
 
                 // check to see if we have a new merge candidate
-                if (join_tree.outDegree(join_tree.getNode(vk)) +
-                        split_tree.outDegree(split_tree.getNode(vk)) <= 1) 
+                if (join_tree.numberOfChildren(vk) +
+                        split_tree.numberOfChildren(vk) <= 1) 
                 {
-                    merge_queue.push(vk);
+                    merge_queue.push_back(vk);
                 }
             }
         }
@@ -1343,6 +2091,15 @@ public:
 
 
     /// \brief Remove the regular nodes from the merge tree.
+    /*!
+     *  Regular nodes form monotone chains between non-regular nodes. Each
+     *  maximal chain is walked once and replaced by a single edge between
+     *  its ends, whose members are the chain's nodes together with the
+     *  members of its edges. The members are gathered in a scratch buffer
+     *  that is reused from chain to chain, and copied into the new edge
+     *  in one insertEdgeMembers() call, which sizes the edge's member set
+     *  once. The work is linear in the size of the tree.
+     */
     template <typename UndirectedScalarMemberIDGraph, typename TotalOrder>
     static void removeRegularNodes(
         UndirectedScalarMemberIDGraph& tree,
@@ -1352,46 +2109,92 @@ public:
         typedef typename Tree::Node Node;
         typedef typename Tree::Edge Edge;
         typedef typename UndirectedScalarMemberIDGraph::Member Member;
+        typedef typename UndirectedScalarMemberIDGraph::Members Members;
 
         // make a list of regular nodes
-        std::queue<Node> regular_nodes;
+        StaticNodeMap<Tree, bool> is_regular(tree);
+        std::vector<Node> regular_nodes;
         for (NodeIterator<Tree> it(tree); !it.done(); ++it) {
-            if (isRegularNode(tree, it.node(), order)) {
-                regular_nodes.push(it.node());
+            is_regular[it.node()] = isRegularNode(tree, it.node(), order);
+            if (is_regular[it.node()]) {
+                regular_nodes.push_back(it.node());
             }
         }
 
-        // now, remove them
-        while (regular_nodes.size() > 0) 
+        std::vector<Member> chain_members;
+        std::vector<Node> chain_nodes;
+
+        for (size_t i=0; i<regular_nodes.size(); ++i)
         {
-            Node v = regular_nodes.front();
-            regular_nodes.pop();
+            Node v = regular_nodes[i];
 
-            // get the two edges incident on this node
-            Edge edge_uv = tree.getFirstNeighborEdge(v);
-            Edge edge_vw = tree.getNextNeighborEdge(v, edge_uv);
+            // the node was part of a chain which has already been collapsed
+            if (!is_regular[v]) {
+                continue;
+            }
 
-            // get the neighboring nodes
-            Node u = tree.opposite(v, edge_uv);
-            Node w = tree.opposite(v, edge_vw);
+            // walk away from v to one end of the chain
+            Edge edge = tree.getFirstNeighborEdge(v);
+            Node node = v;
+            Node end = tree.opposite(node, edge);
+            while (is_regular[end]) {
+                edge = otherNeighborEdge(tree, end, edge);
+                node = end;
+                end = tree.opposite(node, edge);
+            }
 
-            // connect the neighbors
-            Edge edge_uw = tree.addEdge(u,w);
+            // then walk the whole chain back to the other end, collecting
+            // the members of its nodes and edges along the way
+            Node u = end;
+            chain_members.clear();
+            chain_nodes.clear();
+
+            node = tree.opposite(u, edge);
+            for (;;) {
+                const Members& edge_members = tree.getEdgeMembers(edge);
+                for (typename Members::const_iterator it = edge_members.begin();
+                        it != edge_members.end(); ++it) {
+                    chain_members.push_back(*it);
+                }
 
-            // add the to-be-deleted node to the new edge's members
-            Member member(tree.getID(v), tree.getValue(v));
-            tree.insertEdgeMember(edge_uw, member);
+                if (!is_regular[node]) {
+                    break;
+                }
+
+                chain_members.push_back(Member(tree.getID(node), tree.getValue(node)));
+                chain_nodes.push_back(node);
+                is_regular[node] = false;
+
+                edge = otherNeighborEdge(tree, node, edge);
+                node = tree.opposite(node, edge);
+            }
+
+            Node w = node;
 
-            // union the members from the old edges
-            tree.insertEdgeMembers(edge_uw, tree.getEdgeMembers(edge_uv));
-            tree.insertEdgeMembers(edge_uw, tree.getEdgeMembers(edge_vw));
+            // replace the chain by a single edge
+            for (size_t j=0; j<chain_nodes.size(); ++j) {
+                tree.removeNode(chain_nodes[j]);
+            }
 
-            // remove the middle node
-            tree.removeNode(v);
+            Edge edge_uw = tree.addEdge(u,w);
+            tree.insertEdgeMembers(edge_uw, chain_members.begin(), chain_members.end());
         }
     }
 
 private:
+    /// \brief Of the two edges at a degree two node, get the one that isn't `edge`.
+    template <typename UndirectedScalarMemberIDGraph>
+    static typename UndirectedScalarMemberIDGraph::Edge otherNeighborEdge(
+        const UndirectedScalarMemberIDGraph& tree,
+        typename UndirectedScalarMemberIDGraph::Node node,
+        typename UndirectedScalarMemberIDGraph::Edge edge)
+    {
+        typename UndirectedScalarMemberIDGraph::Edge first =
+            tree.getFirstNeighborEdge(node);
+
+        return first == edge ? tree.getNextNeighborEdge(node, first) : first;
+    }
+
     boost::shared_ptr<JoinSplitTree> _join_tree;
     boost::shared_ptr<JoinSplitTree> _split_tree;
 };
@@ -0,0 +1,522 @@
+// Copyright (c) 2014, Justin Eldridge, Mikhail Belkin, and Yusu Wang
+// at The Ohio State University. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef DENALI_EXTERNAL_H
+#define DENALI_EXTERNAL_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <denali/contour_tree.h>
+
+namespace denali {
+
+////////////////////////////////////////////////////////////////////////////
+//
+// ExternalSorter
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief Sorts a stream of 64 bit keys using temporary files.
+/// \ingroup contour_tree
+/*!
+ *  Keys are buffered in memory until the buffer holds `run_size` keys, at
+ *  which point it is sorted and written to a temporary file as a run. Once
+ *  every key has been inserted, finish() is called, and a Reader merges
+ *  the runs. If all of the keys fit in the buffer, no files are written.
+ */
+class ExternalSorter
+{
+public:
+    typedef boost::uint64_t Key;
+
+private:
+    std::string _directory;
+    size_t _run_size;
+    std::vector<Key> _buffer;
+    std::vector<std::string> _runs;
+    size_t _size;
+
+    // not copyable, since we own the run files
+    ExternalSorter(const ExternalSorter&);
+    ExternalSorter& operator=(const ExternalSorter&);
+
+    /// \brief Sort the buffer and write it to a new temporary file.
+    void writeRun()
+    {
+        std::sort(_buffer.begin(), _buffer.end());
+
+        std::string pattern = _directory + "/denali-run-XXXXXX";
+        std::vector<char> filename(pattern.begin(), pattern.end());
+        filename.push_back(0);
+
+        int fd = mkstemp(&filename[0]);
+        if (fd < 0) {
+            std::stringstream msg;
+            msg << "Couldn't create a temporary file in '" << _directory << "'";
+            throw std::runtime_error(msg.str());
+        }
+        close(fd);
+        _runs.push_back(&filename[0]);
+
+        std::ofstream fh(&filename[0], std::ios::out | std::ios::binary);
+        fh.write(reinterpret_cast<const char*>(&_buffer[0]),
+                 _buffer.size() * sizeof(Key));
+
+        if (!fh) {
+            std::stringstream msg;
+            msg << "Couldn't write to temporary file '" << _runs.back() << "'";
+            throw std::runtime_error(msg.str());
+        }
+
+        _buffer.clear();
+    }
+
+public:
+    ExternalSorter(const std::string& directory, size_t run_size)
+        : _directory(directory), _run_size(std::max(run_size, (size_t) 1)),
+          _size(0) { }
+
+    ~ExternalSorter()
+    {
+        for (size_t i=0; i<_runs.size(); ++i) {
+            std::remove(_runs[i].c_str());
+        }
+    }
+
+    void insert(Key key)
+    {
+        _buffer.push_back(key);
+        _size++;
+
+        if (_buffer.size() == _run_size) {
+            writeRun();
+        }
+    }
+
+    /// \brief Prepare the keys to be read.
+    void finish()
+    {
+        if (_runs.empty()) {
+            std::sort(_buffer.begin(), _buffer.end());
+        } else {
+            if (!_buffer.empty()) {
+                writeRun();
+            }
+            std::vector<Key>().swap(_buffer);
+        }
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    /// \brief Reads the sorted keys, merging the runs.
+    /*!
+     *  Each run is read through a buffer of BLOCK_SIZE keys.
+     */
+    class Reader
+    {
+        static const size_t BLOCK_SIZE = 1 << 16;
+
+        struct Run
+        {
+            boost::shared_ptr<std::ifstream> stream;
+            std::vector<Key> block;
+            size_t position;
+        };
+
+        typedef std::pair<Key, size_t> Head;
+
+        const std::vector<Key>& _buffer;
+        size_t _buffer_position;
+
+        std::vector<Run> _runs;
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head> > _heads;
+
+        bool refill(Run& run)
+        {
+            run.block.resize(BLOCK_SIZE);
+            run.stream->read(reinterpret_cast<char*>(&run.block[0]),
+                             BLOCK_SIZE * sizeof(Key));
+            run.block.resize(run.stream->gcount() / sizeof(Key));
+            run.position = 0;
+            return !run.block.empty();
+        }
+
+    public:
+        Reader(const ExternalSorter& sorter)
+            : _buffer(sorter._buffer), _buffer_position(0),
+              _runs(sorter._runs.size())
+        {
+            for (size_t i=0; i<_runs.size(); ++i) {
+                _runs[i].stream = boost::shared_ptr<std::ifstream>(new std::ifstream(
+                        sorter._runs[i].c_str(), std::ios::in | std::ios::binary));
+
+                if (!*_runs[i].stream) {
+                    std::stringstream msg;
+                    msg << "Couldn't open temporary file '" << sorter._runs[i] << "'";
+                    throw std::runtime_error(msg.str());
+                }
+
+                if (refill(_runs[i])) {
+                    _heads.push(Head(_runs[i].block[0], i));
+                }
+            }
+        }
+
+        /// \brief Get the next key. Returns false once all are read.
+        bool next(Key& key)
+        {
+            if (_runs.empty()) {
+                if (_buffer_position == _buffer.size()) {
+                    return false;
+                }
+                key = _buffer[_buffer_position++];
+                return true;
+            }
+
+            if (_heads.empty()) {
+                return false;
+            }
+
+            Head head = _heads.top();
+            _heads.pop();
+            key = head.first;
+
+            Run& run = _runs[head.second];
+            if (++run.position < run.block.size() || refill(run)) {
+                _heads.push(Head(run.block[run.position], head.second));
+            }
+
+            return true;
+        }
+    };
+};
+
+////////////////////////////////////////////////////////////////////////////
+//
+// ExternalScalarSimplicialComplex
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief A scalar simplicial complex whose edges are kept on disk.
+/// \ingroup contour_tree
+/*!
+ *  Only the vertex values and their total order are kept in memory. As
+ *  edges are added they are written, in the order in which the join and
+ *  split sweeps of ExternalCarrsAlgorithm will visit them, to temporary
+ *  files in the given directory. Memory use is therefore proportional to
+ *  the number of vertices, plus a fixed buffer for the edges.
+ *
+ *  All vertices must be added before the first edge. Once every edge has
+ *  been added, freeze() must be called.
+ *
+ *  The complex supports just enough of concepts::ScalarSimplicialComplex
+ *  to be read from a file and written with writeJoinSplitTreeFile(); it
+ *  cannot be iterated over.
+ */
+class ExternalScalarSimplicialComplex
+{
+public:
+    typedef unsigned int Node;
+
+    /// \brief The default memory available for buffering edges: 1 GB.
+    static const size_t DEFAULT_MEMORY_LIMIT = 1 << 30;
+
+private:
+    std::vector<double> _values;
+    boost::shared_ptr<TotalOrder> _order;
+
+    // edges keyed by (higher position, lower position), ascending
+    ExternalSorter _join_edges;
+
+    // edges keyed by (complement of lower position, higher position), ascending
+    ExternalSorter _split_edges;
+
+    size_t _number_of_edges;
+
+public:
+    /// \brief Create a complex that keeps its edges in `directory`.
+    /*!
+     *  At most `memory_limit` bytes are used to buffer edges.
+     */
+    ExternalScalarSimplicialComplex(
+            const std::string& directory,
+            size_t memory_limit = DEFAULT_MEMORY_LIMIT)
+        : _join_edges(directory, memory_limit / (2 * sizeof(ExternalSorter::Key))),
+          _split_edges(directory, memory_limit / (2 * sizeof(ExternalSorter::Key))),
+          _number_of_edges(0) { }
+
+    /// \brief Add a node to the complex, with associated scalar value.
+    Node addNode(double value)
+    {
+        if (_order) {
+            throw std::runtime_error("Vertices must be added before edges.");
+        }
+
+        _values.push_back(value);
+        return _values.size() - 1;
+    }
+
+    /// \brief Add several nodes at once, with the given scalar values.
+    void addNodes(const double* values, size_t n_nodes)
+    {
+        if (_order) {
+            throw std::runtime_error("Vertices must be added before edges.");
+        }
+
+        _values.insert(_values.end(), values, values + n_nodes);
+    }
+
+    /// \brief Add an edge to the complex.
+    void addEdge(Node u, Node v)
+    {
+        if (u >= _values.size() || v >= _values.size()) {
+            throw std::runtime_error("Edge refers to a nonexistent node.");
+        }
+
+        // the first edge fixes the vertices, so they can now be ordered
+        if (!_order) {
+            RandomAccessValueSorter<std::vector<double> > sorter(_values);
+            _order = boost::shared_ptr<TotalOrder>(
+                    new TotalOrder(TotalOrder::compute(_values, sorter)));
+        }
+
+        boost::uint64_t pu = _order->elementToPosition(u);
+        boost::uint64_t pv = _order->elementToPosition(v);
+        boost::uint64_t hi = std::max(pu, pv);
+        boost::uint64_t lo = std::min(pu, pv);
+
+        _join_edges.insert((hi << 32) | lo);
+        _split_edges.insert(((~lo & 0xffffffff) << 32) | hi);
+        _number_of_edges++;
+    }
+
+    /// \brief Add several edges at once.
+    /*!
+     *  `edges` holds `n_edges` consecutive pairs of node ids.
+     */
+    void addEdges(const unsigned int* edges, size_t n_edges)
+    {
+        for (size_t i=0; i<n_edges; ++i) {
+            addEdge(edges[2*i], edges[2*i + 1]);
+        }
+    }
+
+    /// \brief Finish adding edges.
+    void freeze()
+    {
+        if (!_order) {
+            RandomAccessValueSorter<std::vector<double> > sorter(_values);
+            _order = boost::shared_ptr<TotalOrder>(
+                    new TotalOrder(TotalOrder::compute(_values, sorter)));
+        }
+
+        _join_edges.finish();
+        _split_edges.finish();
+    }
+
+    double getValue(Node node) const
+    {
+        return _values[node];
+    }
+
+    Node getNode(unsigned int index) const
+    {
+        return index;
+    }
+
+    unsigned int getID(Node node) const
+    {
+        return node;
+    }
+
+    size_t numberOfNodes() const
+    {
+        return _values.size();
+    }
+
+    size_t numberOfEdges() const
+    {
+        return _number_of_edges;
+    }
+
+    /// \brief The total order of the vertices.
+    /// \pre freeze() has been called.
+    const TotalOrder& getTotalOrder() const
+    {
+        return *_order;
+    }
+
+    const ExternalSorter& getJoinEdges() const
+    {
+        return _join_edges;
+    }
+
+    const ExternalSorter& getSplitEdges() const
+    {
+        return _split_edges;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////
+//
+// ExternalCarrsAlgorithm
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief Carr's algorithm for an ExternalScalarSimplicialComplex.
+/// \ingroup contour_tree
+/*!
+ *  The join and split trees are each built in a single pass over the
+ *  edges, which the complex has already sorted on disk, and then merged
+ *  as in CarrsAlgorithm. The resulting contour tree is the same.
+ */
+class ExternalCarrsAlgorithm
+{
+public:
+    typedef CarrsAlgorithm::JoinSplitTree JoinSplitTree;
+
+private:
+    boost::shared_ptr<JoinSplitTree> _join_tree;
+    boost::shared_ptr<JoinSplitTree> _split_tree;
+
+public:
+    /// \brief Compute the contour tree of an external complex.
+    /*!
+     *  \throws std::runtime_error if the complex is not connected.
+     */
+    template <typename UndirectedScalarMemberIDGraph>
+    void compute(
+        const ExternalScalarSimplicialComplex& plex,
+        UndirectedScalarMemberIDGraph& graph)
+    {
+        graph.clear();
+
+        const TotalOrder& order = plex.getTotalOrder();
+
+        _join_tree = boost::shared_ptr<JoinSplitTree>(
+                new JoinSplitTree(computeJoinTree(plex)));
+
+        _split_tree = boost::shared_ptr<JoinSplitTree>(
+                new JoinSplitTree(computeSplitTree(plex)));
+
+        CarrsAlgorithm::computeMergeTree(plex, *_join_tree, *_split_tree, graph);
+
+        CarrsAlgorithm::removeRegularNodes(graph, order);
+
+        graph.compact();
+    }
+
+    /// \brief Has no effect; see CarrsAlgorithm::setCopyJoinSplitTrees().
+    void setCopyJoinSplitTrees(bool) {}
+
+    const JoinSplitTree& getJoinTree() const {
+        return *_join_tree;
+    }
+
+    const JoinSplitTree& getSplitTree() const {
+        return *_split_tree;
+    }
+
+    /// \brief Compute the directed join tree in one pass over the edges.
+    static JoinSplitTree computeJoinTree(
+        const ExternalScalarSimplicialComplex& plex)
+    {
+        const TotalOrder& order = plex.getTotalOrder();
+
+        JoinSplitTree join_tree(order.size());
+        DisjointSetForest<TotalOrder> forest(order);
+        size_t n_components = order.size();
+
+        // edges arrive sorted by their higher endpoint, so this visits the
+        // vertices in the same order as CarrsAlgorithm::computeJoinTree
+        ExternalSorter::Reader reader(plex.getJoinEdges());
+        ExternalSorter::Key key;
+        while (reader.next(key)) {
+            unsigned int vi = order.positionToElement(key >> 32);
+            unsigned int vj = order.positionToElement(key & 0xffffffff);
+
+            if (vi != vj && forest.findSet(vi) != forest.findSet(vj)) {
+                unsigned int vk = forest.findMax(vj);
+                join_tree.addArc(join_tree.getNode(vi), join_tree.getNode(vk));
+                forest.setUnion(vi, vj);
+                n_components--;
+            }
+        }
+
+        if (n_components > 1) {
+            throw std::runtime_error("The input graph is not connected.");
+        }
+
+        return join_tree;
+    }
+
+    /// \brief Compute the directed split tree in one pass over the edges.
+    static JoinSplitTree computeSplitTree(
+        const ExternalScalarSimplicialComplex& plex)
+    {
+        const TotalOrder& order = plex.getTotalOrder();
+
+        JoinSplitTree split_tree(order.size());
+        DisjointSetForest<TotalOrder> forest(order);
+
+        // edges arrive sorted by their lower endpoint, in descending order
+        ExternalSorter::Reader reader(plex.getSplitEdges());
+        ExternalSorter::Key key;
+        while (reader.next(key)) {
+            unsigned int vi = order.positionToElement(~(key >> 32) & 0xffffffff);
+            unsigned int vj = order.positionToElement(key & 0xffffffff);
+
+            if (vi != vj && forest.findSet(vi) != forest.findSet(vj)) {
+                unsigned int vk = forest.findMin(vj);
+                split_tree.addArc(split_tree.getNode(vi), split_tree.getNode(vk));
+                forest.setUnion(vi, vj);
+            }
+        }
+
+        return split_tree;
+    }
+};
+
+}
+
+#endif
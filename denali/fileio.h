@@ -25,6 +25,7 @@
 #ifndef DENALI_FILEIO_H
 #define DENALI_FILEIO_H
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
@@ -32,8 +33,18 @@
 #include <sstream>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/cstdint.hpp>
+
+#include <denali/compressed_members.h>
 #include <denali/contour_tree.h>
 #include <denali/graph_iterators.h>
+#include <denali/lazy_members.h>
+#include <denali/snapshot.h>
 
 namespace denali {
 
@@ -53,37 +64,119 @@ inline void safeOpenFile(const char* filename, std::ifstream& fh)
 }
 
 
+/// \brief The fields of a line in a tabular file.
+/*!
+ *  Each field is a null-terminated string pointing into the parser's buffer,
+ *  and is only valid for the duration of the FormatParser's insert() call.
+ */
+typedef std::vector<const char*> TabularLine;
+
+
+inline bool isTabularSeparator(char c)
+{
+    return c == '\t' || c == ' ';
+}
+
+
+/// \brief Split a null-terminated line into fields, in place.
+inline void tokenizeTabularLine(char* line, TabularLine& fields)
+{
+    fields.clear();
+
+    char* c = line;
+    for (;;) {
+        while (isTabularSeparator(*c)) {
+            ++c;
+        }
+
+        if (*c == 0) {
+            break;
+        }
+
+        fields.push_back(c);
+
+        while (*c != 0 && !isTabularSeparator(*c)) {
+            ++c;
+        }
+
+        if (*c == 0) {
+            break;
+        }
+
+        *c++ = 0;
+    }
+}
+
+
 /// \brief Parses a tabular file, calling FormatParser to handle each line.
+/*!
+ *  The stream is read in large blocks, and each line is split into
+ *  TabularLine fields in place. Fields are separated by tabs and spaces.
+ *  The buffers are reused from line to line, and from one parse() to the
+ *  next, so that parsing does not allocate.
+ */
 class TabularFileParser
 {
+    static const size_t BLOCK_SIZE = 1 << 20;
+
+    std::vector<char> _buffer;
+    TabularLine _fields;
+
+    void tokenize(char* line)
+    {
+        tokenizeTabularLine(line, _fields);
+    }
+
 public:
     template <typename FormatParser>
     void parse(std::istream& tabstream, FormatParser& parser)
     {
-        std::string line;
-        tabstream.exceptions(std::ifstream::goodbit);
-        while (std::getline(tabstream, line)) {
+        // reading the last block sets the failbit, which isn't an error
+        tabstream.exceptions(std::ifstream::badbit);
 
-            tabstream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            std::vector<std::string> tokenized_line;
+        // one extra character is kept to terminate the final line
+        if (_buffer.size() < BLOCK_SIZE + 1) {
+            _buffer.resize(BLOCK_SIZE + 1);
+        }
 
-            // add one to the size to account for null
-            char * cline = new char[line.size() + 1];
+        // the unprocessed characters are [begin, end)
+        size_t begin = 0;
+        size_t end = 0;
 
-            // copy the line
-            strcpy(cline, line.c_str());
+        for (;;) {
+            // move the incomplete line, if any, to the front of the buffer
+            if (begin > 0) {
+                memmove(&_buffer[0], &_buffer[begin], end - begin);
+                end -= begin;
+                begin = 0;
+            }
 
-            // tokenize it
-            char * pch = strtok(cline, "\t ");
-            while (pch != NULL) {
-                tokenized_line.push_back(pch);
-                pch = strtok(NULL, "\t ");
+            // if the line fills the whole buffer, make room for more
+            if (end == _buffer.size() - 1) {
+                _buffer.resize(2 * _buffer.size());
             }
 
-            delete [] cline;
-            parser.insert(tokenized_line);
+            tabstream.read(&_buffer[end], _buffer.size() - 1 - end);
+            end += tabstream.gcount();
+
+            char* newline;
+            while ((newline = static_cast<char*>(
+                        memchr(&_buffer[begin], '\n', end - begin))) != NULL) {
+                *newline = 0;
+                tokenize(&_buffer[begin]);
+                parser.insert(_fields);
+                begin = newline - &_buffer[0] + 1;
+            }
 
-            tabstream.exceptions(std::ifstream::goodbit);
+            if (!tabstream) {
+                // a final line with no newline
+                if (begin < end) {
+                    _buffer[end] = 0;
+                    tokenize(&_buffer[begin]);
+                    parser.insert(_fields);
+                }
+                break;
+            }
         }
     }
 };
@@ -100,12 +193,16 @@ class VertexValueFormatParser
     ScalarSimplicialComplex& plex;
     int lineno;
 
+    // values are handed to the complex in chunks of this many
+    static const size_t CHUNK_SIZE = 1 << 16;
+    std::vector<double> values;
+
 public:
 
     VertexValueFormatParser(ScalarSimplicialComplex& plex)
         : plex(plex), lineno(0) { }
 
-    void insert(std::vector<std::string>& line)
+    void insert(const TabularLine& line)
     {
         if (line.size() == 0) {
             std::stringstream msg;
@@ -121,7 +218,7 @@ public:
 
         // convert the first element to a double
         char * err;
-        double value = strtod(line.front().c_str(), &err);
+        double value = strtod(line[0], &err);
 
         if (*err != 0) {
             std::stringstream msg;
@@ -130,7 +227,20 @@ public:
         }
 
         lineno++;
-        plex.addNode(value);
+        values.push_back(value);
+
+        if (values.size() >= CHUNK_SIZE) {
+            flush();
+        }
+    }
+
+    /// \brief Add the values read so far to the complex.
+    void flush()
+    {
+        if (!values.empty()) {
+            plex.addNodes(&values[0], values.size());
+            values.clear();
+        }
     }
 };
 
@@ -148,6 +258,7 @@ void readSimplicialVertexFile(
     std::ifstream fh;
     safeOpenFile(filename, fh);
     parser.parse(fh, format_parser);
+    format_parser.flush();
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -162,13 +273,18 @@ class EdgeFormatParser
     ScalarSimplicialComplex& plex;
     int lineno;
 
+    // edges are handed to the complex in chunks of this many, as
+    // consecutive pairs of node ids
+    static const size_t CHUNK_SIZE = 1 << 16;
+    std::vector<unsigned int> edges;
+
 public:
 
     EdgeFormatParser(ScalarSimplicialComplex& plex)
         : plex(plex), lineno(0) { }
 
 
-    void insert(std::vector<std::string>& line)
+    void insert(const TabularLine& line)
     {
         if (line.size() != 2) {
             std::stringstream msg;
@@ -177,17 +293,40 @@ public:
         }
 
         char * err_u;
-        long int u = strtol(line[0].c_str(), &err_u, 10);
+        long int u = strtol(line[0], &err_u, 10);
         char * err_v;
-        long int v = strtol(line[1].c_str(), &err_v, 10);
+        long int v = strtol(line[1], &err_v, 10);
 
         if (*err_u != 0 || *err_v != 0) {
             std::stringstream msg;
             msg << "Problem interpreting line " << lineno << " as an edge.";
             throw std::runtime_error(msg.str());
         }
+
+        if (u < 0 || v < 0 ||
+                (unsigned long int) u > 0xffffffffUL ||
+                (unsigned long int) v > 0xffffffffUL) {
+            std::stringstream msg;
+            msg << "Node id out of range on line " << lineno << ".";
+            throw std::runtime_error(msg.str());
+        }
+
         lineno++;
-        plex.addEdge(plex.getNode(u),plex.getNode(v));
+        edges.push_back(u);
+        edges.push_back(v);
+
+        if (edges.size() >= 2*CHUNK_SIZE) {
+            flush();
+        }
+    }
+
+    /// \brief Add the edges read so far to the complex.
+    void flush()
+    {
+        if (!edges.empty()) {
+            plex.addEdges(&edges[0], edges.size() / 2);
+            edges.clear();
+        }
     }
 };
 
@@ -205,216 +344,1278 @@ void readSimplicialEdgeFile(
     std::ifstream fh;
     safeOpenFile(filename, fh);
     parser.parse(fh, format_parser);
+    format_parser.flush();
 }
 
 ////////////////////////////////////////////////////////////////////////////
 //
-// WriteContourTree
+// Binary vertex and edge files
 //
 ////////////////////////////////////////////////////////////////////////////
 
-/// \brief Write a contour tree to a file.
-/// \ingroup fileio
-template <typename ContourTree>
-void writeContourTreeFile(
-    const char * filename,
-    const ContourTree& tree)
+/*
+ *  A binary vertex or edge file begins with a 24 byte header:
+ *
+ *      bytes  0-7      the magic string "DNLVERT" or "DNLEDGE", null terminated
+ *      bytes  8-11     the format version, uint32
+ *      bytes 12-15     reserved, zero
+ *      bytes 16-23     the number of records, uint64
+ *
+ *  It is followed by the records themselves: one float64 per vertex, or a
+ *  pair of uint32 node ids per edge. Everything is little-endian.
+ */
+
+const char BINARY_VERTEX_MAGIC[] = "DNLVERT";
+const char BINARY_EDGE_MAGIC[] = "DNLEDGE";
+const boost::uint32_t BINARY_FORMAT_VERSION = 1;
+const size_t BINARY_HEADER_SIZE = 24;
+const size_t BINARY_RECORD_SIZE = 8;
+
+
+inline bool isLittleEndianHost()
 {
-    typedef typename ContourTree::Members Members;
+    const boost::uint32_t one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
 
-    std::ofstream fh;
-    fh.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        fh.open(filename);
-    }
-    catch (std::exception& e) {
-        std::stringstream message;
-        message << "Couldn't open file '" << filename << "'";
-        throw std::runtime_error(message.str());
-    }
 
-    // write the number of vertices
-    fh << tree.numberOfNodes() << std::endl;
+inline boost::uint32_t decodeLittleEndian32(const char* bytes)
+{
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(bytes);
+    return  (boost::uint32_t) b[0]        | ((boost::uint32_t) b[1] << 8) |
+           ((boost::uint32_t) b[2] << 16) | ((boost::uint32_t) b[3] << 24);
+}
 
-    // write each vertex (node and member alike) to the file
-    for (NodeIterator<ContourTree> it(tree); !it.done(); ++it)
-    {
-        fh << tree.getID(it.node()) << "\t" 
-           << tree.getValue(it.node()) << std::endl;
-    }
 
-    // write each edge to the file
-    for (EdgeIterator<ContourTree> it(tree);
-            !it.done(); ++it) {
-        fh << tree.getID(tree.u(it.edge()))
-           << "\t"
-           << tree.getID(tree.v(it.edge()));
+inline boost::uint64_t decodeLittleEndian64(const char* bytes)
+{
+    return  (boost::uint64_t) decodeLittleEndian32(bytes) |
+           ((boost::uint64_t) decodeLittleEndian32(bytes + 4) << 32);
+}
 
-        const Members& members = tree.getEdgeMembers(it.edge());
 
-        for (typename Members::const_iterator m_it = members.begin();
-                m_it != members.end(); ++m_it) {
-            fh << "\t" << m_it->getID() << "\t" << m_it->getValue();
-        }
+inline double decodeLittleEndianDouble(const char* bytes)
+{
+    boost::uint64_t bits = decodeLittleEndian64(bytes);
+    double value;
+    memcpy(&value, &bits, sizeof(double));
+    return value;
+}
 
-        fh << std::endl;
-    }
 
-    fh.close();
+inline void encodeLittleEndian32(boost::uint32_t value, char* bytes)
+{
+    for (int i=0; i<4; ++i) {
+        bytes[i] = (char) ((value >> (8*i)) & 0xff);
+    }
 }
 
-////////////////////////////////////////////////////////////////////////////
-//
-// ReadContourTree
-//
-////////////////////////////////////////////////////////////////////////////
 
-template <typename GraphType>
-class ContourTreeFormatParser
+inline void encodeLittleEndian64(boost::uint64_t value, char* bytes)
 {
-    typedef std::vector<std::string> Line;
-    typedef typename GraphType::Node Node;
-    typedef typename GraphType::Edge Edge;
-    typedef typename GraphType::Member Member;
+    encodeLittleEndian32((boost::uint32_t) (value & 0xffffffff), bytes);
+    encodeLittleEndian32((boost::uint32_t) (value >> 32), bytes + 4);
+}
 
-    GraphType& _graph;
-    unsigned int _lineno;
-    unsigned int _n_vertices;
 
-    std::vector<double> _vertex_values;
+/// \brief A read-only memory mapping of a whole file.
+class MappedFile
+{
+    const char* _data;
+    size_t _size;
+
+    // not copyable
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
 
 public:
+    MappedFile(const char* filename)
+        : _data(0), _size(0)
+    {
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) {
+            std::stringstream message;
+            message << "Couldn't open file '" << filename << "'";
+            throw std::runtime_error(message.str());
+        }
 
-    ContourTreeFormatParser(GraphType& graph)
-        : _graph(graph), _lineno(0) { }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            std::stringstream message;
+            message << "Couldn't read the size of file '" << filename << "'";
+            throw std::runtime_error(message.str());
+        }
 
-    void insert(const Line& line)
-    {
-        if (_lineno == 0) {
-            readNumberOfVertices(line);
-        } else if (_lineno <= _n_vertices) {
-            readVertexLine(line);
+        _size = info.st_size;
+
+        // mapping an empty file is an error, so don't bother
+        if (_size > 0) {
+            void* data = mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+
+            if (data == MAP_FAILED) {
+                std::stringstream message;
+                message << "Couldn't map file '" << filename << "' into memory";
+                throw std::runtime_error(message.str());
+            }
+
+            madvise(data, _size, MADV_SEQUENTIAL);
+            _data = static_cast<const char*>(data);
         } else {
-            readEdgeLine(line);
+            ::close(fd);
         }
-        _lineno++;
     }
 
-    void readNumberOfVertices(const Line& line)
+    ~MappedFile()
     {
-        if (line.size() != 1) {
-            throw std::runtime_error(
-                "The contour tree file's first line is malformed. It "
-                "should be a single integer describing the number "
-                "of vertices in the file.");
+        if (_data) {
+            munmap(const_cast<char*>(_data), _size);
         }
+    }
 
-        char * err;
-        _n_vertices = strtol(line[0].c_str(), &err, 10);
+    const char* data() const
+    {
+        return _data;
+    }
 
-        if (*err != 0) {
-            throw std::runtime_error(
-                "Could not interpret first line of contour tree file.");
-        }
+    size_t size() const
+    {
+        return _size;
+    }
+};
 
-        _vertex_values.resize(_n_vertices);
 
+/// \brief Checks the header of a mapped binary file.
+/*!
+ *  \returns The number of records in the file.
+ *  \throws std::runtime_error if the header is malformed, or if the file
+ *      is not the size the header promises.
+ */
+inline size_t checkBinaryHeader(
+    const MappedFile& file,
+    const char* magic,
+    const char* filename)
+{
+    std::stringstream msg;
+    msg << "The file '" << filename << "' ";
+
+    if (file.size() < BINARY_HEADER_SIZE || memcmp(file.data(), magic, 8) != 0) {
+        msg << "is not a binary " 
+            << (strcmp(magic, BINARY_VERTEX_MAGIC) == 0 ? "vertex" : "edge") << " file.";
+        throw std::runtime_error(msg.str());
     }
 
-    void readVertexLine(const Line& line)
-    {
-        std::stringstream msg;
-        msg << "The contour tree file has a malformed vertex definition on line "
-            << _lineno + 1 << ".";
+    boost::uint32_t version = decodeLittleEndian32(file.data() + 8);
+    if (version != BINARY_FORMAT_VERSION) {
+        msg << "has unsupported format version " << version << ".";
+        throw std::runtime_error(msg.str());
+    }
 
-        if (line.size() != 2) {
-            throw std::runtime_error(msg.str());
-        }
+    boost::uint64_t n_records = decodeLittleEndian64(file.data() + 16);
+    if (n_records != (file.size() - BINARY_HEADER_SIZE) / BINARY_RECORD_SIZE ||
+            (file.size() - BINARY_HEADER_SIZE) % BINARY_RECORD_SIZE != 0) {
+        msg << "is truncated or corrupt.";
+        throw std::runtime_error(msg.str());
+    }
 
-        char* id_err;
-        long int id = strtol(line[0].c_str(), &id_err, 10);
+    return n_records;
+}
 
-        char* value_err;
-        double value = strtod(line[1].c_str(), &value_err);
 
-        if (*value_err != 0 || *id_err !=0 || id < 0) {
-            throw std::runtime_error(msg.str());
-        }
+/// \brief Checks whether a file starts with the given magic string.
+inline bool hasBinaryMagic(const char* filename, const char* magic)
+{
+    std::ifstream fh(filename, std::ios::in | std::ios::binary);
+    char buffer[8];
+    return fh.read(buffer, 8) && memcmp(buffer, magic, 8) == 0;
+}
+
+
+/// \brief Checks whether a file is a binary vertex file.
+/// \ingroup fileio
+inline bool isBinaryVertexFile(const char* filename)
+{
+    return hasBinaryMagic(filename, BINARY_VERTEX_MAGIC);
+}
+
+
+/// \brief Checks whether a file is a binary edge file.
+/// \ingroup fileio
+inline bool isBinaryEdgeFile(const char* filename)
+{
+    return hasBinaryMagic(filename, BINARY_EDGE_MAGIC);
+}
 
-        _graph.addNode(id, value);
+
+/// \brief Read vertex values from a binary file into a scalar simplicial complex.
+/// \ingroup fileio
+template <typename ScalarSimplicialComplex>
+void readBinaryVertexFile(
+    const char * filename,
+    ScalarSimplicialComplex& plex)
+{
+    MappedFile file(filename);
+    size_t n_vertices = checkBinaryHeader(file, BINARY_VERTEX_MAGIC, filename);
+    const char* records = file.data() + BINARY_HEADER_SIZE;
+
+    if (isLittleEndianHost()) {
+        // the mapping is page aligned, so the records are 8 byte aligned
+        plex.addNodes(reinterpret_cast<const double*>(records), n_vertices);
+    } else {
+        std::vector<double> values(n_vertices);
+        for (size_t i=0; i<n_vertices; ++i) {
+            values[i] = decodeLittleEndianDouble(records + i*BINARY_RECORD_SIZE);
+        }
+        plex.addNodes(values.empty() ? 0 : &values[0], n_vertices);
     }
+}
 
-    void readEdgeLine(const Line& line)
-    {
-        std::stringstream msg;
-        msg << "The contour tree file has a malformed edge definition on line "
-            << _lineno+1 << ".";
 
-        if (line.size() < 2 || line.size() % 2 != 0) {
-            throw std::runtime_error(msg.str());
+/// \brief Read vertex values from a binary file into a compact complex.
+/// \ingroup fileio
+/*!
+ *  On little-endian machines the values are copied in a single block.
+ */
+inline void readBinaryVertexFile(
+    const char * filename,
+    CompactScalarSimplicialComplex& plex)
+{
+    MappedFile file(filename);
+    size_t n_vertices = checkBinaryHeader(file, BINARY_VERTEX_MAGIC, filename);
+    const char* records = file.data() + BINARY_HEADER_SIZE;
+
+    if (isLittleEndianHost()) {
+        // the mapping is page aligned, so the records are 8 byte aligned
+        plex.addNodes(reinterpret_cast<const double*>(records), n_vertices);
+    } else {
+        for (size_t i=0; i<n_vertices; ++i) {
+            plex.addNode(decodeLittleEndianDouble(records + i*BINARY_RECORD_SIZE));
         }
+    }
+}
 
-        char * u_err;
-        char * v_err;
-        unsigned int u_id = strtol(line[0].c_str(), &u_err, 10);
-        unsigned int v_id = strtol(line[1].c_str(), &v_err, 10);
 
-        if (*u_err != 0 || *v_err != 0) {
+/// \brief Read edges from a binary file into a scalar simplicial complex.
+/// \ingroup fileio
+/*!
+ *  The edges are handed to the complex in fixed-size chunks, so that
+ *  reading them takes no more memory than the complex itself does.
+ *
+ *  \pre The vertices must already be in the complex.
+ */
+template <typename ScalarSimplicialComplex>
+void readBinaryEdgeFile(
+    const char * filename,
+    ScalarSimplicialComplex& plex)
+{
+    // the number of edges in a chunk
+    static const size_t CHUNK_SIZE = 1 << 16;
+
+    MappedFile file(filename);
+    size_t n_edges = checkBinaryHeader(file, BINARY_EDGE_MAGIC, filename);
+    const char* records = file.data() + BINARY_HEADER_SIZE;
+
+    size_t n_nodes = plex.numberOfNodes();
+    std::vector<unsigned int> edges;
+    edges.reserve(2*std::min(n_edges, CHUNK_SIZE));
+    for (size_t i=0; i<n_edges; ++i) {
+        unsigned int u = decodeLittleEndian32(records + i*BINARY_RECORD_SIZE);
+        unsigned int v = decodeLittleEndian32(records + i*BINARY_RECORD_SIZE + 4);
+
+        if (u >= n_nodes || v >= n_nodes) {
+            std::stringstream msg;
+            msg << "Edge " << i << " in '" << filename
+                << "' refers to a nonexistent vertex.";
             throw std::runtime_error(msg.str());
         }
 
-        Node u = _graph.getNode(u_id);
-        Node v = _graph.getNode(v_id);
+        edges.push_back(u);
+        edges.push_back(v);
 
-        Edge edge = _graph.addEdge(u,v);
+        if (edges.size() >= 2*CHUNK_SIZE || i + 1 == n_edges) {
+            plex.addEdges(&edges[0], edges.size() / 2);
+            edges.clear();
+        }
+    }
+}
 
-        for (size_t i=2; i<line.size(); i+=2) {
-            char* id_err;
-            unsigned int member_id = strtol(line[i].c_str(), &id_err, 10);
 
-            char* value_err;
-            double member_value = strtod(line[i+1].c_str(), &value_err);
+/// \brief Read edges from a binary file into a compact complex, and freeze it.
+/// \ingroup fileio
+/*!
+ *  On little-endian machines the graph is built straight from the mapped
+ *  file, without parsing or copying the edges.
+ *
+ *  \pre The vertices must already be in the complex.
+ */
+inline void readBinaryEdgeFile(
+    const char * filename,
+    CompactScalarSimplicialComplex& plex)
+{
+    MappedFile file(filename);
+    size_t n_edges = checkBinaryHeader(file, BINARY_EDGE_MAGIC, filename);
+    const char* records = file.data() + BINARY_HEADER_SIZE;
+
+    if (isLittleEndianHost()) {
+        plex.freeze(reinterpret_cast<const unsigned int*>(records), n_edges);
+    } else {
+        std::vector<unsigned int> edges(2*n_edges);
+        for (size_t i=0; i<2*n_edges; ++i) {
+            edges[i] = decodeLittleEndian32(records + 4*i);
+        }
+        plex.freeze(edges.empty() ? 0 : &edges[0], n_edges);
+    }
+}
 
-            if (*id_err != 0 || *value_err != 0) {
-                throw std::runtime_error(msg.str());
-            }
 
-            Member member(member_id, member_value);
-            _graph.insertEdgeMember(edge, member);
+/// \brief Writes the header and records of a binary vertex or edge file.
+/*!
+ *  The number of records is only known once close() is called, at which
+ *  point it is written into the header.
+ */
+class BinaryFileWriter
+{
+    std::ofstream _fh;
+    boost::uint64_t _n_records;
+
+protected:
+    BinaryFileWriter(const char* filename, const char* magic)
+        : _n_records(0)
+    {
+        _fh.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        try {
+            _fh.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
         }
+        catch (std::exception& e) {
+            std::stringstream message;
+            message << "Couldn't open file '" << filename << "'";
+            throw std::runtime_error(message.str());
+        }
+
+        char header[BINARY_HEADER_SIZE] = {0};
+        memcpy(header, magic, 8);
+        encodeLittleEndian32(BINARY_FORMAT_VERSION, header + 8);
+        _fh.write(header, BINARY_HEADER_SIZE);
+    }
 
+    void writeRecord(const char* record)
+    {
+        _fh.write(record, BINARY_RECORD_SIZE);
+        _n_records++;
     }
 
+public:
+    /// \brief Write the number of records to the header and close the file.
+    void close()
+    {
+        char count[8];
+        encodeLittleEndian64(_n_records, count);
+        _fh.seekp(16);
+        _fh.write(count, 8);
+        _fh.close();
+    }
 };
 
 
-/// \brief Read a contour tree from a stream.
+/// \brief Writes a binary vertex file.
 /// \ingroup fileio
-inline ContourTree readContourTreeFromStream(
-    std::istream& ctstream)
+/*!
+ *  Vertices are written as they are added, so the writer can be handed to
+ *  readSimplicialVertexFile() to convert a text file to binary.
+ */
+class BinaryVertexFileWriter : public BinaryFileWriter
 {
-    // make a new graph object
-    boost::shared_ptr<ContourTree::Graph> graph(new ContourTree::Graph);
+public:
+    BinaryVertexFileWriter(const char* filename)
+        : BinaryFileWriter(filename, BINARY_VERTEX_MAGIC) { }
 
-    // make a new contour tree format parser
-    ContourTreeFormatParser<ContourTree::Graph> format_parser(*graph);
+    void addNode(double value)
+    {
+        boost::uint64_t bits;
+        memcpy(&bits, &value, sizeof(double));
 
-    // and a tabular file parser
-    TabularFileParser parser;
+        char record[BINARY_RECORD_SIZE];
+        encodeLittleEndian64(bits, record);
+        writeRecord(record);
+    }
+    void addNodes(const double* values, size_t n_nodes)
+    {
+        for (size_t i=0; i<n_nodes; ++i) {
+            addNode(values[i]);
+        }
+    }
+};
 
-    // now parse
-    parser.parse(ctstream, format_parser);
 
-    // return the contour tree
+/// \brief Writes a binary edge file.
+/// \ingroup fileio
+/*!
+ *  Edges are written as they are added, so the writer can be handed to
+ *  readSimplicialEdgeFile() to convert a text file to binary.
+ */
+class BinaryEdgeFileWriter : public BinaryFileWriter
+{
+public:
+    typedef unsigned int Node;
+
+    BinaryEdgeFileWriter(const char* filename)
+        : BinaryFileWriter(filename, BINARY_EDGE_MAGIC) { }
+
+    Node getNode(long int id) const
+    {
+        if (id < 0 || (unsigned long int) id > 0xffffffffUL) {
+            std::stringstream msg;
+            msg << "Vertex id " << id << " can't be stored in a binary edge file.";
+            throw std::runtime_error(msg.str());
+        }
+        return id;
+    }
+
+    void addEdge(Node u, Node v)
+    {
+        char record[BINARY_RECORD_SIZE];
+        encodeLittleEndian32(u, record);
+        encodeLittleEndian32(v, record + 4);
+        writeRecord(record);
+    }
+    void addEdges(const unsigned int* edges, size_t n_edges)
+    {
+        for (size_t i=0; i<n_edges; ++i) {
+            addEdge(edges[2*i], edges[2*i + 1]);
+        }
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////
+//
+// WriteContourTree
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief Write a contour tree to a file.
+/// \ingroup fileio
+/*!
+ *  Values are written with `precision` significant digits. The default is
+ *  that of a stream; 17 digits are enough to read back every double
+ *  exactly.
+ */
+template <typename ContourTree>
+void writeContourTreeFile(
+    const char * filename,
+    const ContourTree& tree,
+    int precision = 6)
+{
+    typedef typename ContourTree::Members Members;
+
+    std::ofstream fh;
+    fh.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try {
+        fh.open(filename);
+    }
+    catch (std::exception& e) {
+        std::stringstream message;
+        message << "Couldn't open file '" << filename << "'";
+        throw std::runtime_error(message.str());
+    }
+
+    fh.precision(precision);
+
+    // write the number of vertices
+    fh << tree.numberOfNodes() << std::endl;
+
+    // write each vertex (node and member alike) to the file
+    for (NodeIterator<ContourTree> it(tree); !it.done(); ++it)
+    {
+        fh << tree.getID(it.node()) << "\t" 
+           << tree.getValue(it.node()) << std::endl;
+    }
+
+    // write each edge to the file
+    for (EdgeIterator<ContourTree> it(tree);
+            !it.done(); ++it) {
+        fh << tree.getID(tree.u(it.edge()))
+           << "\t"
+           << tree.getID(tree.v(it.edge()));
+
+        const Members& members = tree.getEdgeMembers(it.edge());
+
+        for (typename Members::const_iterator m_it = members.begin();
+                m_it != members.end(); ++m_it) {
+            fh << "\t" << m_it->getID() << "\t" << m_it->getValue();
+        }
+
+        fh << std::endl;
+    }
+
+    fh.close();
+}
+
+////////////////////////////////////////////////////////////////////////////
+//
+// Binary contour tree files
+//
+////////////////////////////////////////////////////////////////////////////
+
+/*
+ *  A binary contour tree file (.dtree) begins with a 40 byte header:
+ *
+ *      bytes  0-7      the magic string "DNLTREE", null terminated
+ *      bytes  8-11     the format version, uint32
+ *      bytes 12-15     flags, uint32; zero in version 1
+ *      bytes 16-23     the number of nodes, uint64
+ *      bytes 24-31     the number of edges, uint64
+ *      bytes 32-39     the number of edge members, uint64
+ *
+ *  It is followed by six sections, each padded with zeros to a multiple
+ *  of 8 bytes:
+ *
+ *      node ids            a uint32 per node
+ *      node values         a float64 per node
+ *      edges               a pair of uint32 node indices per edge
+ *      member offsets      a uint64 per edge, and one more: the members of
+ *                          edge i are those from offsets[i] to offsets[i+1]
+ *      member ids          a uint32 per member
+ *      member values       a float64 per member
+ *
+ *  Nodes are referred to by their position in the node table, and the
+ *  members of all edges form one contiguous array. Everything is
+ *  little-endian. The file holds exactly what a text .tree file does.
+ *
+ *  Version 2 files may have compressed members, as flagged in the header.
+ *  The member ids and values are then replaced by a single section of
+ *  bytes, holding each edge's members encoded as by CompressedMemberList,
+ *  and the member offsets count bytes into it rather than members. If
+ *  BINARY_TREE_FLOAT32_VALUES is also set, the values were rounded to
+ *  single precision before being encoded.
+ */
+
+const char BINARY_TREE_MAGIC[] = "DNLTREE";
+const boost::uint32_t BINARY_TREE_FORMAT_VERSION = 1;
+const boost::uint32_t BINARY_TREE_COMPRESSED_FORMAT_VERSION = 2;
+const size_t BINARY_TREE_HEADER_SIZE = 40;
+
+const boost::uint32_t BINARY_TREE_COMPRESSED_MEMBERS = 1;
+const boost::uint32_t BINARY_TREE_FLOAT32_VALUES = 2;
+
+
+/// \brief The position of each section in a binary contour tree file.
+struct BinaryTreeLayout
+{
+    size_t n_nodes;
+    size_t n_edges;
+    size_t n_members;
+    boost::uint32_t flags;
+
+    size_t node_ids;
+    size_t node_values;
+    size_t edges;
+    size_t member_offsets;
+    size_t member_ids;
+    size_t member_values;
+    size_t size;
+
+    static size_t padded(size_t n_bytes)
+    {
+        return (n_bytes + 7) & ~((size_t) 7);
+    }
+
+    /*!
+     *  If the members are compressed, `n_member_bytes` is the size of the
+     *  encoded members, which start at `member_ids`.
+     */
+    BinaryTreeLayout(
+            size_t n_nodes,
+            size_t n_edges,
+            size_t n_members,
+            boost::uint32_t flags = 0,
+            size_t n_member_bytes = 0)
+        : n_nodes(n_nodes), n_edges(n_edges), n_members(n_members),
+          flags(flags)
+    {
+        node_ids = BINARY_TREE_HEADER_SIZE;
+        node_values = node_ids + padded(4 * n_nodes);
+        edges = node_values + 8 * n_nodes;
+        member_offsets = edges + 8 * n_edges;
+        member_ids = member_offsets + 8 * (n_edges + 1);
+
+        if (isCompressed()) {
+            member_values = member_ids;
+            size = member_ids + n_member_bytes;
+        } else {
+            member_values = member_ids + padded(4 * n_members);
+            size = member_values + 8 * n_members;
+        }
+    }
+
+    bool isCompressed() const
+    {
+        return flags & BINARY_TREE_COMPRESSED_MEMBERS;
+    }
+};
+
+
+/// \brief Checks the header of a mapped binary contour tree file.
+/*!
+ *  \throws std::runtime_error if the header is malformed, or if the file
+ *      is not the size the header promises.
+ */
+inline BinaryTreeLayout checkBinaryTreeHeader(
+    const MappedFile& file,
+    const char* filename)
+{
+    std::stringstream msg;
+    msg << "The file '" << filename << "' ";
+
+    if (file.size() < BINARY_TREE_HEADER_SIZE ||
+            memcmp(file.data(), BINARY_TREE_MAGIC, 8) != 0) {
+        msg << "is not a binary contour tree file.";
+        throw std::runtime_error(msg.str());
+    }
+
+    boost::uint32_t version = decodeLittleEndian32(file.data() + 8);
+    if (version != BINARY_TREE_FORMAT_VERSION &&
+            version != BINARY_TREE_COMPRESSED_FORMAT_VERSION) {
+        msg << "has unsupported format version " << version << ".";
+        throw std::runtime_error(msg.str());
+    }
+
+    boost::uint32_t flags = decodeLittleEndian32(file.data() + 12);
+    if ((version == BINARY_TREE_FORMAT_VERSION && flags != 0) ||
+            (flags & ~(BINARY_TREE_COMPRESSED_MEMBERS | BINARY_TREE_FLOAT32_VALUES)) ||
+            flags == BINARY_TREE_FLOAT32_VALUES) {
+        msg << "has unsupported flags " << flags << ".";
+        throw std::runtime_error(msg.str());
+    }
+
+    // the counts are bounded by the file size before any arithmetic is
+    // done with them, so that a corrupt header can't overflow the layout
+    boost::uint64_t n_nodes = decodeLittleEndian64(file.data() + 16);
+    boost::uint64_t n_edges = decodeLittleEndian64(file.data() + 24);
+    boost::uint64_t n_members = decodeLittleEndian64(file.data() + 32);
+
+    // a compressed member takes at least two bytes
+    size_t min_member_size = (flags & BINARY_TREE_COMPRESSED_MEMBERS) ? 2 : 12;
+    if (n_nodes > file.size() / 12 || n_edges > file.size() / 16 ||
+            n_members > file.size() / min_member_size) {
+        msg << "is truncated or corrupt.";
+        throw std::runtime_error(msg.str());
+    }
+
+    // the size of the compressed members is the last member offset
+    BinaryTreeLayout layout(n_nodes, n_edges, n_members, flags);
+    if (layout.isCompressed() && layout.member_ids <= file.size()) {
+        boost::uint64_t n_member_bytes = decodeLittleEndian64(
+                file.data() + layout.member_ids - 8);
+        if (n_member_bytes <= file.size()) {
+            layout = BinaryTreeLayout(n_nodes, n_edges, n_members, flags,
+                                      n_member_bytes);
+        }
+    }
+
+    if (layout.size != file.size()) {
+        msg << "is truncated or corrupt.";
+        throw std::runtime_error(msg.str());
+    }
+
+    return layout;
+}
+
+
+/// \brief Checks whether a file is a binary contour tree file.
+/// \ingroup fileio
+inline bool isBinaryContourTreeFile(const char* filename)
+{
+    return hasBinaryMagic(filename, BINARY_TREE_MAGIC);
+}
+
+
+inline void throwCorruptEdge(const char* filename, size_t edge)
+{
+    std::stringstream msg;
+    msg << "Edge " << edge << " in '" << filename << "' is corrupt.";
+    throw std::runtime_error(msg.str());
+}
+
+
+/// \brief Checks the member offsets of a binary tree file.
+/*!
+ *  The offsets must start at zero, never decrease, and end at the number
+ *  of members, or of member bytes if the members are compressed, so that
+ *  every edge's members lie within the member sections.
+ *
+ *  \throws std::runtime_error if they don't.
+ */
+inline void checkBinaryTreeOffsets(
+    const MappedFile& file,
+    const BinaryTreeLayout& layout,
+    const char* filename)
+{
+    const char* offsets = file.data() + layout.member_offsets;
+    boost::uint64_t last = layout.isCompressed() ?
+            layout.size - layout.member_ids : layout.n_members;
+
+    boost::uint64_t previous = decodeLittleEndian64(offsets);
+    bool valid = (previous == 0);
+    for (size_t i=1; valid && i<=layout.n_edges; ++i) {
+        boost::uint64_t offset = decodeLittleEndian64(offsets + 8*i);
+        valid = (offset >= previous);
+        previous = offset;
+    }
+
+    if (!valid || previous != last) {
+        std::stringstream msg;
+        msg << "The member offsets in '" << filename << "' are corrupt.";
+        throw std::runtime_error(msg.str());
+    }
+}
+
+
+/// \brief Decodes one edge's compressed members from a binary tree file.
+/*!
+ *  \returns The number of members decoded.
+ *  \throws std::runtime_error if the encoding runs past `end`.
+ */
+template <typename ValueCodec, typename GraphType>
+size_t decodeBinaryTreeMembers(
+    GraphType& graph,
+    typename GraphType::Edge edge,
+    const unsigned char* position,
+    const unsigned char* end)
+{
+    typedef typename GraphType::Member Member;
+
+    // every varint ends on a byte without its high bit set, so if the last
+    // byte has it clear, no varint starting before `end` can run past it
+    if (position != end && (end[-1] & 0x80)) {
+        throw std::runtime_error("Compressed members run past their edge.");
+    }
+
+    boost::uint32_t id = 0;
+    typename ValueCodec::Bits bits = 0;
+    size_t n_members = 0;
+
+    while (position < end) {
+        position = readVarintDelta(position, id);
+        if (position == end) {
+            throw std::runtime_error("Compressed members run past their edge.");
+        }
+        position = readVarintDelta(position, bits);
+        graph.insertEdgeMember(edge, Member(id, ValueCodec::fromBits(bits)));
+        n_members++;
+    }
+
+    return n_members;
+}
+
+
+/// \brief Read a binary contour tree file into a graph.
+/// \ingroup fileio
+/*!
+ *  The graph may be a ContourTree::Graph or a ContourTreeSnapshot::Builder:
+ *  anything with the building interface used by ContourTreeFormatParser.
+ *  The file is mapped into memory; on little-endian machines the node
+ *  tables are handed to the graph without being copied. Compressed members
+ *  are decoded as they are inserted.
+ */
+template <typename GraphType>
+void readBinaryContourTree(
+    const char * filename,
+    GraphType& graph)
+{
+    typedef typename GraphType::Node Node;
+    typedef typename GraphType::Edge Edge;
+    typedef typename GraphType::Member Member;
+
+    MappedFile file(filename);
+    BinaryTreeLayout layout = checkBinaryTreeHeader(file, filename);
+    checkBinaryTreeOffsets(file, layout, filename);
+    const char* data = file.data();
+
+    graph.reserve(layout.n_nodes, layout.n_edges);
+
+    std::vector<unsigned int> ids;
+    std::vector<double> values;
+    const unsigned int* node_ids;
+    const double* node_values;
+
+    if (isLittleEndianHost()) {
+        // the mapping is page aligned, and so are the sections, to 8 bytes
+        node_ids = reinterpret_cast<const unsigned int*>(data + layout.node_ids);
+        node_values = reinterpret_cast<const double*>(data + layout.node_values);
+    } else {
+        ids.resize(layout.n_nodes);
+        values.resize(layout.n_nodes);
+        for (size_t i=0; i<layout.n_nodes; ++i) {
+            ids[i] = decodeLittleEndian32(data + layout.node_ids + 4*i);
+            values[i] = decodeLittleEndianDouble(data + layout.node_values + 8*i);
+        }
+        node_ids = ids.empty() ? 0 : &ids[0];
+        node_values = values.empty() ? 0 : &values[0];
+    }
+
+    graph.addNodes(node_ids, node_values, layout.n_nodes);
+
+    std::vector<Node> nodes(layout.n_nodes);
+    for (size_t i=0; i<layout.n_nodes; ++i) {
+        nodes[i] = graph.getNode(node_ids[i]);
+    }
+
+    // offsets count members, or bytes if the members are compressed. They
+    // were checked above, so each edge's members lie within their section
+    const char* offsets = data + layout.member_offsets;
+    boost::uint64_t offset = 0;
+
+    const unsigned char* member_bytes =
+            reinterpret_cast<const unsigned char*>(data + layout.member_ids);
+    size_t n_decoded = 0;
+
+    for (size_t i=0; i<layout.n_edges; ++i) {
+        const char* record = data + layout.edges + 8*i;
+        boost::uint32_t u = decodeLittleEndian32(record);
+        boost::uint32_t v = decodeLittleEndian32(record + 4);
+        boost::uint64_t next_offset = decodeLittleEndian64(offsets + 8*(i+1));
+
+        if (u >= layout.n_nodes || v >= layout.n_nodes) {
+            throwCorruptEdge(filename, i);
+        }
+
+        Edge edge = graph.addEdge(nodes[u], nodes[v]);
+
+        if (layout.isCompressed()) {
+            try {
+                if (layout.flags & BINARY_TREE_FLOAT32_VALUES) {
+                    n_decoded += decodeBinaryTreeMembers<Float32Values>(graph,
+                            edge, member_bytes + offset, member_bytes + next_offset);
+                } else {
+                    n_decoded += decodeBinaryTreeMembers<LosslessValues>(graph,
+                            edge, member_bytes + offset, member_bytes + next_offset);
+                }
+            }
+            catch (std::runtime_error&) {
+                throwCorruptEdge(filename, i);
+            }
+            offset = next_offset;
+            continue;
+        }
+
+        for (; offset < next_offset; ++offset) {
+            graph.insertEdgeMember(edge, Member(
+                    decodeLittleEndian32(data + layout.member_ids + 4*offset),
+                    decodeLittleEndianDouble(data + layout.member_values + 8*offset)));
+        }
+    }
+
+    if (layout.isCompressed() && n_decoded != layout.n_members) {
+        std::stringstream msg;
+        msg << "The file '" << filename << "' is truncated or corrupt.";
+        throw std::runtime_error(msg.str());
+    }
+}
+
+
+/// \brief Read a contour tree from a binary file.
+/// \ingroup fileio
+inline ContourTree readBinaryContourTreeFile(
+    const char * filename)
+{
+    boost::shared_ptr<ContourTree::Graph> graph(new ContourTree::Graph);
+    readBinaryContourTree(filename, *graph);
+    return ContourTree::fromPrecomputed(graph);
+}
+
+
+/// \brief Read a contour tree from a binary file into a snapshot.
+/// \ingroup fileio
+inline ContourTreeSnapshot readBinaryContourTreeSnapshotFile(
+    const char * filename)
+{
+    ContourTreeSnapshot::Builder builder;
+    readBinaryContourTree(filename, builder);
+    return builder.finish();
+}
+
+
+/// \brief Writes fixed width little-endian values to a binary file.
+class BinaryTreeFileWriter
+{
+    std::ofstream& _fh;
+    size_t _position;
+
+public:
+    BinaryTreeFileWriter(std::ofstream& fh) : _fh(fh), _position(0) {}
+
+    void writeBytes(const char* bytes, size_t n_bytes)
+    {
+        _fh.write(bytes, n_bytes);
+        _position += n_bytes;
+    }
+
+    void write32(boost::uint32_t value)
+    {
+        char bytes[4];
+        encodeLittleEndian32(value, bytes);
+        writeBytes(bytes, 4);
+    }
+
+    void write64(boost::uint64_t value)
+    {
+        char bytes[8];
+        encodeLittleEndian64(value, bytes);
+        writeBytes(bytes, 8);
+    }
+
+    void writeDouble(double value)
+    {
+        boost::uint64_t bits;
+        memcpy(&bits, &value, sizeof(double));
+        write64(bits);
+    }
+
+    /// \brief Pad with zeros up to the given position.
+    void padTo(size_t position)
+    {
+        while (_position < position) {
+            _fh.put(0);
+            _position++;
+        }
+    }
+};
+
+
+/// \brief Encodes each edge's members as a CompressedMemberList would.
+/*!
+ *  `offsets` receives the byte offset of each edge's members, and one
+ *  more, the total size.
+ */
+template <typename ValueCodec, typename ContourTree>
+void encodeBinaryTreeMembers(
+    const ContourTree& tree,
+    std::vector<unsigned char>& bytes,
+    std::vector<size_t>& offsets)
+{
+    typedef typename ContourTree::Members Members;
+
+    offsets.push_back(0);
+    for (EdgeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        boost::uint32_t id = 0;
+        typename ValueCodec::Bits bits = 0;
+
+        const Members& members = tree.getEdgeMembers(it.edge());
+        for (typename Members::const_iterator m_it = members.begin();
+                m_it != members.end(); ++m_it) {
+            appendMember<ValueCodec>(bytes, m_it->getID(), m_it->getValue(),
+                                     id, bits);
+        }
+        offsets.push_back(bytes.size());
+    }
+}
+
+
+/// \brief Write a contour tree to a binary file.
+/// \ingroup fileio
+/*!
+ *  Anything conforming to concepts::ContourTree can be written. As with
+ *  writeContourTreeFile(), only the edges' members are stored; a node's
+ *  only member is taken to be the node itself.
+ *
+ *  \param flags   Zero, or BINARY_TREE_COMPRESSED_MEMBERS to compress the
+ *                  members, optionally or'd with BINARY_TREE_FLOAT32_VALUES
+ *                  to round their values to single precision.
+ */
+template <typename ContourTree>
+void writeBinaryContourTreeFile(
+    const char * filename,
+    const ContourTree& tree,
+    boost::uint32_t flags = 0)
+{
+    typedef typename ContourTree::Members Members;
+
+    if (flags != 0 && flags != BINARY_TREE_COMPRESSED_MEMBERS &&
+            flags != (BINARY_TREE_COMPRESSED_MEMBERS | BINARY_TREE_FLOAT32_VALUES)) {
+        throw std::runtime_error("Unsupported binary contour tree flags.");
+    }
+
+    // the position of each node in the node table, by identifier
+    std::vector<unsigned int> node_index(tree.getMaxNodeIdentifier());
+    size_t n_nodes = 0;
+    for (NodeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        node_index[tree.getNodeIdentifier(it.node())] = n_nodes++;
+    }
+
+    size_t n_edges = 0;
+    size_t n_members = 0;
+    for (EdgeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        n_edges++;
+        n_members += tree.getEdgeMembers(it.edge()).size();
+    }
+
+    std::vector<unsigned char> member_bytes;
+    std::vector<size_t> member_offsets;
+    if (flags & BINARY_TREE_FLOAT32_VALUES) {
+        encodeBinaryTreeMembers<Float32Values>(tree, member_bytes, member_offsets);
+    } else if (flags & BINARY_TREE_COMPRESSED_MEMBERS) {
+        encodeBinaryTreeMembers<LosslessValues>(tree, member_bytes, member_offsets);
+    }
+
+    BinaryTreeLayout layout(n_nodes, n_edges, n_members, flags,
+                            member_bytes.size());
+
+    std::ofstream fh;
+    fh.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    try {
+        fh.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+    catch (std::exception& e) {
+        std::stringstream message;
+        message << "Couldn't open file '" << filename << "'";
+        throw std::runtime_error(message.str());
+    }
+
+    BinaryTreeFileWriter writer(fh);
+
+    writer.writeBytes(BINARY_TREE_MAGIC, 8);
+    writer.write32(flags ? BINARY_TREE_COMPRESSED_FORMAT_VERSION
+                         : BINARY_TREE_FORMAT_VERSION);
+    writer.write32(flags);
+    writer.write64(n_nodes);
+    writer.write64(n_edges);
+    writer.write64(n_members);
+
+    for (NodeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        writer.write32(tree.getID(it.node()));
+    }
+    writer.padTo(layout.node_values);
+
+    for (NodeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        writer.writeDouble(tree.getValue(it.node()));
+    }
+
+    for (EdgeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        writer.write32(node_index[tree.getNodeIdentifier(tree.u(it.edge()))]);
+        writer.write32(node_index[tree.getNodeIdentifier(tree.v(it.edge()))]);
+    }
+
+    if (layout.isCompressed()) {
+        for (size_t i=0; i<member_offsets.size(); ++i) {
+            writer.write64(member_offsets[i]);
+        }
+        if (!member_bytes.empty()) {
+            writer.writeBytes(reinterpret_cast<const char*>(&member_bytes[0]),
+                              member_bytes.size());
+        }
+        fh.close();
+        return;
+    }
+
+    size_t offset = 0;
+    writer.write64(offset);
+    for (EdgeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        offset += tree.getEdgeMembers(it.edge()).size();
+        writer.write64(offset);
+    }
+
+    for (EdgeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        const Members& members = tree.getEdgeMembers(it.edge());
+        for (typename Members::const_iterator m_it = members.begin();
+                m_it != members.end(); ++m_it) {
+            writer.write32(m_it->getID());
+        }
+    }
+    writer.padTo(layout.member_values);
+
+    for (EdgeIterator<ContourTree> it(tree); !it.done(); ++it) {
+        const Members& members = tree.getEdgeMembers(it.edge());
+        for (typename Members::const_iterator m_it = members.begin();
+                m_it != members.end(); ++m_it) {
+            writer.writeDouble(m_it->getValue());
+        }
+    }
+
+    fh.close();
+}
+
+////////////////////////////////////////////////////////////////////////////
+//
+// ReadContourTree
+//
+////////////////////////////////////////////////////////////////////////////
+
+template <typename GraphType>
+class ContourTreeFormatParser
+{
+    typedef TabularLine Line;
+    typedef typename GraphType::Node Node;
+    typedef typename GraphType::Edge Edge;
+    typedef typename GraphType::Member Member;
+
+    GraphType& _graph;
+    unsigned int _lineno;
+    unsigned int _n_vertices;
+
+    // the vertices are added to the graph all at once, before the edges
+    std::vector<unsigned int> _vertex_ids;
+    std::vector<double> _vertex_values;
+
+public:
+
+    ContourTreeFormatParser(GraphType& graph)
+        : _graph(graph), _lineno(0), _n_vertices(0) { }
+
+    void insert(const Line& line)
+    {
+        if (_lineno == 0) {
+            readNumberOfVertices(line);
+        } else if (_lineno <= _n_vertices) {
+            readVertexLine(line);
+        } else if (!line.empty()) {
+            // blank lines, such as one at the end of the file, are skipped
+            readEdgeLine(line);
+        }
+        _lineno++;
+    }
+
+    void readNumberOfVertices(const Line& line)
+    {
+        if (line.size() != 1) {
+            throw std::runtime_error(
+                "The contour tree file's first line is malformed. It "
+                "should be a single integer describing the number "
+                "of vertices in the file.");
+        }
+
+        char * err;
+        _n_vertices = strtol(line[0], &err, 10);
+
+        if (*err != 0) {
+            throw std::runtime_error(
+                "Could not interpret first line of contour tree file.");
+        }
+
+        // a tree on n vertices has n-1 edges
+        _graph.reserve(_n_vertices, _n_vertices > 0 ? _n_vertices - 1 : 0);
+
+        _vertex_ids.reserve(_n_vertices);
+        _vertex_values.reserve(_n_vertices);
+    }
+
+    /// \brief Add the vertices read so far to the graph.
+    void flush()
+    {
+        if (!_vertex_ids.empty()) {
+            _graph.addNodes(&_vertex_ids[0], &_vertex_values[0], _vertex_ids.size());
+            std::vector<unsigned int>().swap(_vertex_ids);
+            std::vector<double>().swap(_vertex_values);
+        }
+    }
+
+    void throwMalformed(const char* definition) const
+    {
+        std::stringstream msg;
+        msg << "The contour tree file has a malformed " << definition
+            << " definition on line " << _lineno + 1 << ".";
+        throw std::runtime_error(msg.str());
+    }
+
+    void readVertexLine(const Line& line)
+    {
+        if (line.size() != 2) {
+            throwMalformed("vertex");
+        }
+
+        char* id_err;
+        long int id = strtol(line[0], &id_err, 10);
+
+        char* value_err;
+        double value = strtod(line[1], &value_err);
+
+        if (*value_err != 0 || *id_err !=0 || id < 0) {
+            throwMalformed("vertex");
+        }
+
+        _vertex_ids.push_back(id);
+        _vertex_values.push_back(value);
+
+        if (_lineno == _n_vertices) {
+            flush();
+        }
+    }
+
+    void readEdgeLine(const Line& line)
+    {
+        if (line.size() < 2 || line.size() % 2 != 0) {
+            throwMalformed("edge");
+        }
+
+        char * u_err;
+        char * v_err;
+        unsigned int u_id = strtol(line[0], &u_err, 10);
+        unsigned int v_id = strtol(line[1], &v_err, 10);
+
+        if (*u_err != 0 || *v_err != 0) {
+            throwMalformed("edge");
+        }
+
+        Node u = _graph.getNode(u_id);
+        Node v = _graph.getNode(v_id);
+
+        Edge edge = _graph.addEdge(u,v);
+
+        for (size_t i=2; i<line.size(); i+=2) {
+            char* id_err;
+            unsigned int member_id = strtol(line[i], &id_err, 10);
+
+            char* value_err;
+            double member_value = strtod(line[i+1], &value_err);
+
+            if (*id_err != 0 || *value_err != 0) {
+                throwMalformed("edge");
+            }
+
+            Member member(member_id, member_value);
+            _graph.insertEdgeMember(edge, member);
+        }
+
+    }
+
+};
+
+
+/// \brief Read a contour tree from a stream.
+/// \ingroup fileio
+inline ContourTree readContourTreeFromStream(
+    std::istream& ctstream)
+{
+    // make a new graph object
+    boost::shared_ptr<ContourTree::Graph> graph(new ContourTree::Graph);
+
+    // make a new contour tree format parser
+    ContourTreeFormatParser<ContourTree::Graph> format_parser(*graph);
+
+    // and a tabular file parser
+    TabularFileParser parser;
+
+    // now parse
+    parser.parse(ctstream, format_parser);
+    format_parser.flush();
+
+    // return the contour tree
     return denali::ContourTree::fromPrecomputed(graph);
 }
 
 
 /// \brief Read a contour tree from a file.
 /// \ingroup fileio
+/*!
+ *  The file may be in either the text or the binary format.
+ */
 inline ContourTree readContourTreeFile(
     const char * filename)
 {
+    if (isBinaryContourTreeFile(filename)) {
+        return readBinaryContourTreeFile(filename);
+    }
+
     // create a file stream
     std::ifstream fh;
     safeOpenFile(filename, fh);
@@ -423,6 +1624,276 @@ inline ContourTree readContourTreeFile(
     return readContourTreeFromStream(fh);
 }
 
+
+/// \brief Read a contour tree from a file, keeping its members compressed.
+/// \ingroup fileio
+/*!
+ *  The file may be in either the text or the binary format. Members are
+ *  stored in memory with the given ValueCodec, whatever their encoding in
+ *  the file.
+ */
+template <typename ValueCodec>
+CompressedContourTree<ValueCodec> readCompressedContourTreeFile(
+    const char * filename)
+{
+    typedef typename CompressedContourTree<ValueCodec>::Graph Graph;
+    boost::shared_ptr<Graph> graph(new Graph);
+
+    if (isBinaryContourTreeFile(filename)) {
+        readBinaryContourTree(filename, *graph);
+    } else {
+        std::ifstream fh;
+        safeOpenFile(filename, fh);
+
+        ContourTreeFormatParser<Graph> format_parser(*graph);
+        TabularFileParser parser;
+        parser.parse(fh, format_parser);
+        format_parser.flush();
+    }
+
+    return CompressedContourTree<ValueCodec>::fromPrecomputed(graph);
+}
+
+
+/// \brief Read a contour tree from a stream into a snapshot.
+/// \ingroup fileio
+/*!
+ *  The file is parsed straight into the snapshot's arrays, without
+ *  building a ContourTree first.
+ */
+inline ContourTreeSnapshot readContourTreeSnapshotFromStream(
+    std::istream& ctstream)
+{
+    ContourTreeSnapshot::Builder builder;
+
+    ContourTreeFormatParser<ContourTreeSnapshot::Builder> format_parser(builder);
+    TabularFileParser parser;
+    parser.parse(ctstream, format_parser);
+    format_parser.flush();
+
+    return builder.finish();
+}
+
+
+/// \brief Read a contour tree from a file into a snapshot.
+/// \ingroup fileio
+/*!
+ *  The file may be in either the text or the binary format.
+ */
+inline ContourTreeSnapshot readContourTreeSnapshotFile(
+    const char * filename)
+{
+    if (isBinaryContourTreeFile(filename)) {
+        return readBinaryContourTreeSnapshotFile(filename);
+    }
+
+    std::ifstream fh;
+    safeOpenFile(filename, fh);
+
+    return readContourTreeSnapshotFromStream(fh);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Lazy contour tree files
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/// \brief Reads edge members from a mapped text contour tree file.
+/*!
+ *  The offset of an edge's members is the position of the first member
+ *  on the edge's line.
+ */
+template <typename Member>
+class TextTreeMemberSource : public MemberSource<Member>
+{
+    MappedFile _file;
+
+    // the line being parsed, copied so that the file's last field is
+    // null terminated
+    mutable std::vector<char> _line;
+    mutable TabularLine _fields;
+
+public:
+    TextTreeMemberSource(const char* filename) : _file(filename) {}
+
+    const MappedFile& getFile() const
+    {
+        return _file;
+    }
+
+    /// \brief The end of the line starting at `offset`: a newline, or the end of the file.
+    size_t findLineEnd(size_t offset) const
+    {
+        const char* newline = static_cast<const char*>(
+                memchr(_file.data() + offset, '\n', _file.size() - offset));
+        return newline ? newline - _file.data() : _file.size();
+    }
+
+    /// \brief Split the line from `offset` to `end` into fields.
+    const TabularLine& tokenize(size_t offset, size_t end) const
+    {
+        _line.assign(_file.data() + offset, _file.data() + end);
+        _line.push_back(0);
+        tokenizeTabularLine(&_line[0], _fields);
+        return _fields;
+    }
+
+    virtual void readMembers(size_t offset, std::vector<Member>& members) const
+    {
+        const TabularLine& fields = tokenize(offset, findLineEnd(offset));
+
+        for (size_t i=0; i+1<fields.size(); i+=2) {
+            char* id_err;
+            unsigned int member_id = strtol(fields[i], &id_err, 10);
+
+            char* value_err;
+            double member_value = strtod(fields[i+1], &value_err);
+
+            if (*id_err != 0 || *value_err != 0) {
+                throw std::runtime_error(
+                    "The contour tree file has a malformed edge definition.");
+            }
+
+            members.push_back(Member(member_id, member_value));
+        }
+    }
+};
+
+
+/// \brief Read a text contour tree file's nodes and edges, but not its members.
+/// \ingroup fileio
+/*!
+ *  The vertex lines are parsed as usual. Of each edge line, only the two
+ *  endpoints are parsed; the members are counted, and left in the file
+ *  to be read by a LazyMemberList when they are needed. The graph's
+ *  Members must therefore be LazyMemberLists.
+ */
+template <typename GraphType>
+void readContourTreeSkeleton(
+    boost::shared_ptr<const TextTreeMemberSource<typename GraphType::Member> > source,
+    GraphType& graph)
+{
+    typedef typename GraphType::Node Node;
+    typedef typename GraphType::Edge Edge;
+    typedef typename GraphType::Members Members;
+
+    const char* data = source->getFile().data();
+    size_t size = source->getFile().size();
+
+    // the header and vertex lines are handed to the usual parser
+    ContourTreeFormatParser<GraphType> format_parser(graph);
+    std::vector<char> line;
+    TabularLine fields;
+
+    size_t offset = 0;
+    size_t lineno = 0;
+    size_t n_vertices = 0;
+
+    for (; offset < size && lineno <= n_vertices; ++lineno) {
+        size_t end = source->findLineEnd(offset);
+
+        line.assign(data + offset, data + end);
+        line.push_back(0);
+        tokenizeTabularLine(&line[0], fields);
+        format_parser.insert(fields);
+
+        if (lineno == 0) {
+            n_vertices = strtol(fields[0], 0, 10);
+        }
+
+        offset = end + 1;
+    }
+    format_parser.flush();
+
+    for (; offset < size; ++lineno) {
+        size_t end = source->findLineEnd(offset);
+
+        // find the endpoints, and count the fields after them
+        size_t n_fields = 0;
+        size_t members_offset = end;
+
+        for (size_t c=offset; c<end; ++c) {
+            if (!isTabularSeparator(data[c]) &&
+                    (c == offset || isTabularSeparator(data[c-1]))) {
+                if (n_fields == 2) {
+                    members_offset = c;
+                }
+                n_fields++;
+            }
+        }
+
+        // skip blank lines, as readContourTreeFile() does
+        if (n_fields == 0) {
+            offset = end + 1;
+            continue;
+        }
+
+        if (n_fields < 2 || n_fields % 2 != 0) {
+            std::stringstream msg;
+            msg << "The contour tree file has a malformed edge definition on line "
+                << lineno + 1 << ".";
+            throw std::runtime_error(msg.str());
+        }
+
+        line.assign(data + offset, data + members_offset);
+        line.push_back(0);
+        tokenizeTabularLine(&line[0], fields);
+
+        char* u_err;
+        char* v_err;
+        unsigned int u_id = strtol(fields[0], &u_err, 10);
+        unsigned int v_id = strtol(fields[1], &v_err, 10);
+
+        if (*u_err != 0 || *v_err != 0) {
+            std::stringstream msg;
+            msg << "The contour tree file has a malformed edge definition on line "
+                << lineno + 1 << ".";
+            throw std::runtime_error(msg.str());
+        }
+
+        Node u = graph.getNode(u_id);
+        Node v = graph.getNode(v_id);
+        Edge edge = graph.addEdge(u, v);
+
+        if (n_fields > 2) {
+            graph.setEdgeMembers(edge,
+                    Members(source, members_offset, (n_fields - 2) / 2));
+        }
+
+        offset = end + 1;
+    }
+}
+
+
+/// \brief Read a contour tree, leaving the members in the file until they are needed.
+/// \ingroup fileio
+/*!
+ *  Only the nodes and edges of a text file are parsed, so the tree is
+ *  ready much sooner than with readContourTreeFile(), and members which
+ *  are never looked at are never read. The file is kept mapped into
+ *  memory for as long as the tree or any of its member lists exist.
+ *
+ *  Binary files are read whole, as they already load quickly.
+ */
+inline LazyContourTree readLazyContourTreeFile(
+    const char * filename)
+{
+    typedef LazyContourTree::Graph Graph;
+    boost::shared_ptr<Graph> graph(new Graph);
+
+    if (isBinaryContourTreeFile(filename)) {
+        readBinaryContourTree(filename, *graph);
+    } else {
+        boost::shared_ptr<const TextTreeMemberSource<Graph::Member> > source(
+                new TextTreeMemberSource<Graph::Member>(filename));
+        readContourTreeSkeleton(source, *graph);
+    }
+
+    return LazyContourTree::fromPrecomputed(graph);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // WeightMap
@@ -440,7 +1911,7 @@ public:
         : _weight_map(weight_map), lineno(0) { }
 
 
-    void insert(std::vector<std::string>& line)
+    void insert(const TabularLine& line)
     {
         if (line.size() != 2) {
             std::stringstream msg;
@@ -449,9 +1920,9 @@ public:
         }
 
         char * err_u;
-        long int u = strtol(line[0].c_str(), &err_u, 10);
+        long int u = strtol(line[0], &err_u, 10);
         char * err_weight;
-        double weight = strtod(line[1].c_str(), &err_weight);
+        double weight = strtod(line[1], &err_weight);
 
         if (*err_u != 0 || *err_weight != 0 || u < 0) {
             std::stringstream msg;
@@ -517,7 +1988,7 @@ public:
         : _color_map(color_map), lineno(0) { }
 
 
-    void insert(std::vector<std::string>& line)
+    void insert(const TabularLine& line)
     {
         if (line.size() != 2) {
             std::stringstream msg;
@@ -526,10 +1997,10 @@ public:
         }
 
         char* err_id;
-        long int id = strtol(line[0].c_str(), &err_id, 10);
+        long int id = strtol(line[0], &err_id, 10);
 
         char* err_color;
-        double color = strtod(line[1].c_str(), &err_color);
+        double color = strtod(line[1], &err_color);
 
         if (*err_color != 0 || *err_id != 0) {
             std::stringstream msg;
@@ -31,6 +31,7 @@
 #include <denali/graph_structures.h>
 #include <denali/mappable_list.h>
 
+#include <queue>
 #include <stdexcept>
 
 namespace denali {
@@ -46,13 +47,15 @@ namespace denali {
 /// \ingroup fold_tree
 /*!
  *  Given an edge, specified by the parent and child nodes, fully expands every
- *  edge and node that is in the induced subtree. 
+ *  edge and node that is in the induced subtree. The subtree is searched
+ *  in the given workspace, which may be reused between calls.
  */
 template <typename FoldedTree>
 void expandSubtree(
         FoldedTree& tree,
         typename FoldedTree::Node parent,
-        typename FoldedTree::Node child)
+        typename FoldedTree::Node child,
+        typename UndirectedBFSIterator<FoldedTree>::Workspace& workspace)
 {
     typedef typename FoldedTree::Node Node;
     typedef typename FoldedTree::Edge Edge;
@@ -64,7 +67,7 @@ void expandSubtree(
 
     assert(tree.isEdgeValid(tree.findEdge(parent, child)));
 
-    for (UndirectedBFSIterator<FoldedTree> it(tree, parent, child);
+    for (UndirectedBFSIterator<FoldedTree> it(tree, parent, child, workspace);
             !it.done(); ++it) 
     {
         assert(tree.isEdgeValid(it.edge()));
@@ -115,6 +118,19 @@ void expandSubtree(
     }
 }
 
+
+/// \brief Expands the subtree
+/// \ingroup fold_tree
+template <typename FoldedTree>
+void expandSubtree(
+        FoldedTree& tree,
+        typename FoldedTree::Node parent,
+        typename FoldedTree::Node child)
+{
+    typename UndirectedBFSIterator<FoldedTree>::Workspace workspace;
+    expandSubtree(tree, parent, child, workspace);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // FoldTree
@@ -145,6 +161,11 @@ public:
     {
     public:
         virtual void notify() = 0;
+
+        /// \brief Called after the folds have been renumbered by compact().
+        virtual void remap(const std::vector<int>& /* new_identifiers */) {
+            notify();
+        }
     };
 
     class NodeFold
@@ -268,13 +289,11 @@ public:
 
         assert(_graph.degree(child) == 1);
 
-        // add the fold edge to the parent node folds collapse list
-        NodeFold parent_node_fold = _node_to_fold[parent];
-        int n = parent_node_fold._index;
-        _node_folds[n].collapsed.push_back(_edge_to_fold[edge]);
+        // add the fold edge to the end of the parent's collapsed list
+        linkCollapsed(_node_to_fold[parent], _edge_to_fold[edge]);
 
-        // remove the child from the tree
-        _graph.removeNode(child);
+        // hide the child and its edge
+        _graph.hideNode(child);
     }
 
     Edge reduce(Node v)
@@ -287,40 +306,45 @@ public:
         Node u = it.neighbor(); Edge uv = it.edge(); ++it;
         Node w = it.neighbor(); Edge vw = it.edge();
 
-        // make an edge between them
-        Edge uw = this->addEdge(u,w);
+        // the edge fold made by reducing v is kept for its next reduction,
+        // so only the first one makes a new fold
+        NodeFold v_fold = _node_to_fold[v];
+        if (_node_folds[v_fold._index].reduced_edge_fold._index == -1)
+        {
+            int n = _edge_folds.insert(EdgeFoldRep());
+            _edge_folds[n].reduced_fold = v_fold;
+            _edge_folds[n].edge = _graph.getInvalidEdge();
+            _node_folds[v_fold._index].reduced_edge_fold = EdgeFold(n);
+        }
 
         // update v's reduced edge folds
-        NodeFold v_fold = _node_to_fold[v];
         NodeFoldRep& v_fold_rep = _node_folds[v_fold._index];
         v_fold_rep.uv_fold = _edge_to_fold[uv];
         v_fold_rep.vw_fold = _edge_to_fold[vw];
 
-        // update the new edge's reduced node
-        EdgeFold uw_fold = _edge_to_fold[uw];
+        // the new edge joins whatever u and w are now
+        EdgeFold uw_fold = v_fold_rep.reduced_edge_fold;
         EdgeFoldRep& uw_fold_rep = _edge_folds[uw_fold._index];
-        uw_fold_rep.reduced_fold = v_fold;
+        uw_fold_rep.u_fold = _node_to_fold[u];
+        uw_fold_rep.v_fold = _node_to_fold[w];
 
-        // remove the node
-        _graph.removeNode(v);
+        // hide the node and its edges, and show the edge between u and w
+        _graph.hideNode(v);
 
-        return uw;
+        return restoreEdge(uw_fold);
     }
 
     Edge uncollapse(Node u, int index=-1)
     {
         // get the folded node
         NodeFold u_fold = _node_to_fold[u];
-        NodeFoldRep& u_fold_rep = _node_folds[u_fold._index];
 
         // if the index is less than one, uncollapse the last collapsed edge
-        if (index < 0) {
-            index = u_fold_rep.collapsed.size()-1;
-        }
+        EdgeFold uv_fold = index < 0 ? 
+                _node_folds[u_fold._index].last_collapsed :
+                getCollapsedEdgeFold(u_fold, index);
 
-        // pop the collapsed edge fold
-        EdgeFold uv_fold = u_fold_rep.collapsed[index];
-        u_fold_rep.collapsed.erase(u_fold_rep.collapsed.begin() + index);
+        unlinkCollapsed(u_fold, uv_fold);
 
         // get the collapsed node fold at the other end of the edge
         NodeFold v_fold = oppositeNodeFold(u_fold, uv_fold);
@@ -338,38 +362,97 @@ public:
     {
         // get the reduced node
         EdgeFold uw_fold = _edge_to_fold[uw];
-        EdgeFoldRep& uw_fold_rep = _edge_folds[uw_fold._index];
-        NodeFold v_fold = uw_fold_rep.reduced_fold;
+        NodeFold v_fold = _edge_folds[uw_fold._index].reduced_fold;
+
+        // hide the edge. Its fold is kept for the node's next reduction
+        _graph.hideEdge(uw);
 
-        // restore it to the tree
+        // restore the node to the tree
         Node v = restoreNode(v_fold);
 
-        // get the reduced edges
+        // restore the reduced edges
         NodeFoldRep& v_fold_rep = _node_folds[v_fold._index];
-        EdgeFold uv_fold = v_fold_rep.uv_fold;
-        EdgeFold vw_fold = v_fold_rep.vw_fold;
+        restoreEdge(v_fold_rep.uv_fold);
+        restoreEdge(v_fold_rep.vw_fold);
+
+        return v;
+    }
+
+    /// \brief Release the space held by hidden nodes and edges.
+    /*!
+     *  Nodes, edges and edge folds are renumbered densely, and fold maps
+     *  are permuted to match. Folds are never removed, so no fold is lost,
+     *  and node folds keep their identifiers. Nodes and edges that are
+     *  folded out of view give up their slots, and are given new ones when
+     *  they are unfolded. Node, Edge and EdgeFold handles held outside of
+     *  the tree are invalidated. Returns the new identifier of each old
+     *  edge fold, for the sake of maps that don't observe the folds.
+     */
+    std::vector<int> compact()
+    {
+        // the graph's observing maps, _node_to_fold and _edge_to_fold,
+        // follow the nodes and edges to their new identifiers
+        _graph.compact();
+
+        // only folds that are in the tree refer to a node or an edge
+        for (int n = _node_folds.getFirst(); _node_folds.isValid(n);
+                n = _node_folds.getNext(n)) {
+            _node_folds[n].node = _graph.getInvalidNode();
+        }
+
+        for (int n = _edge_folds.getFirst(); _edge_folds.isValid(n);
+                n = _edge_folds.getNext(n)) {
+            _edge_folds[n].edge = _graph.getInvalidEdge();
+        }
 
-        // restore the edges
-        restoreEdge(uv_fold);
-        restoreEdge(vw_fold);
+        for (NodeIterator<GraphType> it(_graph); !it.done(); ++it) {
+            _node_folds[_node_to_fold[it.node()]._index].node = it.node();
+        }
 
-        // delete the edge fold
-        _edge_folds.remove(uw_fold._index);
+        for (EdgeIterator<GraphType> it(_graph); !it.done(); ++it) {
+            _edge_folds[_edge_to_fold[it.edge()]._index].edge = it.edge();
+        }
 
-        // delete the edge
-        _graph.removeEdge(uw);
+        // now renumber the edge folds, and every reference to them
+        std::vector<int> new_edge_folds = _edge_folds.compact();
+
+        for (int n = _node_folds.getFirst(); _node_folds.isValid(n);
+                n = _node_folds.getNext(n)) {
+            NodeFoldRep& rep = _node_folds[n];
+            rep.first_collapsed = remapEdgeFold(new_edge_folds, rep.first_collapsed);
+            rep.last_collapsed = remapEdgeFold(new_edge_folds, rep.last_collapsed);
+            rep.uv_fold = remapEdgeFold(new_edge_folds, rep.uv_fold);
+            rep.vw_fold = remapEdgeFold(new_edge_folds, rep.vw_fold);
+            rep.reduced_edge_fold = 
+                    remapEdgeFold(new_edge_folds, rep.reduced_edge_fold);
+        }
 
-        return v;
+        for (int n = _edge_folds.getFirst(); _edge_folds.isValid(n);
+                n = _edge_folds.getNext(n)) {
+            EdgeFoldRep& rep = _edge_folds[n];
+            rep.prev_collapsed = remapEdgeFold(new_edge_folds, rep.prev_collapsed);
+            rep.next_collapsed = remapEdgeFold(new_edge_folds, rep.next_collapsed);
+        }
+
+        for (EdgeIterator<GraphType> it(_graph); !it.done(); ++it) {
+            _edge_to_fold[it.edge()] =
+                    remapEdgeFold(new_edge_folds, _edge_to_fold[it.edge()]);
+        }
+
+        return new_edge_folds;
     }
 
     size_t numberOfCollapsedEdgeFolds(NodeFold nf) const {
-        return _node_folds[nf._index].collapsed.size();
+        return _node_folds[nf._index].n_collapsed;
     }
 
     EdgeFold getCollapsedEdgeFold(NodeFold nf, size_t i) const
     {
-        const NodeFoldRep& nf_rep = _node_folds[nf._index];
-        return nf_rep.collapsed[i];
+        EdgeFold ef = _node_folds[nf._index].first_collapsed;
+        for (; i > 0; --i) {
+            ef = _edge_folds[ef._index].next_collapsed;
+        }
+        return ef;
     }
 
     EdgeFold uvFold(NodeFold nf) const {
@@ -420,6 +503,16 @@ public:
         return _edge_folds.getMaxIdentifier();
     }
 
+    /// \brief The number of times the node folds have been renumbered.
+    unsigned int getNodeFoldGeneration() const {
+        return _node_folds.getGeneration();
+    }
+
+    /// \brief The number of times the edge folds have been renumbered.
+    unsigned int getEdgeFoldGeneration() const {
+        return _edge_folds.getGeneration();
+    }
+
     void attachNodeFoldObserver(FoldObserver& observer) {
         _node_fold_observers.push_back(&observer);
     }
@@ -439,12 +532,28 @@ public:
 
 private:
 
+    // Folds are never removed, and the nodes and edges of the tree are
+    // hidden rather than removed, so they keep their slots while they are
+    // folded. Unfolding only has to show them again, and folding and 
+    // unfolding allocate nothing once every node has been reduced once.
+
     struct NodeFoldRep
     {
-        std::vector<EdgeFold> collapsed;
+        // the collapsed edge folds, in the order that they were collapsed,
+        // linked through their reps
+        EdgeFold first_collapsed;
+        EdgeFold last_collapsed;
+        size_t n_collapsed;
+
         EdgeFold uv_fold;
         EdgeFold vw_fold;
+
+        // the edge fold made whenever the node is reduced
+        EdgeFold reduced_edge_fold;
+
         Node node;
+
+        NodeFoldRep() : n_collapsed(0) {}
     };
 
     struct EdgeFoldRep
@@ -452,6 +561,8 @@ private:
         NodeFold u_fold;
         NodeFold v_fold;
         NodeFold reduced_fold;
+        EdgeFold prev_collapsed;
+        EdgeFold next_collapsed;
         Edge edge;
     };
 
@@ -484,11 +595,27 @@ private:
                 (*it)->notify();
             }
         }
+
+        virtual void remap(const std::vector<int>& new_identifiers) const
+        {
+            for (FoldObservers::const_iterator it = _observers.begin();
+                    it != _observers.end(); ++it)
+            {
+                (*it)->remap(new_identifiers);
+            }
+        }
     };
 
     MasterFoldObserver<NodeFoldRep> _master_node_fold_observer;
     MasterFoldObserver<EdgeFoldRep> _master_edge_fold_observer;
 
+    static EdgeFold remapEdgeFold(
+            const std::vector<int>& new_identifiers, EdgeFold edge_fold)
+    {
+        return edge_fold._index == -1 ?
+                edge_fold : EdgeFold(new_identifiers[edge_fold._index]);
+    }
+
     NodeFold oppositeNodeFold(NodeFold u_fold, EdgeFold uv_fold)
     {
         EdgeFoldRep& uv_fold_rep = _edge_folds[uv_fold._index];
@@ -497,32 +624,81 @@ private:
                 uv_fold_rep.v_fold : uv_fold_rep.u_fold;
     }
 
-    Node restoreNode(NodeFold v_fold)
+    /// \brief Appends the edge fold to the node fold's collapsed list.
+    void linkCollapsed(NodeFold nf, EdgeFold ef)
     {
-        Node v = _graph.addNode();
+        NodeFoldRep& nf_rep = _node_folds[nf._index];
+        EdgeFoldRep& ef_rep = _edge_folds[ef._index];
+
+        ef_rep.prev_collapsed = nf_rep.last_collapsed;
+        ef_rep.next_collapsed = EdgeFold();
+
+        if (nf_rep.last_collapsed._index == -1) {
+            nf_rep.first_collapsed = ef;
+        } else {
+            _edge_folds[nf_rep.last_collapsed._index].next_collapsed = ef;
+        }
+
+        nf_rep.last_collapsed = ef;
+        nf_rep.n_collapsed++;
+    }
 
+    /// \brief Takes the edge fold out of the node fold's collapsed list.
+    void unlinkCollapsed(NodeFold nf, EdgeFold ef)
+    {
+        NodeFoldRep& nf_rep = _node_folds[nf._index];
+        EdgeFoldRep& ef_rep = _edge_folds[ef._index];
+
+        if (ef_rep.prev_collapsed._index == -1) {
+            nf_rep.first_collapsed = ef_rep.next_collapsed;
+        } else {
+            _edge_folds[ef_rep.prev_collapsed._index].next_collapsed =
+                    ef_rep.next_collapsed;
+        }
+
+        if (ef_rep.next_collapsed._index == -1) {
+            nf_rep.last_collapsed = ef_rep.prev_collapsed;
+        } else {
+            _edge_folds[ef_rep.next_collapsed._index].prev_collapsed =
+                    ef_rep.prev_collapsed;
+        }
+
+        ef_rep.prev_collapsed = ef_rep.next_collapsed = EdgeFold();
+        nf_rep.n_collapsed--;
+    }
+
+    /// \brief Shows the fold's node, or adds one if compact() took its slot.
+    Node restoreNode(NodeFold v_fold)
+    {
         NodeFoldRep& v_fold_rep = _node_folds[v_fold._index];
 
-        v_fold_rep.node = v;
-        _node_to_fold[v] = v_fold;
-        return v;
+        if (v_fold_rep.node == _graph.getInvalidNode()) {
+            v_fold_rep.node = _graph.addNode();
+            _node_to_fold[v_fold_rep.node] = v_fold;
+        } else {
+            _graph.showNode(v_fold_rep.node);
+        }
+
+        return v_fold_rep.node;
     }
 
+    /// \brief Shows the fold's edge between the nodes of its node folds, or
+    /// adds one if it has no slot.
     Edge restoreEdge(EdgeFold uv_fold)
     {
         EdgeFoldRep& uv_fold_rep = _edge_folds[uv_fold._index];
-        NodeFoldRep& u_fold_rep = _node_folds[uv_fold_rep.u_fold._index];
-        NodeFoldRep& v_fold_rep = _node_folds[uv_fold_rep.v_fold._index];
-        
-        Node u = u_fold_rep.node;
-        Node v = v_fold_rep.node;
-
-        Edge uv = _graph.addEdge(u,v);
-        uv_fold_rep.edge = uv;
-        _edge_to_fold[uv] = uv_fold;
-        return uv;
-    }
+        Node u = _node_folds[uv_fold_rep.u_fold._index].node;
+        Node v = _node_folds[uv_fold_rep.v_fold._index].node;
+
+        if (uv_fold_rep.edge == _graph.getInvalidEdge()) {
+            uv_fold_rep.edge = _graph.addEdge(u,v);
+            _edge_to_fold[uv_fold_rep.edge] = uv_fold;
+        } else {
+            _graph.showEdge(uv_fold_rep.edge, u, v);
+        }
 
+        return uv_fold_rep.edge;
+    }
 
 };
 
@@ -557,6 +733,11 @@ public:
         _values.resize(_graph.getMaxNodeFoldIdentifier());
     }
 
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        permuteMapValues(_values, new_identifiers, _graph.getMaxNodeFoldIdentifier());
+    }
+
     typename std::vector<ValueType>::reference
     operator[](typename NodeFoldObservable::NodeFold node_fold)
     {
@@ -602,6 +783,11 @@ public:
         _values.resize(_graph.getMaxEdgeFoldIdentifier());
     }
 
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        permuteMapValues(_values, new_identifiers, _graph.getMaxEdgeFoldIdentifier());
+    }
+
     typename std::vector<ValueType>::reference
     operator[](typename EdgeFoldObservable::EdgeFold edge_fold)
     {
@@ -616,6 +802,148 @@ public:
 
 };
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// LazyNodeFoldMap
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/// \brief Node fold map which grows as it is accessed.
+/// \ingroup fold_tree
+/*!
+ *  The fold counterpart of LazyNodeMap: it doesn't register with the
+ *  tree, and must be remapped by hand if the node folds are renumbered.
+ */
+template <typename NodeFoldMappable, typename ValueType>
+class LazyNodeFoldMap
+{
+    const NodeFoldMappable& _graph;
+    LazyMapValues<ValueType> _values;
+
+public:
+    LazyNodeFoldMap(const NodeFoldMappable& graph)
+        : _graph(graph), _values(_graph.getNodeFoldGeneration()) {}
+
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        _values.remap(new_identifiers, _graph.getMaxNodeFoldIdentifier(),
+                      _graph.getNodeFoldGeneration());
+    }
+
+    typename std::vector<ValueType>::reference
+    operator[](typename NodeFoldMappable::NodeFold node_fold)
+    {
+        return _values.get(_graph.getNodeFoldIdentifier(node_fold),
+                           _graph.getMaxNodeFoldIdentifier(),
+                           _graph.getNodeFoldGeneration());
+    }
+
+    typename std::vector<ValueType>::const_reference
+    operator[](typename NodeFoldMappable::NodeFold node_fold) const
+    {
+        return _values.get(_graph.getNodeFoldIdentifier(node_fold),
+                           _graph.getMaxNodeFoldIdentifier(),
+                           _graph.getNodeFoldGeneration());
+    }
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// LazyEdgeFoldMap
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/// \brief Edge fold map which grows as it is accessed.
+/// \ingroup fold_tree
+/*!
+ *  The fold counterpart of LazyEdgeMap. After FoldTree::compact(), it
+ *  must be remapped with the identifiers that compact() returned.
+ */
+template <typename EdgeFoldMappable, typename ValueType>
+class LazyEdgeFoldMap
+{
+    const EdgeFoldMappable& _graph;
+    LazyMapValues<ValueType> _values;
+
+public:
+    LazyEdgeFoldMap(const EdgeFoldMappable& graph)
+        : _graph(graph), _values(_graph.getEdgeFoldGeneration()) {}
+
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        _values.remap(new_identifiers, _graph.getMaxEdgeFoldIdentifier(),
+                      _graph.getEdgeFoldGeneration());
+    }
+
+    typename std::vector<ValueType>::reference
+    operator[](typename EdgeFoldMappable::EdgeFold edge_fold)
+    {
+        return _values.get(_graph.getEdgeFoldIdentifier(edge_fold),
+                           _graph.getMaxEdgeFoldIdentifier(),
+                           _graph.getEdgeFoldGeneration());
+    }
+
+    typename std::vector<ValueType>::const_reference
+    operator[](typename EdgeFoldMappable::EdgeFold edge_fold) const
+    {
+        return _values.get(_graph.getEdgeFoldIdentifier(edge_fold),
+                           _graph.getMaxEdgeFoldIdentifier(),
+                           _graph.getEdgeFoldGeneration());
+    }
+
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// FoldMaps
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/// \brief The fold maps chosen by a map policy.
+/// \ingroup fold_tree
+/*!
+ *  Specialized for ObservingMaps and LazyMaps. Besides naming the map
+ *  types, followCompaction() brings an edge fold map up to date after
+ *  FoldTree::compact(): observing maps already are, lazy ones are
+ *  remapped.
+ */
+template <typename Maps>
+struct FoldMaps;
+
+template <>
+struct FoldMaps<ObservingMaps>
+{
+    template <typename FoldTree, typename ValueType>
+    struct NodeFoldMap { typedef ObservingNodeFoldMap<FoldTree, ValueType> Type; };
+
+    template <typename FoldTree, typename ValueType>
+    struct EdgeFoldMap { typedef ObservingEdgeFoldMap<FoldTree, ValueType> Type; };
+
+    template <typename FoldTree, typename ValueType>
+    static void followCompaction(
+            ObservingEdgeFoldMap<FoldTree, ValueType>&,
+            const std::vector<int>&) {}
+};
+
+template <>
+struct FoldMaps<LazyMaps>
+{
+    template <typename FoldTree, typename ValueType>
+    struct NodeFoldMap { typedef LazyNodeFoldMap<FoldTree, ValueType> Type; };
+
+    template <typename FoldTree, typename ValueType>
+    struct EdgeFoldMap { typedef LazyEdgeFoldMap<FoldTree, ValueType> Type; };
+
+    template <typename FoldTree, typename ValueType>
+    static void followCompaction(
+            LazyEdgeFoldMap<FoldTree, ValueType>& map,
+            const std::vector<int>& new_edge_folds)
+    {
+        map.remap(new_edge_folds);
+    }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // FoldedContourTree
@@ -624,7 +952,11 @@ public:
 
 /// \brief A contour tree whose nodes and edges can be folded out of view.
 /// \ingroup fold_tree
-template <typename ContourTree>
+/*!
+ *  `Maps` is the map policy used for the tree's own fold maps, either
+ *  ObservingMaps or LazyMaps.
+ */
+template <typename ContourTree, typename Maps = ObservingMaps>
 class FoldedContourTree :
         public
         NodeObservableMixin <FoldTree,
@@ -650,19 +982,45 @@ public:
      */
     typedef FoldTree::EdgeFold EdgeFold;
 
+private:
+    /// \brief The member lists of the contour tree's nodes and edges.
+    /*!
+     *  Each list is a segment, and the segments are linked into chains by
+     *  `next` and `prev`, which hold -1 at the ends of a chain.
+     */
+    struct MemberChain
+    {
+        std::vector<const typename ContourTree::Members*> members;
+        std::vector<int> next;
+        std::vector<int> prev;
+    };
+
+public:
     /// \brief A set of node members.
+    /*!
+     *  The members of a fold are those of a contiguous run of segments,
+     *  from `_first` to `_last`, in a MemberChain. A node or edge of the
+     *  contour tree starts out as a run of one segment: its own members.
+     *  Collapsing and reducing link the runs of the folded nodes and edges
+     *  end to end, and unfolding unlinks them again, so no members are
+     *  copied and nothing is allocated. Iterating is a walk along the run
+     *  which skips empty segments without reading them.
+     */
     class Members
     {
-        template <typename T> friend class FoldedContourTree;
-
-        typedef boost::shared_ptr<Members> MembersPtr;
+        template <typename T, typename M> friend class FoldedContourTree;
 
+        const MemberChain* _chain;
+        int _first;
+        int _last;
         size_t _size;
-        const typename ContourTree::Members* _ct_members;
-        std::list<MembersPtr> _nested_members;
 
-        Members(const typename ContourTree::Members* ctm) :
-                _size(ctm->size()), _ct_members(ctm) {}
+        explicit Members(const MemberChain* chain) :
+                _chain(chain), _first(-1), _last(-1), _size(0) {}
+
+        Members(const MemberChain* chain, int segment) :
+                _chain(chain), _first(segment), _last(segment),
+                _size(chain->members[segment]->size()) {}
 
     public:
         class const_iterator
@@ -670,136 +1028,85 @@ public:
             friend class Members;
 
             typedef typename ContourTree::Member Member;
+            typedef typename ContourTree::Members::const_iterator
+                    SegmentIterator;
 
-            const Members* _members;
-            typename ContourTree::Members::const_iterator _ct_member_it;
-            typename std::list<MembersPtr>::const_iterator _folded_list_it;
-            boost::shared_ptr<const_iterator> _folded_member_it;
+            const MemberChain* _chain;
+            int _segment;
+            int _last;
+            SegmentIterator _member_it;
+            SegmentIterator _member_end;
 
-            const_iterator(const Members* members) : _members(members) {}
-
-            /// \brief Advance the list and make the _folded_member_it valid, if possible.
-            void advanceList()
+            const_iterator(const MemberChain* chain, int segment, int last) :
+                    _chain(chain), _last(last)
             {
-                while (_folded_list_it != _members->_nested_members.end() &&
-                       (*_folded_list_it)->size() == 0) {
-                    _folded_list_it++;
-                }
-
-                if (_folded_list_it != _members->_nested_members.end()) 
-                {
-                    _folded_member_it = boost::shared_ptr<const_iterator>(new 
-                            const_iterator((*_folded_list_it)->begin()));
-                }
+                enterSegment(segment);
             }
 
-
-        public:
-            bool operator==(const const_iterator& rhs) const 
+            /// \brief Moves to the first member at or after the segment.
+            void enterSegment(int segment)
             {
-                // check that the two iterators iterate over the same set
-                if (_members != rhs._members) {
-                    return false;
+                // the run may continue past _last into the folds it is
+                // nested beside, so we stop there
+                while (segment >= 0 && _chain->members[segment]->size() == 0) {
+                    segment = segment == _last ? -1 : _chain->next[segment];
                 }
 
-                if (_members->_ct_members) {
-                    if (_ct_member_it != rhs._ct_member_it) {
-                        return false;
-                    }
-                }
+                _segment = segment;
 
-                if (_folded_list_it != rhs._folded_list_it) {
-                    return false;
+                if (_segment >= 0) {
+                    _member_it = _chain->members[_segment]->begin();
+                    _member_end = _chain->members[_segment]->end();
                 }
+            }
 
-                if (_folded_list_it != _members->_nested_members.end()) {
-                    if ((*_folded_member_it) != (*rhs._folded_member_it)) {
-                        return false;
-                    }
-                }
+        public:
+            const_iterator() : _chain(0), _segment(-1), _last(-1) {}
 
-                return true;
+            bool operator==(const const_iterator& rhs) const 
+            {
+                return _segment == rhs._segment &&
+                       (_segment < 0 || _member_it == rhs._member_it);
             }
 
-            bool operator!=(const const_iterator rhs) const {
+            bool operator!=(const const_iterator& rhs) const {
                 return !((*this) == (rhs));
             }
 
             /// \brief Advances the iterator until the end or a valid entry is met.
             void operator++() 
             {
-                if (_members->_ct_members)
-                {
-                    if (_ct_member_it != _members->_ct_members->end())
-                    {
-                        _ct_member_it++;
-                        return;
-                    }
-                }
-
-                // either there are no ct members, or we have reached the end of them
-                ++(*_folded_member_it);
+                ++_member_it;
 
-                if ((*_folded_member_it) == (*_folded_list_it)->end()) {
-                    _folded_list_it++;
-                    advanceList();
+                if (_member_it == _member_end) {
+                    enterSegment(_segment == _last ? -1 : _chain->next[_segment]);
                 }
             }
 
-            const Member& operator*() const 
-            {
-                if (_members->_ct_members)
-                {
-                    if (_ct_member_it != _members->_ct_members->end())
-                    {
-                        return *_ct_member_it;
-                    }
-                }
+            const Member& operator*() const {
+                return *_member_it;
+            }
 
-                // either there are no ct members, of we have reached the end of them
-                return **_folded_member_it;
+            const Member* operator->() const {
+                return &(*_member_it);
             }
 
         };
         friend class const_iterator;
 
         Members() : 
-                _size(0), _ct_members(0) {}
+                _chain(0), _first(-1), _last(-1), _size(0) {}
 
         size_t size() const {
             return _size;
         }
 
         const_iterator begin() const {
-            const_iterator it(this);
-
-            if (_ct_members)
-            {
-                it._ct_member_it = (_ct_members->begin());
-            }
-
-            it._folded_list_it = _nested_members.begin();
-
-            if (_nested_members.begin() != _nested_members.end()) {
-                it.advanceList();
-            }
-
-
-            return it;
+            return const_iterator(_chain, _first, _last);
         }
 
-        const_iterator end() const
-        {
-            const_iterator it(this);
-
-            if (_ct_members)
-            {
-                it._ct_member_it = (_ct_members->end());
-            }
-
-            it._folded_list_it = _nested_members.end();
-
-            return it;
+        const_iterator end() const {
+            return const_iterator(_chain, -1, _last);
         }
 
     };
@@ -817,19 +1124,25 @@ private:
 
     const ContourTree& _contour_tree;
     FoldTree _fold_tree;
+    MemberChain _member_chain;
 
     StaticNodeMap<ContourTree, NodeFold> _ct_to_fold_node;
 
-    ObservingNodeFoldMap<FoldTree, typename ContourTree::Node>
+    typedef FoldMaps<Maps> FoldMapPolicy;
+
+    typename FoldMapPolicy::template
+            NodeFoldMap<FoldTree, typename ContourTree::Node>::Type
             _fold_to_ct_node;
 
-    ObservingEdgeFoldMap<FoldTree, typename ContourTree::Edge>
+    typename FoldMapPolicy::template
+            EdgeFoldMap<FoldTree, typename ContourTree::Edge>::Type
             _fold_to_ct_edge;
 
-    typedef boost::shared_ptr<Members> MembersPtr;
+    typename FoldMapPolicy::template
+            NodeFoldMap<FoldTree, Members>::Type _node_members;
 
-    ObservingNodeFoldMap<FoldTree, boost::shared_ptr<Members> > _node_members;
-    ObservingEdgeFoldMap<FoldTree, boost::shared_ptr<Members> > _edge_members;
+    typename FoldMapPolicy::template
+            EdgeFoldMap<FoldTree, Members>::Type _edge_members;
 
     typename ContourTree::Node getContourTreeNode(Node node) const {
         return _fold_to_ct_node[_fold_tree.getNodeFold(node)];
@@ -839,6 +1152,58 @@ private:
         return _fold_to_ct_edge[_fold_tree.getEdgeFold(edge)];
     }
 
+    /// \brief Makes a run of one segment holding the contour tree members.
+    Members addMemberSegment(const ContourTreeMembers* ctm)
+    {
+        int segment = _member_chain.members.size();
+        _member_chain.members.push_back(ctm);
+        _member_chain.next.push_back(-1);
+        _member_chain.prev.push_back(-1);
+
+        return Members(&_member_chain, segment);
+    }
+
+    /// \brief Links the run of `members` onto the end of the run of `base`.
+    void appendMembers(Members& base, const Members& members)
+    {
+        if (base._first < 0) {
+            base._first = members._first;
+        } else {
+            _member_chain.next[base._last] = members._first;
+            _member_chain.prev[members._first] = base._last;
+        }
+
+        base._last = members._last;
+        base._size += members._size;
+    }
+
+    /// \brief Unlinks the run of `members` from within the run of `base`.
+    void removeMembers(Members& base, const Members& members)
+    {
+        int before = _member_chain.prev[members._first];
+        int after = _member_chain.next[members._last];
+
+        if (before >= 0) {
+            _member_chain.next[before] = after;
+        }
+
+        if (after >= 0) {
+            _member_chain.prev[after] = before;
+        }
+
+        if (base._first == members._first) {
+            base._first = after;
+        }
+
+        if (base._last == members._last) {
+            base._last = before;
+        }
+
+        _member_chain.prev[members._first] = -1;
+        _member_chain.next[members._last] = -1;
+        base._size -= members._size;
+    }
+
 public:
 
     typedef typename ContourTree::Member Member;
@@ -852,6 +1217,11 @@ public:
         // we need to initialize the fold tree with the structure of the contour
         // tree. We also want to map the folds to their corresponding nodes and 
         // edges.
+        size_t n_segments = contour_tree.numberOfNodes() + 
+                            contour_tree.numberOfEdges();
+        _member_chain.members.reserve(n_segments);
+        _member_chain.next.reserve(n_segments);
+        _member_chain.prev.reserve(n_segments);
 
         for (NodeIterator<ContourTree> it(contour_tree); !it.done(); ++it)
         {
@@ -869,7 +1239,7 @@ public:
 
             // set the node's members to be the CT node's members
             const ContourTreeMembers* ctm = &_contour_tree.getNodeMembers(it.node());
-            _node_members[node_fold] = MembersPtr(new Members(ctm));
+            _node_members[node_fold] = addMemberSegment(ctm);
         }
 
         for (EdgeIterator<ContourTree> it(_contour_tree); !it.done(); ++it)
@@ -897,7 +1267,7 @@ public:
 
             // set the edge's members to be the CT edge's members
             const ContourTreeMembers* ctm = &_contour_tree.getEdgeMembers(it.edge());
-            _edge_members[edge_fold] = MembersPtr(new Members(ctm));
+            _edge_members[edge_fold] = addMemberSegment(ctm);
         }
     }
 
@@ -928,6 +1298,18 @@ public:
         }
     }
 
+    /// \brief Release the space left behind by collapses and reductions.
+    /*!
+     *  See FoldTree::compact(). Node and Edge handles held outside of the
+     *  tree are invalidated.
+     */
+    void compact()
+    {
+        std::vector<int> new_edge_folds = _fold_tree.compact();
+        FoldMapPolicy::followCompaction(_fold_to_ct_edge, new_edge_folds);
+        FoldMapPolicy::followCompaction(_edge_members, new_edge_folds);
+    }
+
     /// \brief Collapse an edge.
     void collapse(Edge edge) 
     {
@@ -941,19 +1323,14 @@ public:
         NodeFold base_fold = _fold_tree.getNodeFold(base);
 
         // get the base's members
-        MembersPtr base_members = _node_members[base_fold];
+        Members& base_members = _node_members[base_fold];
 
         // add the leaf members and collapsed edge members to the base node's members
         NodeFold leaf_fold = _fold_tree.getNodeFold(leaf);
-        MembersPtr leaf_members = _node_members[leaf_fold];
-        base_members->_nested_members.push_back(leaf_members);
+        appendMembers(base_members, _node_members[leaf_fold]);
 
         EdgeFold edge_fold = _fold_tree.getEdgeFold(edge);
-        MembersPtr edge_members = _edge_members[edge_fold];
-        base_members->_nested_members.push_back(edge_members);
-
-        // update the size of the node's members
-        base_members->_size += leaf_members->_size + edge_members->_size;
+        appendMembers(base_members, _edge_members[edge_fold]);
 
         // collapse the edge.
         _fold_tree.collapse(edge);
@@ -962,27 +1339,19 @@ public:
     /// \brief Reduced a node, connecting its neighbors.
     Edge reduce(Node v) 
     {
-        // get the edges incident on this node
-        UndirectedNeighborIterator<FoldTree> it(_fold_tree, v);
-        Edge uv = it.edge(); ++it;
-        Edge vw = it.edge();
+        NodeFold v_fold = _fold_tree.getNodeFold(v);
 
-        MembersPtr v_members = _node_members[_fold_tree.getNodeFold(v)];
-        MembersPtr uv_members = _edge_members[_fold_tree.getEdgeFold(uv)];
-        MembersPtr vw_members = _edge_members[_fold_tree.getEdgeFold(vw)];
-
-        // make the new edge
+        // make the new edge. The first reduction of v makes a new edge 
+        // fold, which grows the member maps, so we look members up after
         Edge uw = _fold_tree.reduce(v);
 
-        // we have a new set of members for the new edge
-        MembersPtr uw_members = MembersPtr(new Members());
-        _edge_members[_fold_tree.getEdgeFold(uw)] = uw_members;
-
-        uw_members->_nested_members.push_back(v_members);
-        uw_members->_nested_members.push_back(uv_members);
-        uw_members->_nested_members.push_back(vw_members);
+        // the new edge's members are those of v and its two edges
+        Members& uw_members = _edge_members[_fold_tree.getEdgeFold(uw)];
+        uw_members = Members(&_member_chain);
 
-        uw_members->_size += v_members->_size + uv_members->_size + vw_members->_size;
+        appendMembers(uw_members, _node_members[v_fold]);
+        appendMembers(uw_members, _edge_members[_fold_tree.uvFold(v_fold)]);
+        appendMembers(uw_members, _edge_members[_fold_tree.vwFold(v_fold)]);
 
         return uw;
     }
@@ -1052,16 +1421,13 @@ public:
         Node v = _fold_tree.opposite(u, edge);
 
         // get their member sets
-        MembersPtr edge_members = _edge_members[_fold_tree.getEdgeFold(edge)];
-        MembersPtr v_members = _node_members[_fold_tree.getNodeFold(v)];
+        const Members& edge_members = _edge_members[_fold_tree.getEdgeFold(edge)];
+        const Members& v_members = _node_members[_fold_tree.getNodeFold(v)];
 
-        // now remove these from u's nested members
-        MembersPtr u_members = _node_members[_fold_tree.getNodeFold(u)];
-        u_members->_nested_members.remove(v_members);
-        u_members->_nested_members.remove(edge_members);
-
-        // and decrease the size by the appropriate amount
-        u_members->_size -= v_members->_size + edge_members->_size;
+        // now remove these from u's members
+        Members& u_members = _node_members[_fold_tree.getNodeFold(u)];
+        removeMembers(u_members, v_members);
+        removeMembers(u_members, edge_members);
 
         return edge;
     }
@@ -1069,17 +1435,27 @@ public:
     /// \brief Unreduces the edge.
     Node unreduce(Edge uw)
     {
-        return _fold_tree.unreduce(uw); 
+        Members& uw_members = _edge_members[_fold_tree.getEdgeFold(uw)];
+
+        Node v = _fold_tree.unreduce(uw); 
+
+        // take the node and its edges back out of the reduced edge's members
+        NodeFold v_fold = _fold_tree.getNodeFold(v);
+        removeMembers(uw_members, _node_members[v_fold]);
+        removeMembers(uw_members, _edge_members[_fold_tree.uvFold(v_fold)]);
+        removeMembers(uw_members, _edge_members[_fold_tree.vwFold(v_fold)]);
+
+        return v;
     }
 
     /// \brief Retrieves the members contained within the node.
     const Members& getNodeMembers(Node node) const {
-        return *_node_members[_fold_tree.getNodeFold(node)];
+        return _node_members[_fold_tree.getNodeFold(node)];
     }
 
     /// \brief Retrieves the members contained within the edge.
     const Members& getEdgeMembers(Edge edge) const {
-        return *_edge_members[_fold_tree.getEdgeFold(edge)];
+        return _edge_members[_fold_tree.getEdgeFold(edge)];
     }
 
     /// \brief Returns true if the edge has a reduced node within.
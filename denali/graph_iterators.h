@@ -25,7 +25,9 @@
 #ifndef DENALI_GRAPH_ITERATORS_H
 #define DENALI_GRAPH_ITERATORS_H
 
-#include <queue>
+#include <algorithm>
+#include <vector>
+
 #include <denali/graph_maps.h>
 
 /// \file
@@ -315,89 +317,259 @@ public:
 };
 
 
+/// \brief A FIFO queue kept in a ring buffer.
+/// \ingroup graph_implementations_iterators
+/*!
+ *  Unlike std::queue, clearing the queue keeps its storage, so a queue that
+ *  is reused for many searches stops allocating once it has grown to fit
+ *  the largest of them.
+ */
+template <typename T>
+class RingQueue
+{
+    std::vector<T> _buffer;
+    size_t _head;
+    size_t _size;
+
+    void grow()
+    {
+        std::vector<T> buffer(std::max((size_t) 16, 2 * _buffer.size()));
+        for (size_t i=0; i<_size; ++i) {
+            buffer[i] = _buffer[(_head + i) % _buffer.size()];
+        }
+
+        _buffer.swap(buffer);
+        _head = 0;
+    }
+
+public:
+
+    RingQueue() : _head(0), _size(0) {}
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    const T& front() const {
+        return _buffer[_head];
+    }
+
+    void push(const T& value)
+    {
+        if (_size == _buffer.size()) {
+            grow();
+        }
+
+        size_t tail = _head + _size;
+        if (tail >= _buffer.size()) {
+            tail -= _buffer.size();
+        }
+
+        _buffer[tail] = value;
+        _size++;
+    }
+
+    void pop()
+    {
+        _head++;
+        if (_head == _buffer.size()) {
+            _head = 0;
+        }
+        _size--;
+    }
+
+    /// \brief Empty the queue, keeping its storage.
+    void clear()
+    {
+        _head = 0;
+        _size = 0;
+    }
+};
+
+
+/// \brief Reusable storage for an UndirectedBFSIterator.
+/// \ingroup graph_implementations_iterators
+/*!
+ *  Holds the search queue, and marks a node as visited by stamping it with
+ *  the number of the current search, so starting a search clears nothing.
+ *  Once the workspace has grown to fit the graph, a search allocates
+ *  nothing and costs time in proportion to the part of the graph it
+ *  visits. Only one iterator may use a workspace at a time.
+ */
+template <typename GraphType>
+class UndirectedBFSWorkspace
+{
+    typedef typename GraphType::Node Node;
+    typedef typename GraphType::Edge Edge;
+
+public:
+
+    /// \brief An edge to be visited, along with the direction it was reached.
+    struct Visit
+    {
+        Edge edge;
+        Node parent;
+        Node child;
+
+        Visit() {}
+        Visit(Edge edge, Node parent, Node child)
+            : edge(edge), parent(parent), child(child) {}
+    };
+
+private:
+
+    RingQueue<Visit> _queue;
+    std::vector<unsigned int> _stamps;
+    unsigned int _stamp;
+
+public:
+
+    UndirectedBFSWorkspace() : _stamp(0) {}
+
+    /// \brief Start a new search of the graph, with no node visited.
+    void reset(const GraphType& graph)
+    {
+        _queue.clear();
+        _stamps.resize(graph.getMaxNodeIdentifier(), 0);
+
+        // once the stamps wrap around, old marks could be mistaken for new
+        if (++_stamp == 0) {
+            std::fill(_stamps.begin(), _stamps.end(), 0);
+            _stamp = 1;
+        }
+    }
+
+    bool isVisited(unsigned int identifier) const {
+        return _stamps[identifier] == _stamp;
+    }
+
+    void markVisited(unsigned int identifier) {
+        _stamps[identifier] = _stamp;
+    }
+
+    RingQueue<Visit>& queue() {
+        return _queue;
+    }
+
+    const RingQueue<Visit>& queue() const {
+        return _queue;
+    }
+};
+
+
 /// \brief Performs a BFS on an undirected graph.
 /// \ingroup graph_implementations_iterators
+/*!
+ *  Each constructor optionally takes a Workspace owned by the caller. A
+ *  workspace reused across searches saves the iterator from allocating its
+ *  queue and visited marks, and from clearing the marks of every node in
+ *  the graph, each time it is constructed.
+ */
 template <typename GraphType>
 class UndirectedBFSIterator
 {
+public:
+
+    typedef UndirectedBFSWorkspace<GraphType> Workspace;
+
+private:
+
     typedef typename GraphType::Node Node;
     typedef typename GraphType::Edge Edge;
-    typedef std::pair<Node,Node> Direction;
-    typedef std::pair<Edge, Direction> Visit;
+    typedef typename Workspace::Visit Visit;
 
     const GraphType& _graph;
-    std::queue<Visit> _bfs_queue;
-    StaticNodeMap<GraphType, bool> _visited;
+    Workspace _own_workspace;
+    Workspace& _workspace;
+
+    // the iterator refers to its own workspace, so it cannot be copied
+    UndirectedBFSIterator(const UndirectedBFSIterator&);
+    UndirectedBFSIterator& operator=(const UndirectedBFSIterator&);
 
-private:
     void visit(Node node)
     {
         // visit the node and add it's unvisited children to the queue
         for (UndirectedNeighborIterator<GraphType> it(_graph, node);
                 !it.done(); ++it) {
-            if (!_visited[it.neighbor()]) {
-                _bfs_queue.push(Visit(it.edge(), Direction(node, it.neighbor())));
-                _visited[it.neighbor()] = true;
+            unsigned int neighbor = _graph.getNodeIdentifier(it.neighbor());
+            if (!_workspace.isVisited(neighbor)) {
+                _workspace.queue().push(Visit(it.edge(), node, it.neighbor()));
+                _workspace.markVisited(neighbor);
             }
         }
     }
 
+    void start(Node root)
+    {
+        _workspace.reset(_graph);
+        _workspace.markVisited(_graph.getNodeIdentifier(root));
+        visit(root);
+    }
+
+    void start(Node parent, Node pivot)
+    {
+        _workspace.reset(_graph);
+        _workspace.markVisited(_graph.getNodeIdentifier(parent));
+        _workspace.markVisited(_graph.getNodeIdentifier(pivot));
+        visit(pivot);
+    }
 
 public:
     /// \brief Perform a full BFS, starting at the root.
     UndirectedBFSIterator(const GraphType& graph, Node root)
-        : _graph(graph), _visited(graph)
+        : _graph(graph), _workspace(_own_workspace)
     {
-        // no nodes have been visited
-        for (NodeIterator<GraphType> node_it(graph); !node_it.done(); ++node_it) {
-            _visited[node_it.node()] = false;
-        }
-
-        // except for the root node
-        _visited[root] = true;
+        start(root);
+    }
 
-        // now visit the children
-        visit(root);
+    /// \brief Perform a full BFS, starting at the root, in the given workspace.
+    UndirectedBFSIterator(const GraphType& graph, Node root, Workspace& workspace)
+        : _graph(graph), _workspace(workspace)
+    {
+        start(root);
     }
 
     /// \brief Perform a partial BFS, starting at the pivot, and stopping when the parent it reached.
     UndirectedBFSIterator(const GraphType& graph, Node parent, Node pivot)
-        : _graph(graph), _visited(graph)
+        : _graph(graph), _workspace(_own_workspace)
     {
-        // no nodes have been visited
-        for (NodeIterator<GraphType> node_it(graph); !node_it.done(); ++node_it) {
-            _visited[node_it.node()] = false;
-        }
-
-        // except for the root node
-        _visited[parent] = true;
-        _visited[pivot] = true;
-
-        // now visit the pivot 
-        visit(pivot);
+        start(parent, pivot);
+    }
 
+    /// \brief Perform a partial BFS in the given workspace.
+    UndirectedBFSIterator(
+            const GraphType& graph,
+            Node parent,
+            Node pivot,
+            Workspace& workspace)
+        : _graph(graph), _workspace(workspace)
+    {
+        start(parent, pivot);
     }
 
     bool done() const {
-        return _bfs_queue.size() == 0;
+        return _workspace.queue().empty();
     }
 
     void operator++()
     {
-        Visit v = _bfs_queue.front();
-        _bfs_queue.pop();
-        Node child = v.second.second;
+        Node child = _workspace.queue().front().child;
+        _workspace.queue().pop();
         visit(child);
     }
 
     Node parent() const {
-        return _bfs_queue.front().second.first;
+        return _workspace.queue().front().parent;
     }
     Node child() const {
-        return _bfs_queue.front().second.second;
+        return _workspace.queue().front().child;
     }
     Edge edge() const {
-        return _bfs_queue.front().first;
+        return _workspace.queue().front().edge;
     }
 
 };
@@ -405,27 +577,53 @@ public:
 
 /// \brief Iterate through the arcs of a directed graph in BFS order.
 /// \ingroup graph_implementations_iterators
+/*!
+ *  As with UndirectedBFSIterator, the caller may supply a Workspace to be
+ *  reused from one search to the next.
+ */
 template <typename GraphType>
 class DirectedBFSIterator
 {
+public:
+
+    typedef RingQueue<typename GraphType::Arc> Workspace;
+
+private:
+
     typedef typename GraphType::Node Node;
     typedef typename GraphType::Arc Arc;
 
     const GraphType& _graph;
-    std::queue<Arc> _bfs_queue;
+    Workspace _own_workspace;
+    Workspace& _bfs_queue;
 
-public:
+    DirectedBFSIterator(const DirectedBFSIterator&);
+    DirectedBFSIterator& operator=(const DirectedBFSIterator&);
 
-    DirectedBFSIterator(const GraphType& graph, Node root)
-        : _graph(graph)
+    void start(Node root)
     {
-        for (ChildIterator<GraphType> it(graph, root); !it.done(); ++it) {
+        _bfs_queue.clear();
+        for (ChildIterator<GraphType> it(_graph, root); !it.done(); ++it) {
             _bfs_queue.push(it.arc());
         }
     }
 
+public:
+
+    DirectedBFSIterator(const GraphType& graph, Node root)
+        : _graph(graph), _bfs_queue(_own_workspace)
+    {
+        start(root);
+    }
+
+    DirectedBFSIterator(const GraphType& graph, Node root, Workspace& workspace)
+        : _graph(graph), _bfs_queue(workspace)
+    {
+        start(root);
+    }
+
     bool done() const {
-        return _bfs_queue.size() == 0;
+        return _bfs_queue.empty();
     }
 
     void operator++()
@@ -450,7 +648,6 @@ public:
 };
 
 
-
 }
 
 #endif
@@ -25,10 +25,64 @@
 #ifndef DENALI_GRAPH_MAPS_H
 #define DENALI_GRAPH_MAPS_H
 
+#include <algorithm>
+#include <stdexcept>
 #include <vector>
 
 namespace denali {
 
+/// \brief Makes room for n values, at least doubling the capacity if it grows.
+/*!
+ *  std::vector::reserve allocates exactly what is asked for, so reserving
+ *  a chunk more at a time would copy every value for every chunk.
+ */
+template <typename ValueType>
+void reserveGeometrically(std::vector<ValueType>& values, size_t n)
+{
+    if (n > values.capacity()) {
+        values.reserve(std::max(n, 2 * values.capacity()));
+    }
+}
+
+/// \brief Moves the values of an observing map to their new identifiers.
+/*!
+ *  `new_identifiers[i]` is the new identifier of the value at `i`, or -1
+ *  if it should be dropped. Values are swapped rather than copied, so
+ *  maps of containers are permuted cheaply.
+ */
+template <typename ValueType>
+void permuteMapValues(
+        std::vector<ValueType>& values,
+        const std::vector<int>& new_identifiers,
+        size_t new_size)
+{
+    std::vector<ValueType> permuted(new_size);
+    size_t n = std::min(values.size(), new_identifiers.size());
+    for (size_t i=0; i<n; ++i) {
+        if (new_identifiers[i] != -1) {
+            std::swap(permuted[new_identifiers[i]], values[i]);
+        }
+    }
+    values.swap(permuted);
+}
+
+// std::vector<bool> hands out proxies, which can't be swapped.
+inline void permuteMapValues(
+        std::vector<bool>& values,
+        const std::vector<int>& new_identifiers,
+        size_t new_size)
+{
+    std::vector<bool> permuted(new_size);
+    size_t n = std::min(values.size(), new_identifiers.size());
+    for (size_t i=0; i<n; ++i) {
+        if (new_identifiers[i] != -1) {
+            permuted[new_identifiers[i]] = values[i];
+        }
+    }
+    values.swap(permuted);
+}
+
+
 /// \brief An observing node map.
 /// \ingroup graph_implementations_maps
 /*!
@@ -60,6 +114,16 @@ public:
         _values.resize(_graph.getMaxNodeIdentifier());
     }
 
+    void reserve(size_t n)
+    {
+        reserveGeometrically(_values, n);
+    }
+
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        permuteMapValues(_values, new_identifiers, _graph.getMaxNodeIdentifier());
+    }
+
     typename std::vector<ValueType>::reference
     operator[](typename NodeObservable::Node node)
     {
@@ -106,6 +170,16 @@ public:
         _values.resize(_graph.getMaxArcIdentifier());
     }
 
+    void reserve(size_t n)
+    {
+        reserveGeometrically(_values, n);
+    }
+
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        permuteMapValues(_values, new_identifiers, _graph.getMaxArcIdentifier());
+    }
+
     typename std::vector<ValueType>::reference
     operator[](typename ArcObservable::Arc arc)
     {
@@ -152,6 +226,16 @@ public:
         _values.resize(_graph.getMaxEdgeIdentifier());
     }
 
+    void reserve(size_t n)
+    {
+        reserveGeometrically(_values, n);
+    }
+
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        permuteMapValues(_values, new_identifiers, _graph.getMaxEdgeIdentifier());
+    }
+
     typename std::vector<ValueType>::reference
     operator[](typename EdgeObservable::Edge edge)
     {
@@ -253,6 +337,244 @@ public:
     }
 };
 
+////////////////////////////////////////////////////////////////////////////
+//
+// Lazy maps
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief The values of a lazy map.
+/*!
+ *  The values grow on access to cover the graph's maximum identifier.
+ *  Rather than being told of a compaction, the storage remembers the
+ *  generation of the graph it was filled under, and refuses to be read
+ *  once the graph has moved on without the map being remapped.
+ */
+template <typename ValueType>
+class LazyMapValues
+{
+    mutable std::vector<ValueType> _values;
+    unsigned int _generation;
+
+public:
+    LazyMapValues(unsigned int generation) : _generation(generation) {}
+
+    /// \brief Get the value of the identifier, growing to `max_identifier` if needed.
+    /*!
+     *  The reference is into a std::vector, so growing invalidates every
+     *  reference handed out before. The first access grows the values to
+     *  cover the whole graph, and later ones only grow them if the graph
+     *  has gained identifiers since. So a reference may be held across
+     *  other lookups, as in `Members& a = map[x]; append(a, map[y]);`,
+     *  only if nothing is added to the graph in between.
+     */
+    typename std::vector<ValueType>::reference
+    get(size_t identifier, size_t max_identifier, unsigned int generation) const
+    {
+        if (generation != _generation) {
+            throw std::runtime_error(
+                    "The graph was compacted, but the lazy map wasn't remapped.");
+        }
+
+        if (identifier >= _values.size()) {
+            _values.resize(max_identifier);
+        }
+
+        return _values[identifier];
+    }
+
+    void reserve(size_t n)
+    {
+        reserveGeometrically(_values, n);
+    }
+
+    /// \brief Move the values to their new identifiers, and catch up to `generation`.
+    void remap(const std::vector<int>& new_identifiers, size_t new_size,
+               unsigned int generation)
+    {
+        permuteMapValues(_values, new_identifiers, new_size);
+        _generation = generation;
+    }
+};
+
+
+/// \brief A node map which grows as it is accessed.
+/// \ingroup graph_implementations_maps
+/*!
+ *  The graph must conform to concepts::NodeMappable, and provide
+ *  getGeneration().
+ *
+ *  Unlike ObservingNodeMap, the map doesn't register with the graph, so
+ *  constructing and destroying one is free and adding nodes costs it
+ *  nothing. In exchange, a lookup checks the graph's generation, and
+ *  after the graph is compacted the map must be remapped by hand, with
+ *  the identifiers the compaction reported. Reading the map may grow
+ *  it, so it is not safe to read from several threads, and a reference
+ *  returned by operator[] is only stable until the graph gains a node;
+ *  see LazyMapValues::get().
+ */
+template <typename NodeMappable, typename ValueType>
+class LazyNodeMap
+{
+    const NodeMappable& _graph;
+    LazyMapValues<ValueType> _values;
+
+public:
+    LazyNodeMap(const NodeMappable& graph)
+        : _graph(graph), _values(_graph.getGeneration()) {}
+
+    void reserve(size_t n)
+    {
+        _values.reserve(n);
+    }
+
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        _values.remap(new_identifiers, _graph.getMaxNodeIdentifier(),
+                      _graph.getGeneration());
+    }
+
+    typename std::vector<ValueType>::reference
+    operator[](typename NodeMappable::Node node)
+    {
+        return _values.get(_graph.getNodeIdentifier(node),
+                           _graph.getMaxNodeIdentifier(), _graph.getGeneration());
+    }
+
+    typename std::vector<ValueType>::const_reference
+    operator[](typename NodeMappable::Node node) const
+    {
+        return _values.get(_graph.getNodeIdentifier(node),
+                           _graph.getMaxNodeIdentifier(), _graph.getGeneration());
+    }
+};
+
+
+/// \brief An arc map which grows as it is accessed.
+/// \ingroup graph_implementations_maps
+/*!
+ *  The graph must conform to concepts::ArcMappable, and provide
+ *  getGeneration(). See LazyNodeMap.
+ */
+template <typename ArcMappable, typename ValueType>
+class LazyArcMap
+{
+    const ArcMappable& _graph;
+    LazyMapValues<ValueType> _values;
+
+public:
+    LazyArcMap(const ArcMappable& graph)
+        : _graph(graph), _values(_graph.getGeneration()) {}
+
+    void reserve(size_t n)
+    {
+        _values.reserve(n);
+    }
+
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        _values.remap(new_identifiers, _graph.getMaxArcIdentifier(),
+                      _graph.getGeneration());
+    }
+
+    typename std::vector<ValueType>::reference
+    operator[](typename ArcMappable::Arc arc)
+    {
+        return _values.get(_graph.getArcIdentifier(arc),
+                           _graph.getMaxArcIdentifier(), _graph.getGeneration());
+    }
+
+    typename std::vector<ValueType>::const_reference
+    operator[](typename ArcMappable::Arc arc) const
+    {
+        return _values.get(_graph.getArcIdentifier(arc),
+                           _graph.getMaxArcIdentifier(), _graph.getGeneration());
+    }
+};
+
+
+/// \brief An edge map which grows as it is accessed.
+/// \ingroup graph_implementations_maps
+/*!
+ *  The graph must conform to concepts::EdgeMappable, and provide
+ *  getGeneration(). See LazyNodeMap.
+ */
+template <typename EdgeMappable, typename ValueType>
+class LazyEdgeMap
+{
+    const EdgeMappable& _graph;
+    LazyMapValues<ValueType> _values;
+
+public:
+    LazyEdgeMap(const EdgeMappable& graph)
+        : _graph(graph), _values(_graph.getGeneration()) {}
+
+    void reserve(size_t n)
+    {
+        _values.reserve(n);
+    }
+
+    void remap(const std::vector<int>& new_identifiers)
+    {
+        _values.remap(new_identifiers, _graph.getMaxEdgeIdentifier(),
+                      _graph.getGeneration());
+    }
+
+    typename std::vector<ValueType>::reference
+    operator[](typename EdgeMappable::Edge edge)
+    {
+        return _values.get(_graph.getEdgeIdentifier(edge),
+                           _graph.getMaxEdgeIdentifier(), _graph.getGeneration());
+    }
+
+    typename std::vector<ValueType>::const_reference
+    operator[](typename EdgeMappable::Edge edge) const
+    {
+        return _values.get(_graph.getEdgeIdentifier(edge),
+                           _graph.getMaxEdgeIdentifier(), _graph.getGeneration());
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+//
+// Map policies
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief Map policy choosing the observing maps.
+/// \ingroup graph_implementations_maps
+/*!
+ *  A class parameterized on a map policy declares its maps as, e.g.,
+ *  `typename Maps::template NodeMap<Graph, int>::Type`.
+ */
+struct ObservingMaps
+{
+    template <typename Graph, typename ValueType>
+    struct NodeMap { typedef ObservingNodeMap<Graph, ValueType> Type; };
+
+    template <typename Graph, typename ValueType>
+    struct ArcMap { typedef ObservingArcMap<Graph, ValueType> Type; };
+
+    template <typename Graph, typename ValueType>
+    struct EdgeMap { typedef ObservingEdgeMap<Graph, ValueType> Type; };
+};
+
+
+/// \brief Map policy choosing the lazy maps.
+/// \ingroup graph_implementations_maps
+struct LazyMaps
+{
+    template <typename Graph, typename ValueType>
+    struct NodeMap { typedef LazyNodeMap<Graph, ValueType> Type; };
+
+    template <typename Graph, typename ValueType>
+    struct ArcMap { typedef LazyArcMap<Graph, ValueType> Type; };
+
+    template <typename Graph, typename ValueType>
+    struct EdgeMap { typedef LazyEdgeMap<Graph, ValueType> Type; };
+};
+
 }
 
 #endif
@@ -194,6 +194,11 @@ public:
         return _graph.getMaxArcIdentifier();
     }
 
+    /// \brief Gets the number of times the identifiers have been renumbered.
+    unsigned int getGeneration() const {
+        return _graph.getGeneration();
+    }
+
     /// \brief Get the identifier of the arc.
     unsigned int getArcIdentifier(Arc arc) const {
         return _graph.getArcIdentifier(arc);
@@ -319,6 +324,12 @@ public:
         return _graph.getMaxEdgeIdentifier();
     }
 
+    /// \brief Gets the number of times the identifiers have been renumbered.
+    unsigned int getGeneration() const
+    {
+        return _graph.getGeneration();
+    }
+
     /// \brief Get the identifier of the edge.
     unsigned int getEdgeIdentifier(Edge edge) const
     {
@@ -410,6 +421,40 @@ public:
         return _graph.addArc(u,v);
     }
 
+    /// \brief Add n nodes to the graph, writing each to the iterator.
+    /*!
+     *  Observers are notified once, after all of the nodes are added.
+     */
+    template <typename OutputIterator>
+    void addNodes(size_t n, OutputIterator out) {
+        _graph.addNodes(n, out);
+    }
+
+    /// \brief Add an arc for each (source, target) pair in the range.
+    /*!
+     *  Observers are notified once, after all of the arcs are added.
+     *  \pre Requires that all of the nodes are in the graph.
+     */
+    template <typename InputIterator>
+    void addArcs(InputIterator first, InputIterator last) {
+        _graph.addArcs(first, last);
+    }
+
+    /// \brief Reserve room for the given number of nodes and arcs.
+    void reserve(size_t n_nodes, size_t n_arcs) {
+        _graph.reserve(n_nodes, n_arcs);
+    }
+
+    /// \brief Begin deferring observer notifications. See GraphBatch.
+    void beginBatch() {
+        _graph.beginBatch();
+    }
+
+    /// \brief Stop deferring observer notifications. See GraphBatch.
+    void endBatch() {
+        _graph.endBatch();
+    }
+
     /// \brief Remove a node from the graph.
     /// \pre Requires that the node is in the graph.
     void removeNode(Node node) {
@@ -422,11 +467,49 @@ public:
         return _graph.removeArc(arc);
     }
 
+    /// \brief Take a node and its arcs out of the graph, keeping their slots.
+    /*!
+     *  The node is no longer valid, but it can be put back with showNode()
+     *  under the same identifier. Since no identifier changes, observers
+     *  aren't notified. compact() releases the slots of hidden elements.
+     *  \pre Requires that the node is in the graph.
+     */
+    void hideNode(Node node) {
+        _graph.hideNode(node);
+    }
+
+    /// \brief Put a hidden node back into the graph, without any arcs.
+    void showNode(Node node) {
+        _graph.showNode(node);
+    }
+
+    /// \brief Take an arc out of the graph, keeping its slot. See hideNode().
+    /// \pre Requires that the arc is in the graph.
+    void hideArc(Arc arc) {
+        _graph.hideArc(arc);
+    }
+
+    /// \brief Put a hidden arc back into the graph, from u to v.
+    /// \pre Requires that the nodes are in the graph.
+    void showArc(Arc arc, Node u, Node v) {
+        _graph.showArc(arc, u, v);
+    }
+
     /// \brief Clear the graph.
     void clear() {
         return _graph.clear();
     }
 
+    /// \brief Renumber the nodes and arcs densely, in iteration order.
+    /*!
+     *  Releases the space held by removed elements. Observers are told
+     *  where each element moved, so observing maps keep their values.
+     *  Nodes and arcs held outside of the graph are invalidated.
+     */
+    void compact() {
+        _graph.compact();
+    }
+
 };
 
 
@@ -456,6 +539,40 @@ public:
         return _graph.addEdge(u,v);
     }
 
+    /// \brief Add n nodes to the graph, writing each to the iterator.
+    /*!
+     *  Observers are notified once, after all of the nodes are added.
+     */
+    template <typename OutputIterator>
+    void addNodes(size_t n, OutputIterator out) {
+        _graph.addNodes(n, out);
+    }
+
+    /// \brief Add an edge for each pair of nodes in the range.
+    /*!
+     *  Observers are notified once, after all of the edges are added.
+     *  \pre The nodes must be in the graph.
+     */
+    template <typename InputIterator>
+    void addEdges(InputIterator first, InputIterator last) {
+        _graph.addEdges(first, last);
+    }
+
+    /// \brief Reserve room for the given number of nodes and edges.
+    void reserve(size_t n_nodes, size_t n_edges) {
+        _graph.reserve(n_nodes, n_edges);
+    }
+
+    /// \brief Begin deferring observer notifications. See GraphBatch.
+    void beginBatch() {
+        _graph.beginBatch();
+    }
+
+    /// \brief Stop deferring observer notifications. See GraphBatch.
+    void endBatch() {
+        _graph.endBatch();
+    }
+
     /// \brief Remove a node from the graph.
     /// \pre The node must be in the graph.
     void removeNode(Node node) {
@@ -468,10 +585,48 @@ public:
         return _graph.removeEdge(edge);
     }
 
+    /// \brief Take a node and its edges out of the graph, keeping their slots.
+    /*!
+     *  The node is no longer valid, but it can be put back with showNode()
+     *  under the same identifier. Since no identifier changes, observers
+     *  aren't notified. compact() releases the slots of hidden elements.
+     *  \pre The node must be in the graph.
+     */
+    void hideNode(Node node) {
+        _graph.hideNode(node);
+    }
+
+    /// \brief Put a hidden node back into the graph, without any edges.
+    void showNode(Node node) {
+        _graph.showNode(node);
+    }
+
+    /// \brief Take an edge out of the graph, keeping its slot. See hideNode().
+    /// \pre The edge must be in the graph.
+    void hideEdge(Edge edge) {
+        _graph.hideEdge(edge);
+    }
+
+    /// \brief Put a hidden edge back into the graph, between u and v.
+    /// \pre The nodes must be in the graph.
+    void showEdge(Edge edge, Node u, Node v) {
+        _graph.showEdge(edge, u, v);
+    }
+
     /// \brief Clear the graph.
     void clear() {
         return _graph.clear();
     }
+
+    /// \brief Renumber the nodes and edges densely, in iteration order.
+    /*!
+     *  Releases the space held by removed elements. Observers are told
+     *  where each element moved, so observing maps keep their values.
+     *  Nodes and edges held outside of the graph are invalidated.
+     */
+    void compact() {
+        _graph.compact();
+    }
 };
 
 
@@ -63,12 +63,179 @@
 
 #include <algorithm>
 #include <list>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
+#include <boost/thread.hpp>
+
 #include <denali/graph_mixins.h>
 
 namespace denali {
 
+////////////////////////////////////////////////////////////////////////////
+//
+// GraphBatch
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief Defers the observer notifications of a graph for its lifetime.
+/*!
+ *  While a GraphBatch is alive, the graph's observers are not notified
+ *  of added or removed nodes and arcs. When the last batch on the graph
+ *  is destroyed, each observer that missed a notification is notified
+ *  exactly once. This turns the repeated resizing of observing maps while
+ *  building a large graph into a single resize.
+ *
+ *  Batches may be nested. Observing maps must not be accessed with nodes
+ *  or edges that were added during the batch until the batch has ended.
+ */
+template <typename Graph>
+class GraphBatch
+{
+    Graph& _graph;
+
+    GraphBatch(const GraphBatch&);
+    GraphBatch& operator=(const GraphBatch&);
+
+public:
+    explicit GraphBatch(Graph& graph) : _graph(graph)
+    {
+        _graph.beginBatch();
+    }
+
+    ~GraphBatch()
+    {
+        _graph.endBatch();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////
+//
+// Vector graph layouts
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief Stores the records of a VectorDirectedGraphImplementation as
+/// an array of structs.
+/*!
+ *  Each node or arc is a single record holding all of its fields, so
+ *  touching one field brings the others into cache with it. This is the
+ *  default layout.
+ */
+struct ArrayOfStructsLayout
+{
+    /// \brief A table of records, each with N_FIELDS integer fields and
+    /// a validity flag.
+    template <int N_FIELDS>
+    class Table
+    {
+        struct Record
+        {
+            int fields[N_FIELDS];
+            bool valid;
+        };
+
+        std::vector<Record> _records;
+
+    public:
+        typedef bool& ValidReference;
+
+        int& operator()(int i, int field) {
+            return _records[i].fields[field];
+        }
+        int operator()(int i, int field) const {
+            return _records[i].fields[field];
+        }
+
+        ValidReference valid(int i) {
+            return _records[i].valid;
+        }
+        bool valid(int i) const {
+            return _records[i].valid;
+        }
+
+        size_t size() const {
+            return _records.size();
+        }
+        size_t capacity() const {
+            return _records.capacity();
+        }
+        void reserve(size_t n) {
+            _records.reserve(n);
+        }
+        void push_back() {
+            _records.push_back(Record());
+        }
+        void swap(Table& other) {
+            _records.swap(other._records);
+        }
+    };
+};
+
+
+/// \brief Stores the records of a VectorDirectedGraphImplementation as
+/// a struct of arrays.
+/*!
+ *  Each field is kept in its own array, and the validity flags in a
+ *  bitset. Traversals that follow a single kind of link, such as the out
+ *  arcs of a node, then read densely packed memory and skip the fields
+ *  they don't need.
+ */
+struct StructOfArraysLayout
+{
+    /// \brief A table of records, each with N_FIELDS integer fields and
+    /// a validity flag.
+    template <int N_FIELDS>
+    class Table
+    {
+        std::vector<int> _fields[N_FIELDS];
+        std::vector<bool> _valid;
+
+    public:
+        typedef std::vector<bool>::reference ValidReference;
+
+        int& operator()(int i, int field) {
+            return _fields[field][i];
+        }
+        int operator()(int i, int field) const {
+            return _fields[field][i];
+        }
+
+        ValidReference valid(int i) {
+            return _valid[i];
+        }
+        bool valid(int i) const {
+            return _valid[i];
+        }
+
+        size_t size() const {
+            return _valid.size();
+        }
+        size_t capacity() const {
+            return _fields[0].capacity();
+        }
+        void reserve(size_t n) {
+            for (int field=0; field<N_FIELDS; ++field) {
+                _fields[field].reserve(n);
+            }
+            _valid.reserve(n);
+        }
+        void push_back() {
+            for (int field=0; field<N_FIELDS; ++field) {
+                _fields[field].push_back(0);
+            }
+            _valid.push_back(false);
+        }
+        void swap(Table& other) {
+            for (int field=0; field<N_FIELDS; ++field) {
+                _fields[field].swap(other._fields[field]);
+            }
+            _valid.swap(other._valid);
+        }
+    };
+};
+
 ////////////////////////////////////////////////////////////////////////////
 //
 // VectorDirectedGraphImplementation
@@ -79,36 +246,41 @@ namespace denali {
 /*!
  * It contains functionality that is not intended to be part of the
  * interface of VectorDirectedGraph.
+ *
+ * The Layout decides how node and arc records are stored in memory. It
+ * is either ArrayOfStructsLayout or StructOfArraysLayout.
  */
+template <typename Layout = ArrayOfStructsLayout>
 class VectorDirectedGraphImplementation
 {
 public:
     class Observer;
 
 private:
-    struct NodeRep
+    // the fields of a node record
+    enum NodeField
     {
-        int first_in, first_out;
-        int prev, next;
-        bool valid;
-        int in_degree;
-        int out_degree;
+        FIRST_IN, FIRST_OUT,
+        PREV, NEXT,
+        IN_DEGREE, OUT_DEGREE,
+        NUMBER_OF_NODE_FIELDS
     };
 
-    struct ArcRep
+    // the fields of an arc record
+    enum ArcField
     {
-        int target, source;
-        int prev_in, prev_out;
-        int next_in, next_out;
-        bool valid;
+        TARGET, SOURCE,
+        PREV_IN, PREV_OUT,
+        NEXT_IN, NEXT_OUT,
+        NUMBER_OF_ARC_FIELDS
     };
 
-    typedef std::vector<NodeRep> Nodes;
+    typedef typename Layout::template Table<NUMBER_OF_NODE_FIELDS> Nodes;
     Nodes nodes;
     int first_node;
     int first_free_node;
 
-    typedef std::vector<ArcRep> Arcs;
+    typedef typename Layout::template Table<NUMBER_OF_ARC_FIELDS> Arcs;
     Arcs arcs;
     int first_free_arc;
 
@@ -119,12 +291,24 @@ private:
     Observers _node_observers;
     Observers _arc_observers;
 
+    // the depth of nested batches, and whether observers missed a
+    // notification while a batch was open
+    int _batch_depth;
+    mutable bool _node_notification_pending;
+    mutable bool _arc_notification_pending;
+
+    // counts the compactions, so that maps which don't observe the graph
+    // can tell that their identifiers are stale
+    unsigned int _generation;
+
 public:
 
 
     VectorDirectedGraphImplementation()
         : first_node(-1), first_free_node(-1), first_free_arc(-1),
-          number_of_nodes(0), number_of_arcs(0) {};
+          number_of_nodes(0), number_of_arcs(0), _batch_depth(0),
+          _node_notification_pending(false),
+          _arc_notification_pending(false), _generation(0) {};
 
     class Node
     {
@@ -178,13 +362,32 @@ public:
     {
     public:
         virtual void notify() = 0;
+
+        /// \brief Called before the graph grows to the given size.
+        virtual void reserve(size_t) {}
+
+        /// \brief Called after the graph has been compacted.
+        /*!
+         *  `new_identifiers[i]` is the new identifier of the element whose
+         *  identifier was `i`, or -1 if the element had been removed.
+         *  Observers which don't override this are simply notified.
+         */
+        virtual void remap(const std::vector<int>& /* new_identifiers */) {
+            notify();
+        }
+
         virtual ~Observer() {}
     };
 
 
     void notifyNodeObservers() const
     {
-        for (Observers::const_iterator it = _node_observers.begin();
+        if (_batch_depth > 0) {
+            _node_notification_pending = true;
+            return;
+        }
+
+        for (typename Observers::const_iterator it = _node_observers.begin();
                 it != _node_observers.end();
                 ++it) {
             (*it)->notify();
@@ -193,13 +396,92 @@ public:
 
     void notifyArcObservers() const
     {
-        for (Observers::const_iterator it = _arc_observers.begin();
+        if (_batch_depth > 0) {
+            _arc_notification_pending = true;
+            return;
+        }
+
+        for (typename Observers::const_iterator it = _arc_observers.begin();
                 it != _arc_observers.end();
                 ++it) {
             (*it)->notify();
         }
     }
 
+    void beginBatch()
+    {
+        _batch_depth++;
+    }
+
+    void endBatch()
+    {
+        if (--_batch_depth > 0) {
+            return;
+        }
+
+        if (_node_notification_pending) {
+            _node_notification_pending = false;
+            notifyNodeObservers();
+        }
+
+        if (_arc_notification_pending) {
+            _arc_notification_pending = false;
+            notifyArcObservers();
+        }
+    }
+
+    void reserve(size_t n_nodes, size_t n_arcs)
+    {
+        // Make room for the given number of nodes and arcs, and let the
+        // observers do the same. When the capacity grows, it at least
+        // doubles, so that reserving a chunk more at a time stays linear.
+        if (n_nodes > nodes.capacity())
+        {
+            n_nodes = std::max(n_nodes, 2 * nodes.capacity());
+            nodes.reserve(n_nodes);
+            for (typename Observers::const_iterator it = _node_observers.begin();
+                    it != _node_observers.end();
+                    ++it) {
+                (*it)->reserve(n_nodes);
+            }
+        }
+
+        if (n_arcs > arcs.capacity())
+        {
+            n_arcs = std::max(n_arcs, 2 * arcs.capacity());
+            arcs.reserve(n_arcs);
+            for (typename Observers::const_iterator it = _arc_observers.begin();
+                    it != _arc_observers.end();
+                    ++it) {
+                (*it)->reserve(n_arcs);
+            }
+        }
+    }
+
+    template <typename OutputIterator>
+    void addNodes(size_t n, OutputIterator out)
+    {
+        // Adds n nodes, writing each to the output iterator. Observers
+        // are notified once, after all of the nodes have been added.
+        reserve(nodes.size() + n, arcs.size());
+
+        GraphBatch<VectorDirectedGraphImplementation> batch(*this);
+        for (size_t i=0; i<n; ++i) {
+            *out++ = addNode();
+        }
+    }
+
+    template <typename InputIterator>
+    void addArcs(InputIterator first, InputIterator last)
+    {
+        // Adds an arc for each (source, target) pair in the range.
+        // Observers are notified once, after all of the arcs have been added.
+        GraphBatch<VectorDirectedGraphImplementation> batch(*this);
+        for (; first != last; ++first) {
+            addArc(first->first, first->second);
+        }
+    }
+
     Node addNode()
     {
         // the index of the node in the vector
@@ -208,34 +490,14 @@ public:
         // if there isn't a free node, we push a new one
         if (first_free_node == -1) {
             n = nodes.size();
-            nodes.push_back(NodeRep());
+            nodes.push_back();
         } else {
             n = first_free_node;
             // the new free node was pointed to by the old first free
-            first_free_node = nodes[n].next;
-        }
-
-        nodes[n].next = first_node;
-
-        // if the old first node was valid, we update it's links
-        if (first_node != -1) {
-            nodes[first_node].prev = n;
+            first_free_node = nodes(n, NEXT);
         }
 
-        first_node = n;
-        nodes[n].prev = -1;
-
-        // the new node has no arcs
-        nodes[n].first_in = nodes[n].first_out = -1;
-
-        // the node is valid
-        nodes[n].valid = true;
-
-        // the degrees of the node need to be set to zero
-        nodes[n].in_degree = nodes[n].out_degree = 0;
-
-        // one more node
-        number_of_nodes++;
+        linkNode(n);
 
         // notify
         notifyNodeObservers();
@@ -251,52 +513,130 @@ public:
         // check to see if there is an available slot
         if (first_free_arc == -1) {
             n = arcs.size();
-            arcs.push_back(ArcRep());
+            arcs.push_back();
         } else {
             n = first_free_arc;
-            first_free_arc = arcs[n].next_in;
+            first_free_arc = arcs(n, NEXT_IN);
         }
 
+        linkArc(n, u, v);
+
+        // notify
+        notifyArcObservers();
+
+        return Arc(n);
+    }
+
+    void hideNode(const Node node)
+    {
+        // Takes the node and its arcs out of the graph, like removeNode,
+        // but keeps their slots so that they can be shown again under the
+        // same identifiers. No identifier changes, so observers aren't
+        // notified. The slots of hidden nodes and arcs are released by
+        // compact().
+
+        Arc arc = firstOutArc(node);
+        while (isArcValid(arc)) {
+            unlinkArc(arc.index);
+            arc = firstOutArc(node);
+        }
+
+        arc = firstInArc(node);
+        while (isArcValid(arc)) {
+            unlinkArc(arc.index);
+            arc = firstInArc(node);
+        }
+
+        unlinkNode(node.index);
+    }
+
+    void showNode(const Node node)
+    {
+        // Puts a hidden node back into the graph, without any arcs.
+        linkNode(node.index);
+    }
+
+    void hideArc(const Arc arc)
+    {
+        // Takes the arc out of the graph, keeping its slot. See hideNode.
+        unlinkArc(arc.index);
+    }
+
+    void showArc(const Arc arc, const Node u, const Node v)
+    {
+        // Puts a hidden arc back into the graph. Its endpoints needn't be
+        // the ones it had when it was hidden.
+        linkArc(arc.index, u, v);
+    }
+
+    void linkNode(int n)
+    {
+        // This is a helper function which puts the node at the front of
+        // the node list, with no arcs, and marks it as valid.
+
+        nodes(n, NEXT) = first_node;
+
+        // if the old first node was valid, we update it's links
+        if (first_node != -1) {
+            nodes(first_node, PREV) = n;
+        }
+
+        first_node = n;
+        nodes(n, PREV) = -1;
+
+        // the new node has no arcs
+        nodes(n, FIRST_IN) = nodes(n, FIRST_OUT) = -1;
+
+        // the node is valid
+        nodes.valid(n) = true;
+
+        // the degrees of the node need to be set to zero
+        nodes(n, IN_DEGREE) = nodes(n, OUT_DEGREE) = 0;
+
+        // one more node
+        number_of_nodes++;
+    }
+
+    void linkArc(int n, const Node u, const Node v)
+    {
+        // This is a helper function which puts the arc at the front of the
+        // arc lists of its source and target, and marks it as valid.
+
         // assign source and targets of the edge
-        arcs[n].source = u.index;
-        arcs[n].target = v.index;
+        arcs(n, SOURCE) = u.index;
+        arcs(n, TARGET) = v.index;
 
         // make this the first out of the source node, and make the
         // existing first out's prev this node
-        arcs[n].next_out = nodes[u.index].first_out;
-        if (nodes[u.index].first_out != -1) {
-            arcs[nodes[u.index].first_out].prev_out = n;
+        arcs(n, NEXT_OUT) = nodes(u.index, FIRST_OUT);
+        if (nodes(u.index, FIRST_OUT) != -1) {
+            arcs(nodes(u.index, FIRST_OUT), PREV_OUT) = n;
         }
 
         // make this the first in of the target node, and make the
         // existing first in's prev this node
-        arcs[n].next_in = nodes[v.index].first_in;
-        if (nodes[v.index].first_in != -1) {
-            arcs[nodes[v.index].first_in].prev_in = n;
+        arcs(n, NEXT_IN) = nodes(v.index, FIRST_IN);
+        if (nodes(v.index, FIRST_IN) != -1) {
+            arcs(nodes(v.index, FIRST_IN), PREV_IN) = n;
         }
 
         // this is the first in and out arc: make the prev in and out
         // invalid
-        arcs[n].prev_in = arcs[n].prev_out = -1;
+        arcs(n, PREV_IN) = arcs(n, PREV_OUT) = -1;
 
-        nodes[u.index].first_out = nodes[v.index].first_in = n;
+        nodes(u.index, FIRST_OUT) = nodes(v.index, FIRST_IN) = n;
 
         // the arc is valid
-        arcs[n].valid = true;
+        arcs.valid(n) = true;
 
         // the source's out degree is +1
-        nodes[u.index].out_degree++;
+        nodes(u.index, OUT_DEGREE)++;
 
         // the target's in degree is +1
-        nodes[v.index].in_degree++;
+        nodes(v.index, IN_DEGREE)++;
 
         // one more arc
         number_of_arcs++;
-
-        // notify
-        notifyArcObservers();
-
-        return Arc(n);
     }
 
     int numberOfNodes() const {
@@ -323,23 +663,31 @@ public:
 
         int n = node.index;
 
+        unlinkNode(n);
+
+        nodes(n, NEXT) = first_free_node;
+        first_free_node = n;
+    }
+
+    void unlinkNode(int n)
+    {
+        // This is a helper function which takes the node out of the node
+        // list and marks it as invalid, without freeing its slot.
+
         // if the next and prev nodes are valid connect them
 
-        if (nodes[n].next != -1) {
-            nodes[nodes[n].next].prev = nodes[n].prev;
+        if (nodes(n, NEXT) != -1) {
+            nodes(nodes(n, NEXT), PREV) = nodes(n, PREV);
         }
 
-        if (nodes[n].prev != -1) {
-            nodes[nodes[n].prev].next = nodes[n].next;
+        if (nodes(n, PREV) != -1) {
+            nodes(nodes(n, PREV), NEXT) = nodes(n, NEXT);
         } else {
             // this must have been the first node. Not anymore.
-            first_node = nodes[n].next;
+            first_node = nodes(n, NEXT);
         }
 
-        nodes[n].next = first_free_node;
-        first_free_node = n;
-
-        nodes[n].valid = false;
+        nodes.valid(n) = false;
 
         number_of_nodes--;
     }
@@ -359,36 +707,45 @@ public:
 
         int n = arc.index;
 
-        if (arcs[n].next_in != -1) {
-            arcs[arcs[n].next_in].prev_in = arcs[n].prev_in;
+        unlinkArc(n);
+
+        arcs(n, NEXT_IN) = first_free_arc;
+        first_free_arc = n;
+    }
+
+    void unlinkArc(int n)
+    {
+        // This is a helper function which takes the arc out of the arc
+        // lists of its source and target, marks it as invalid and updates
+        // the degrees, without freeing its slot.
+
+        if (arcs(n, NEXT_IN) != -1) {
+            arcs(arcs(n, NEXT_IN), PREV_IN) = arcs(n, PREV_IN);
         }
 
-        if (arcs[n].prev_in != -1) {
-            arcs[arcs[n].prev_in].next_in = arcs[n].next_in;
+        if (arcs(n, PREV_IN) != -1) {
+            arcs(arcs(n, PREV_IN), NEXT_IN) = arcs(n, NEXT_IN);
         } else {
-            nodes[arcs[n].target].first_in = arcs[n].next_in;
+            nodes(arcs(n, TARGET), FIRST_IN) = arcs(n, NEXT_IN);
         }
 
-        if (arcs[n].next_out != -1) {
-            arcs[arcs[n].next_out].prev_out = arcs[n].prev_out;
+        if (arcs(n, NEXT_OUT) != -1) {
+            arcs(arcs(n, NEXT_OUT), PREV_OUT) = arcs(n, PREV_OUT);
         }
 
-        if (arcs[n].prev_out != -1) {
-            arcs[arcs[n].prev_out].next_out = arcs[n].next_out;
+        if (arcs(n, PREV_OUT) != -1) {
+            arcs(arcs(n, PREV_OUT), NEXT_OUT) = arcs(n, NEXT_OUT);
         } else {
-            nodes[arcs[n].source].first_out = arcs[n].next_out;
+            nodes(arcs(n, SOURCE), FIRST_OUT) = arcs(n, NEXT_OUT);
         }
 
-        arcs[n].next_in = first_free_arc;
-        first_free_arc = n;
-
-        arcs[n].valid = false;
+        arcs.valid(n) = false;
 
         // the source node's out degree is -1
-        nodes[arcs[n].source].out_degree--;
+        nodes(arcs(n, SOURCE), OUT_DEGREE)--;
 
         // the target node's in degree is -1
-        nodes[arcs[n].target].in_degree--;
+        nodes(arcs(n, TARGET), IN_DEGREE)--;
 
         number_of_arcs--;
     }
@@ -441,41 +798,41 @@ public:
 
     int degree(const Node node) const
     {
-        return nodes[node.index].in_degree + nodes[node.index].out_degree;
+        return nodes(node.index, IN_DEGREE) + nodes(node.index, OUT_DEGREE);
     }
 
     int inDegree(const Node node) const
     {
-        return nodes[node.index].in_degree;
+        return nodes(node.index, IN_DEGREE);
     }
 
     int outDegree(const Node node) const
     {
-        return nodes[node.index].out_degree;
+        return nodes(node.index, OUT_DEGREE);
     }
 
     Arc firstOutArc(const Node node) const
     {
         // Returns the first out arc of the node.
-        return Arc(nodes[node.index].first_out);
+        return Arc(nodes(node.index, FIRST_OUT));
     }
 
     Arc firstInArc(const Node node) const
     {
         // Returns the first in arc of the node.
-        return Arc(nodes[node.index].first_in);
+        return Arc(nodes(node.index, FIRST_IN));
     }
 
     bool isNodeValid(const Node node) const
     {
         return node.index >= 0 && (unsigned int) node.index < nodes.size() &&
-               nodes[node.index].valid;
+               nodes.valid(node.index);
     }
 
     bool isArcValid(const Arc arc) const
     {
         return (arc.index >= 0 && (unsigned int) arc.index < arcs.size() &&
-               arcs[arc.index].valid);
+               arcs.valid(arc.index));
     }
 
     Node getFirstNode() const
@@ -485,17 +842,17 @@ public:
 
     Node getNextNode(Node node) const
     {
-        return nodes[node.index].next;
+        return nodes(node.index, NEXT);
     }
 
     Node source(const Arc arc) const
     {
-        return Node(arcs[arc.index].source);
+        return Node(arcs(arc.index, SOURCE));
     }
 
     Node target(const Arc arc) const
     {
-        return Node(arcs[arc.index].target);
+        return Node(arcs(arc.index, TARGET));
     }
 
     Node opposite(const Node node, const Arc arc) const
@@ -509,53 +866,53 @@ public:
         // we iterate through the nodes until we find one with an out arc
         // that isn't invalid
         Node node = getFirstNode();
-        while (isNodeValid(node) && nodes[node.index].first_out == -1) {
+        while (isNodeValid(node) && nodes(node.index, FIRST_OUT) == -1) {
             node = getNextNode(node);
         }
 
         if (!isNodeValid(node)) {
             return Arc(-1);
         } else {
-            return Arc(nodes[node.index].first_out);
+            return Arc(nodes(node.index, FIRST_OUT));
         }
     }
 
     Arc getNextArc(Arc arc) const
     {
-        if (arcs[arc.index].next_out != -1) {
-            return Arc(arcs[arc.index].next_out);
+        if (arcs(arc.index, NEXT_OUT) != -1) {
+            return Arc(arcs(arc.index, NEXT_OUT));
         } else {
-            Node node = nodes[source(arc).index].next;
-            while (isNodeValid(node) && nodes[node.index].first_out == -1) {
+            Node node = nodes(source(arc).index, NEXT);
+            while (isNodeValid(node) && nodes(node.index, FIRST_OUT) == -1) {
                 node = getNextNode(node);
             }
 
             if (!isNodeValid(node)) {
                 return Arc(-1);
             } else {
-                return Arc(nodes[node.index].first_out);
+                return Arc(nodes(node.index, FIRST_OUT));
             }
         }
     }
 
     Arc getFirstOutArc(const Node node) const
     {
-        return Arc(nodes[node.index].first_out);
+        return Arc(nodes(node.index, FIRST_OUT));
     }
 
     Arc getNextOutArc(const Arc arc) const
     {
-        return Arc(arcs[arc.index].next_out);
+        return Arc(arcs(arc.index, NEXT_OUT));
     }
 
     Arc getFirstInArc(const Node node) const
     {
-        return Arc(nodes[node.index].first_in);
+        return Arc(nodes(node.index, FIRST_IN));
     }
 
     Arc getNextInArc(const Arc arc) const
     {
-        return Arc(arcs[arc.index].next_in);
+        return Arc(arcs(arc.index, NEXT_IN));
     }
 
     Arc getFirstNeighborArc(const Node node) const
@@ -609,6 +966,12 @@ public:
         return arcs.size();
     }
 
+    /// \brief The number of times the graph has been compacted.
+    unsigned int getGeneration() const
+    {
+        return _generation;
+    }
+
     void attachNodeObserver(Observer& ob)
     {
         _node_observers.push_back(&ob);
@@ -668,6 +1031,89 @@ public:
         }
     }
 
+    void compact()
+    {
+        // Renumbers the live nodes and arcs densely, in iteration order,
+        // and releases the slots of removed ones. Observers are handed the
+        // mapping from old to new identifiers. Any Node or Arc held outside
+        // of the graph is invalidated.
+        if (_batch_depth > 0) {
+            throw std::runtime_error("A graph can't be compacted during a batch.");
+        }
+
+        std::vector<int> node_map(nodes.size(), -1);
+        int n_nodes = 0;
+        for (int n = first_node; n != -1; n = nodes(n, NEXT)) {
+            node_map[n] = n_nodes++;
+        }
+
+        // arcs are iterated over by their source's out arcs
+        std::vector<int> arc_map(arcs.size(), -1);
+        std::vector<int> arc_order;
+        arc_order.reserve(number_of_arcs);
+        for (int n = first_node; n != -1; n = nodes(n, NEXT)) {
+            for (int a = nodes(n, FIRST_OUT); a != -1; a = arcs(a, NEXT_OUT)) {
+                arc_map[a] = arc_order.size();
+                arc_order.push_back(a);
+            }
+        }
+
+        Nodes new_nodes;
+        new_nodes.reserve(n_nodes);
+        for (int n = first_node; n != -1; n = nodes(n, NEXT)) {
+            int m = new_nodes.size();
+            new_nodes.push_back();
+            new_nodes(m, FIRST_IN) = remapIndex(arc_map, nodes(n, FIRST_IN));
+            new_nodes(m, FIRST_OUT) = remapIndex(arc_map, nodes(n, FIRST_OUT));
+            new_nodes(m, PREV) = m - 1;
+            new_nodes(m, NEXT) = m + 1 < n_nodes ? m + 1 : -1;
+            new_nodes(m, IN_DEGREE) = nodes(n, IN_DEGREE);
+            new_nodes(m, OUT_DEGREE) = nodes(n, OUT_DEGREE);
+            new_nodes.valid(m) = true;
+        }
+
+        Arcs new_arcs;
+        new_arcs.reserve(arc_order.size());
+        for (size_t m = 0; m < arc_order.size(); ++m) {
+            int a = arc_order[m];
+            new_arcs.push_back();
+            new_arcs(m, TARGET) = node_map[arcs(a, TARGET)];
+            new_arcs(m, SOURCE) = node_map[arcs(a, SOURCE)];
+            new_arcs(m, PREV_IN) = remapIndex(arc_map, arcs(a, PREV_IN));
+            new_arcs(m, PREV_OUT) = remapIndex(arc_map, arcs(a, PREV_OUT));
+            new_arcs(m, NEXT_IN) = remapIndex(arc_map, arcs(a, NEXT_IN));
+            new_arcs(m, NEXT_OUT) = remapIndex(arc_map, arcs(a, NEXT_OUT));
+            new_arcs.valid(m) = true;
+        }
+
+        nodes.swap(new_nodes);
+        arcs.swap(new_arcs);
+
+        first_node = n_nodes > 0 ? 0 : -1;
+        first_free_node = -1;
+        first_free_arc = -1;
+        ++_generation;
+
+        for (typename Observers::const_iterator it = _node_observers.begin();
+                it != _node_observers.end();
+                ++it) {
+            (*it)->remap(node_map);
+        }
+
+        for (typename Observers::const_iterator it = _arc_observers.begin();
+                it != _arc_observers.end();
+                ++it) {
+            (*it)->remap(arc_map);
+        }
+    }
+
+private:
+
+    static int remapIndex(const std::vector<int>& new_indices, int index)
+    {
+        return index == -1 ? -1 : new_indices[index];
+    }
+
 };
 
 
@@ -718,10 +1164,29 @@ public:
  *  reference instead of this page.
  */
 class DirectedGraph :
-    public DirectedGraphBase<VectorDirectedGraphImplementation>
+    public DirectedGraphBase<VectorDirectedGraphImplementation<> >
+{
+    typedef
+    DirectedGraphBase<VectorDirectedGraphImplementation<> >
+    Base;
+
+public:
+    typedef Base::Node Node;
+    typedef Base::Arc Arc;
+    typedef Base::Observer Observer;
+};
+
+
+/// \brief A directed graph stored as a struct of arrays.
+/// \ingroup graph_implementations_structures
+/*!
+ *  Interchangeable with DirectedGraph, but uses StructOfArraysLayout.
+ */
+class StructOfArraysDirectedGraph :
+    public DirectedGraphBase<VectorDirectedGraphImplementation<StructOfArraysLayout> >
 {
     typedef
-    DirectedGraphBase<VectorDirectedGraphImplementation>
+    DirectedGraphBase<VectorDirectedGraphImplementation<StructOfArraysLayout> >
     Base;
 
 public:
@@ -875,6 +1340,11 @@ public:
         return impl.getMaxArcIdentifier();
     }
 
+    unsigned int getGeneration() const
+    {
+        return impl.getGeneration();
+    }
+
     unsigned int getEdgeIdentifier(Edge edge) const
     {
         return impl.getArcIdentifier(edge.base);
@@ -892,17 +1362,65 @@ public:
         return Edge(impl.addArc(u.base, v.base));
     }
 
-    void removeNode(Node node) {
-        impl.removeNode(node.base);
-    }
-    void removeEdge(Edge edge) {
-        impl.removeArc(edge.base);
+    template <typename OutputIterator>
+    void addNodes(size_t n, OutputIterator out)
+    {
+        impl.reserve(impl.getMaxNodeIdentifier() + n,
+                     impl.getMaxArcIdentifier());
+
+        GraphBatch<Impl> batch(impl);
+        for (size_t i=0; i<n; ++i) {
+            *out++ = Node(impl.addNode());
+        }
     }
 
-    void clear() {
+    template <typename InputIterator>
+    void addEdges(InputIterator first, InputIterator last)
+    {
+        GraphBatch<Impl> batch(impl);
+        for (; first != last; ++first) {
+            impl.addArc(first->first.base, first->second.base);
+        }
+    }
+
+    void reserve(size_t n_nodes, size_t n_edges) {
+        impl.reserve(n_nodes, n_edges);
+    }
+    void beginBatch() {
+        impl.beginBatch();
+    }
+    void endBatch() {
+        impl.endBatch();
+    }
+
+    void removeNode(Node node) {
+        impl.removeNode(node.base);
+    }
+    void removeEdge(Edge edge) {
+        impl.removeArc(edge.base);
+    }
+
+    void hideNode(Node node) {
+        impl.hideNode(node.base);
+    }
+    void showNode(Node node) {
+        impl.showNode(node.base);
+    }
+    void hideEdge(Edge edge) {
+        impl.hideArc(edge.base);
+    }
+    void showEdge(Edge edge, Node u, Node v) {
+        impl.showArc(edge.base, u.base, v.base);
+    }
+
+    void clear() {
         impl.clear();
     }
 
+    void compact() {
+        impl.compact();
+    }
+
     void attachNodeObserver(Observer& ob) {
         impl.attachNodeObserver(ob);
     }
@@ -1015,24 +1533,552 @@ public:
 };
 
 
-/// \brief Check if the undirected graph is connected.
+/// \brief An undirected graph stored as a struct of arrays.
+/// \ingroup graph_implementations_structures
+/*!
+ *  Interchangeable with UndirectedGraph, but built on
+ *  StructOfArraysDirectedGraph.
+ */
+class StructOfArraysUndirectedGraph :
+    public
+    UndirectedGraphBase <
+    UndirectedGraphImplementation <
+    StructOfArraysDirectedGraph > >
+{
+    typedef
+    UndirectedGraphBase <
+    UndirectedGraphImplementation <
+    StructOfArraysDirectedGraph > >
+    Base;
+
+public:
+    typedef Base::Node Node;
+    typedef Base::Edge Edge;
+    typedef Base::Observer Observer;
+
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+//
+// CompactUndirectedGraph
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief A read-only undirected graph stored in compressed sparse row form.
+/// \ingroup graph_implementations_structures
+/*!
+ *  The graph is built once from an edge list and cannot be modified
+ *  afterwards. Each edge is stored in the out-list of its first endpoint and
+ *  the in-list of its second, so that iterating over the neighbors of a node
+ *  is a scan over two contiguous ranges. Neighbors are visited in the same
+ *  order as in UndirectedGraph, had the edges been added to it one by one.
+ *
+ *  Nodes are identified by their index in [0, numberOfNodes()). The number
+ *  of edges must be less than 2^32 - 1.
+ *
+ *  This is a concrete implementation of concepts::ReadableUndirectedGraph.
+ */
+class CompactUndirectedGraph
+{
+    typedef std::vector<unsigned int> Indices;
+
+    static const unsigned int INVALID = (unsigned int) -1;
+
+    unsigned int _number_of_nodes;
+    unsigned int _number_of_edges;
+
+    // counts the builds, as each one renumbers the nodes and edges
+    unsigned int _generation;
+
+    // edges sorted by their first endpoint: the ith edge is (source, _out_targets[i])
+    Indices _out_offsets;
+    Indices _out_targets;
+
+    // edges sorted by their second endpoint
+    Indices _in_offsets;
+    Indices _in_edges;
+    Indices _in_sources;
+
+public:
+
+    class Node
+    {
+        friend class CompactUndirectedGraph;
+        unsigned int index;
+        Node(unsigned int index) : index(index) {}
+
+    public:
+        Node() {}
+
+        bool operator==(const Node& node) const {
+            return index == node.index;
+        }
+
+        bool operator!=(const Node& node) const {
+            return index != node.index;
+        }
+
+        bool operator<(const Node& node) const {
+            return index < node.index;
+        }
+    };
+
+    class Edge
+    {
+        friend class CompactUndirectedGraph;
+        unsigned int index;
+
+        // the position of the edge in an in-list, if it was reached from there
+        unsigned int in_slot;
+
+        Edge(unsigned int index, unsigned int in_slot=INVALID)
+            : index(index), in_slot(in_slot) {}
+
+    public:
+        Edge() {}
+
+        bool operator==(const Edge& edge) const {
+            return index == edge.index;
+        }
+
+        bool operator!=(const Edge& edge) const {
+            return index != edge.index;
+        }
+
+        bool operator<(const Edge& edge) const {
+            return index < edge.index;
+        }
+    };
+
+    CompactUndirectedGraph()
+        : _number_of_nodes(0), _number_of_edges(0), _generation(0),
+          _out_offsets(1, 0), _in_offsets(1, 0) {}
+
+    /// \brief Build the graph from a list of edges.
+    /*!
+     *  \param  n_nodes     The number of nodes in the graph.
+     *  \param  edges       The endpoints of the edges, as consecutive pairs.
+     *  \param  n_edges     The number of edges, half the length of `edges`.
+     *  \param  edge_identifiers    If given, receives the identifier of
+     *                              each edge, in the order they were listed.
+     *
+     *  Any existing structure is discarded.
+     */
+    void build(unsigned int n_nodes, const unsigned int* edges, size_t n_edges,
+               unsigned int* edge_identifiers = 0)
+    {
+        _number_of_nodes = n_nodes;
+        _number_of_edges = n_edges;
+        ++_generation;
+
+        Indices(n_nodes + 1, 0).swap(_out_offsets);
+        Indices(n_nodes + 1, 0).swap(_in_offsets);
+        Indices(n_edges).swap(_out_targets);
+        Indices(n_edges).swap(_in_edges);
+        Indices(n_edges).swap(_in_sources);
+
+        // count the degrees, then take the prefix sums
+        for (size_t i=0; i<n_edges; ++i) {
+            if (edges[2*i] >= n_nodes || edges[2*i+1] >= n_nodes) {
+                _number_of_nodes = _number_of_edges = 0;
+                throw std::runtime_error("Edge refers to a nonexistent node.");
+            }
+            _out_offsets[edges[2*i] + 1]++;
+            _in_offsets[edges[2*i+1] + 1]++;
+        }
+
+        for (size_t i=0; i<n_nodes; ++i) {
+            _out_offsets[i+1] += _out_offsets[i];
+            _in_offsets[i+1] += _in_offsets[i];
+        }
+
+        // UndirectedGraph visits the most recently added edges first, so the
+        // lists are filled from the back. An edge is identified by its
+        // position in the out-lists.
+        Indices edge_index(n_edges);
+        Indices out_fill(_out_offsets.begin() + 1, _out_offsets.end());
+        for (size_t i=0; i<n_edges; ++i) {
+            edge_index[i] = --out_fill[edges[2*i]];
+            _out_targets[edge_index[i]] = edges[2*i+1];
+        }
+        Indices().swap(out_fill);
+
+        Indices in_fill(_in_offsets.begin() + 1, _in_offsets.end());
+        for (size_t i=0; i<n_edges; ++i) {
+            unsigned int slot = --in_fill[edges[2*i+1]];
+            _in_edges[slot] = edge_index[i];
+            _in_sources[slot] = edges[2*i];
+        }
+
+        if (edge_identifiers) {
+            std::copy(edge_index.begin(), edge_index.end(), edge_identifiers);
+        }
+    }
+
+    /// \brief Append the endpoints of every edge to `edges`, as consecutive pairs.
+    /*!
+     *  The edges are listed in order of their identifiers, so building a
+     *  graph from the list gives back the same edges, if not the same
+     *  identifiers.
+     */
+    void appendEdges(std::vector<unsigned int>& edges) const
+    {
+        edges.reserve(edges.size() + 2 * _number_of_edges);
+        for (unsigned int source=0; source<_number_of_nodes; ++source) {
+            for (unsigned int i=_out_offsets[source]; i<_out_offsets[source+1]; ++i) {
+                edges.push_back(source);
+                edges.push_back(_out_targets[i]);
+            }
+        }
+    }
+
+    bool isNodeValid(Node node) const {
+        return node.index < _number_of_nodes;
+    }
+
+    bool isEdgeValid(Edge edge) const {
+        return edge.index < _number_of_edges;
+    }
+
+    Node getFirstNode() const {
+        return Node(0);
+    }
+
+    Node getNextNode(Node node) const {
+        return Node(node.index + 1);
+    }
+
+    Edge getFirstEdge() const {
+        return Edge(0);
+    }
+
+    Edge getNextEdge(Edge edge) const {
+        return Edge(edge.index + 1);
+    }
+
+    /// \pre The node must be valid.
+    Edge getFirstNeighborEdge(Node node) const
+    {
+        unsigned int first_out = _out_offsets[node.index];
+        if (first_out != _out_offsets[node.index + 1]) {
+            return Edge(first_out);
+        }
+
+        return firstInEdge(node);
+    }
+
+    /// \pre The edge must have been reached by iterating over node's neighbors.
+    Edge getNextNeighborEdge(Node node, Edge edge) const
+    {
+        if (edge.in_slot == INVALID)
+        {
+            unsigned int next_out = edge.index + 1;
+            if (next_out != _out_offsets[node.index + 1]) {
+                return Edge(next_out);
+            }
+
+            return firstInEdge(node);
+        }
+
+        unsigned int next_in = edge.in_slot + 1;
+        if (next_in != _in_offsets[node.index + 1]) {
+            return Edge(_in_edges[next_in], next_in);
+        }
+
+        return getInvalidEdge();
+    }
+
+    Node opposite(Node node, Edge edge) const
+    {
+        if (edge.in_slot != INVALID)
+        {
+            unsigned int source = _in_sources[edge.in_slot];
+            return node.index != source ? Node(source) : Node(_out_targets[edge.index]);
+        }
+
+        unsigned int target = _out_targets[edge.index];
+        return node.index != target ? Node(target) : u(edge);
+    }
+
+    unsigned int degree(Node node) const
+    {
+        return (_out_offsets[node.index + 1] - _out_offsets[node.index]) +
+               (_in_offsets[node.index + 1] - _in_offsets[node.index]);
+    }
+
+    /// \brief Gets the first endpoint of the edge.
+    /*!
+     *  Unless the edge was reached through an in-list, this is a binary
+     *  search over the nodes.
+     */
+    Node u(Edge edge) const
+    {
+        if (edge.in_slot != INVALID) {
+            return Node(_in_sources[edge.in_slot]);
+        }
+
+        Indices::const_iterator it = std::upper_bound(
+                _out_offsets.begin(), _out_offsets.end(), edge.index);
+
+        return Node((it - _out_offsets.begin()) - 1);
+    }
+
+    Node v(Edge edge) const {
+        return Node(_out_targets[edge.index]);
+    }
+
+    unsigned int numberOfNodes() const {
+        return _number_of_nodes;
+    }
+
+    unsigned int numberOfEdges() const {
+        return _number_of_edges;
+    }
+
+    unsigned int getMaxNodeIdentifier() const {
+        return _number_of_nodes;
+    }
+
+    unsigned int getNodeIdentifier(Node node) const {
+        return node.index;
+    }
+
+    Node getNodeFromIdentifier(unsigned int identifier) const {
+        return Node(identifier);
+    }
+
+    unsigned int getMaxEdgeIdentifier() const {
+        return _number_of_edges;
+    }
+
+    /// \brief The number of times the graph has been built.
+    unsigned int getGeneration() const {
+        return _generation;
+    }
+
+    unsigned int getEdgeIdentifier(Edge edge) const {
+        return edge.index;
+    }
+
+    Edge getEdgeFromIdentifier(unsigned int identifier) const {
+        return Edge(identifier);
+    }
+
+    Edge findEdge(Node u, Node v) const
+    {
+        for (unsigned int i=_out_offsets[u.index]; i<_out_offsets[u.index+1]; ++i) {
+            if (_out_targets[i] == v.index) {
+                return Edge(i);
+            }
+        }
+
+        for (unsigned int i=_out_offsets[v.index]; i<_out_offsets[v.index+1]; ++i) {
+            if (_out_targets[i] == u.index) {
+                return Edge(i);
+            }
+        }
+
+        return getInvalidEdge();
+    }
+
+    Node getInvalidNode() const {
+        return Node(INVALID);
+    }
+
+    Edge getInvalidEdge() const {
+        return Edge(INVALID);
+    }
+
+private:
+
+    Edge firstInEdge(Node node) const
+    {
+        unsigned int first_in = _in_offsets[node.index];
+        if (first_in != _in_offsets[node.index + 1]) {
+            return Edge(_in_edges[first_in], first_in);
+        }
+
+        return getInvalidEdge();
+    }
+
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Connected components
+//
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+/// \brief Find the root of x's set, halving the path along the way.
+inline unsigned int findComponentRoot(std::vector<unsigned int>& parent, unsigned int x)
+{
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+/// \brief Merge the sets of x and y. The smaller root becomes the new root.
+inline void uniteComponents(std::vector<unsigned int>& parent, unsigned int x, unsigned int y)
+{
+    x = findComponentRoot(parent, x);
+    y = findComponentRoot(parent, y);
+
+    if (x == y) {
+        return;
+    }
+
+    if (x < y) {
+        std::swap(x, y);
+    }
+
+    parent[x] = y;
+}
+
+/// \brief Merges the edges among a range of node identifiers.
+/*!
+ *  Only the forest entries inside the range are read or written, so workers
+ *  with disjoint ranges can run at once. Edges leaving the range are saved,
+ *  to be merged once every worker is done.
+ */
 template <typename UndirectedGraph>
-bool isConnected(const UndirectedGraph& graph)
+class ComponentWorker
+{
+    typedef typename UndirectedGraph::Node Node;
+    typedef std::vector<std::pair<unsigned int, unsigned int> > Pairs;
+
+    const UndirectedGraph& _graph;
+    std::vector<unsigned int>& _parent;
+    unsigned int _first;
+    unsigned int _last;
+    Pairs& _crossing;
+
+public:
+
+    ComponentWorker(
+            const UndirectedGraph& graph,
+            std::vector<unsigned int>& parent,
+            unsigned int first,
+            unsigned int last,
+            Pairs& crossing)
+        : _graph(graph), _parent(parent), _first(first), _last(last),
+          _crossing(crossing) {}
+
+    void operator()()
+    {
+        for (unsigned int id=_first; id<_last; ++id)
+        {
+            Node node = _graph.getNodeFromIdentifier(id);
+            if (!_graph.isNodeValid(node)) {
+                continue;
+            }
+
+            // each edge is handled from the end with the smaller identifier
+            for (UndirectedNeighborIterator<UndirectedGraph> it(_graph, node);
+                    !it.done(); ++it)
+            {
+                unsigned int neighbor = _graph.getNodeIdentifier(it.neighbor());
+                if (neighbor <= id) {
+                    continue;
+                }
+
+                if (neighbor < _last) {
+                    uniteComponents(_parent, id, neighbor);
+                } else {
+                    _crossing.push_back(std::make_pair(id, neighbor));
+                }
+            }
+        }
+    }
+};
+
+}
+
+
+/// \brief Label the connected components of an undirected graph.
+/*!
+ *  \param  graph       The graph.
+ *  \param  labels      Receives the component of each node, indexed by node
+ *                      identifier. Identifiers not in use are labelled -1.
+ *  \param  n_threads   The number of threads to use.
+ *
+ *  \returns The number of components.
+ *
+ *  The components are numbered from zero in order of their smallest node
+ *  identifier. The edges are merged in a disjoint set forest. With more than
+ *  one thread, the identifiers are split into one range per thread, and the
+ *  edges within each range are merged in parallel; the few edges between
+ *  ranges are merged afterwards.
+ */
+template <typename UndirectedGraph>
+unsigned int labelConnectedComponents(
+        const UndirectedGraph& graph,
+        std::vector<unsigned int>& labels,
+        unsigned int n_threads = 1)
 {
-    if (graph.numberOfNodes() == 0)
-        return true;
+    typedef std::vector<std::pair<unsigned int, unsigned int> > Pairs;
 
-    // the node count is 1, because the source node isn't visited by the loop
-    unsigned int node_count = 1;
+    unsigned int n = graph.getMaxNodeIdentifier();
+    if (n_threads < 1) {
+        n_threads = 1;
+    }
 
-    typename UndirectedGraph::Node source_node = graph.getFirstNode();
-    for (UndirectedBFSIterator<UndirectedGraph> it(graph, source_node); 
-            !it.done(); ++it)
+    std::vector<unsigned int> parent(n);
+    for (unsigned int i=0; i<n; ++i) {
+        parent[i] = i;
+    }
+
+    std::vector<Pairs> crossing(n_threads);
+    if (n_threads == 1) {
+        detail::ComponentWorker<UndirectedGraph>(graph, parent, 0, n, crossing[0])();
+    } else {
+        boost::thread_group workers;
+        for (unsigned int i=0; i<n_threads; ++i) {
+            workers.create_thread(detail::ComponentWorker<UndirectedGraph>(
+                    graph, parent,
+                    (size_t) i * n / n_threads,
+                    (size_t) (i+1) * n / n_threads,
+                    crossing[i]));
+        }
+        workers.join_all();
+    }
+
+    for (size_t i=0; i<crossing.size(); ++i) {
+        for (size_t j=0; j<crossing[i].size(); ++j) {
+            detail::uniteComponents(parent, crossing[i][j].first, crossing[i][j].second);
+        }
+        Pairs().swap(crossing[i]);
+    }
+
+    // a root is the smallest identifier in its set, so it is labelled
+    // before any other member of the set
+    labels.assign(n, (unsigned int) -1);
+    unsigned int n_components = 0;
+    for (unsigned int i=0; i<n; ++i)
     {
-       node_count++; 
+        if (!graph.isNodeValid(graph.getNodeFromIdentifier(i))) {
+            continue;
+        }
+
+        unsigned int root = detail::findComponentRoot(parent, i);
+        labels[i] = (root == i) ? n_components++ : labels[root];
     }
 
-    return node_count == graph.numberOfNodes();
+    return n_components;
+}
+
+
+/// \brief Check if the undirected graph is connected.
+template <typename UndirectedGraph>
+bool isConnected(const UndirectedGraph& graph)
+{
+    std::vector<unsigned int> labels;
+    return labelConnectedComponents(graph, labels) <= 1;
 }
 
 }
@@ -0,0 +1,307 @@
+// Copyright (c) 2014, Justin Eldridge, Mikhail Belkin, and Yusu Wang
+// at The Ohio State University. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef DENALI_LAZY_MEMBERS_H
+#define DENALI_LAZY_MEMBERS_H
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <denali/contour_tree.h>
+#include <denali/graph_iterators.h>
+#include <denali/graph_structures.h>
+
+namespace denali {
+
+////////////////////////////////////////////////////////////////////////////
+//
+// LazyMemberList
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief Somewhere members can be read from on demand, such as a file.
+/*!
+ *  Each LazyMemberList read from the source remembers an offset, and asks
+ *  the source for its members the first time they are needed. Reads are
+ *  serialized by the source's mutex, so lists may be loaded from several
+ *  threads at once.
+ */
+template <typename Member>
+class MemberSource
+{
+    mutable boost::mutex _mutex;
+
+public:
+    virtual ~MemberSource() {}
+
+    /// \brief Append the members stored at `offset` to `members`.
+    /*!
+     *  Called with the mutex held.
+     */
+    virtual void readMembers(size_t offset, std::vector<Member>& members) const = 0;
+
+    boost::mutex& getMutex() const
+    {
+        return _mutex;
+    }
+};
+
+
+/// \brief A list of members which may not have been read yet.
+/// \ingroup contour_tree
+/*!
+ *  Takes the place of a std::vector of members in a member ID graph. A
+ *  list made from a MemberSource knows how many members it holds, so
+ *  size() is answered immediately, but the members themselves are only
+ *  read when the list is first iterated over. Lists built by push_back()
+ *  behave like a std::vector.
+ */
+template <typename Member>
+class LazyMemberList
+{
+    typedef MemberSource<Member> Source;
+
+    mutable std::vector<Member> _members;
+    size_t _size;
+
+    // where the members are read from, if they haven't been yet
+    boost::shared_ptr<const Source> _source;
+    size_t _offset;
+
+    // cleared, after the members are read, while holding the source's
+    // mutex. Once it is clear, the members are read without locking
+    mutable boost::atomic<bool> _pending;
+
+    void load() const
+    {
+        if (!_pending.load(boost::memory_order_acquire)) {
+            return;
+        }
+
+        boost::mutex::scoped_lock lock(_source->getMutex());
+        if (_pending.load(boost::memory_order_relaxed)) {
+            // read into a local list, so that a failed read leaves the
+            // list pending and empty, to be read afresh next time
+            std::vector<Member> members;
+            members.reserve(_size);
+            _source->readMembers(_offset, members);
+            _members.swap(members);
+            _pending.store(false, boost::memory_order_release);
+        }
+    }
+
+public:
+
+    typedef Member value_type;
+    typedef typename std::vector<Member>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    LazyMemberList()
+        : _size(0), _offset(0), _pending(false) {}
+
+    /// \brief A list of `size` members, to be read from the source at `offset`.
+    LazyMemberList(
+            boost::shared_ptr<const Source> source,
+            size_t offset,
+            size_t size)
+        : _size(size), _source(source), _offset(offset), _pending(true) {}
+
+    /// \brief Copy a list, without reading its members.
+    /*!
+     *  If the other list is still pending, it may be loaded by another
+     *  thread as it is copied, so its members are copied under the
+     *  source's mutex.
+     */
+    LazyMemberList(const LazyMemberList& other)
+        : _size(other._size), _source(other._source), _offset(other._offset),
+          _pending(false)
+    {
+        if (other._pending.load(boost::memory_order_acquire))
+        {
+            boost::mutex::scoped_lock lock(other._source->getMutex());
+            _members = other._members;
+            _pending.store(other._pending.load(boost::memory_order_relaxed));
+        }
+        else
+        {
+            _members = other._members;
+        }
+    }
+
+    LazyMemberList& operator=(const LazyMemberList& other)
+    {
+        LazyMemberList(other).swap(*this);
+        return *this;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    /// \brief Whether the members are still to be read from the source.
+    bool isPending() const {
+        return _pending.load(boost::memory_order_acquire);
+    }
+
+    /// \brief Reads the members, if needed, and returns the first.
+    /*!
+     *  \throws std::runtime_error if the source can't be read.
+     */
+    const_iterator begin() const {
+        load();
+        return _members.begin();
+    }
+
+    const_iterator end() const {
+        load();
+        return _members.end();
+    }
+
+    void reserve(size_t n) {
+        _members.reserve(n);
+    }
+
+    void clear()
+    {
+        _members.clear();
+        _size = 0;
+        _source.reset();
+        _pending.store(false);
+    }
+
+    void push_back(const Member& member)
+    {
+        load();
+        _members.push_back(member);
+        _size++;
+    }
+
+    /// \brief Append the members in [first, last).
+    template <typename InputIterator>
+    void insert(const_iterator, InputIterator first, InputIterator last)
+    {
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+
+    void swap(LazyMemberList& other)
+    {
+        _members.swap(other._members);
+        std::swap(_size, other._size);
+        _source.swap(other._source);
+        std::swap(_offset, other._offset);
+        bool pending = _pending.load();
+        _pending.store(other._pending.load());
+        other._pending.store(pending);
+    }
+};
+
+
+/// \brief Member storage policy keeping members in LazyMemberLists.
+/// \ingroup contour_tree
+/*!
+ *  See VectorMemberStorage.
+ */
+struct LazyMemberStorage
+{
+    template <typename Member>
+    struct List { typedef LazyMemberList<Member> Type; };
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+//
+// LazyContourTree
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief A contour tree whose edge members are read on demand.
+/// \ingroup contour_tree
+/*!
+ *  Conforms to concepts::ContourTree. The nodes, the edges, and the
+ *  number of members on each edge are available as soon as the tree is
+ *  loaded, which is enough to build a landscape weighted by member counts.
+ *  The members of an edge are read the first time getEdgeMembers() is
+ *  iterated over, or all at once by loadMembers().
+ *
+ *  See readLazyContourTreeFile().
+ */
+class LazyContourTree :
+    public
+    ContourTreeBase <UndirectedScalarMemberIDGraphBase <UndirectedGraph,
+                                                       LazyMemberStorage> >
+{
+public:
+    typedef
+    UndirectedScalarMemberIDGraphBase <UndirectedGraph, LazyMemberStorage>
+    Graph;
+
+private:
+    typedef ContourTreeBase<Graph> Base;
+
+    LazyContourTree(boost::shared_ptr<Graph> graph)
+        : Base(graph) {}
+
+public:
+
+    /// \brief Load a contour tree from a graph. See ContourTree::fromPrecomputed().
+    static LazyContourTree
+    fromPrecomputed(boost::shared_ptr<Graph>& graph)
+    {
+        boost::shared_ptr<Graph> old_graph = graph;
+        graph = boost::shared_ptr<Graph>(new Graph);
+
+        if (old_graph->numberOfNodes() != old_graph->numberOfEdges() + 1)
+        {
+            throw std::runtime_error("The precomputed graph does not "
+                "appear to be a tree.");
+        }
+
+        return LazyContourTree(old_graph);
+    }
+
+    /// \brief Read the members of every edge which hasn't been read yet.
+    /*!
+     *  May be run in the background while the tree is being used.
+     */
+    void loadMembers() const
+    {
+        for (EdgeIterator<LazyContourTree> it(*this); !it.done(); ++it) {
+            this->getEdgeMembers(it.edge()).begin();
+        }
+    }
+};
+
+
+} // namespace denali
+
+#endif
@@ -50,12 +50,15 @@ class MappableListBase
     int _first_element;
     int _first_free_element;
 
+    unsigned int _generation;
+
 public:
 
     typedef Value ValueType;
 
     MappableListBase() :
-            _size(0), _first_element(-1), _first_free_element(-1)
+            _size(0), _first_element(-1), _first_free_element(-1),
+            _generation(0)
     {}
 
     ValueType& operator[](int n) { 
@@ -125,7 +128,7 @@ public:
     }
 
     bool isValid(int n) const {
-        return n >= 0 && n < _elements.size() && _elements[n].valid;
+        return n >= 0 && (size_t) n < _elements.size() && _elements[n].valid;
     }
 
     int getFirst() const {
@@ -139,6 +142,39 @@ public:
     int getMaxIdentifier() const {
         return _elements.size();
     }
+
+    /// \brief The number of times the list has been compacted.
+    unsigned int getGeneration() const {
+        return _generation;
+    }
+
+    /// \brief Renumber the elements densely, in iteration order.
+    /*!
+     *  Releases the slots of removed elements. Returns the new identifier
+     *  of each old identifier, or -1 for those that had been removed.
+     */
+    std::vector<int> compact()
+    {
+        std::vector<int> new_identifiers(_elements.size(), -1);
+        std::vector<ElementRep> elements;
+        elements.reserve(_size);
+
+        for (int n = _first_element; n != -1; n = _elements[n].next_element) {
+            int m = elements.size();
+            new_identifiers[n] = m;
+
+            elements.push_back(_elements[n]);
+            elements[m].prev_element = m - 1;
+            elements[m].next_element = m + 1 < (int) _size ? m + 1 : -1;
+        }
+
+        _elements.swap(elements);
+        _first_element = _size > 0 ? 0 : -1;
+        _first_free_element = -1;
+        ++_generation;
+
+        return new_identifiers;
+    }
 };
 
 
@@ -188,6 +224,16 @@ public:
     {
     public:
         virtual void notify() const = 0;
+
+        /// \brief Called after the list has been compacted.
+        /*!
+         *  `new_identifiers[i]` is the new identifier of the element whose
+         *  identifier was `i`, or -1 if it had been removed.
+         */
+        virtual void remap(const std::vector<int>& /* new_identifiers */) const {
+            notify();
+        }
+
         ~Observer() {}
     };
 
@@ -202,6 +248,16 @@ public:
         notify();
     }
 
+    std::vector<int> compact() {
+        std::vector<int> new_identifiers = Super::compact();
+        for (typename Observers::const_iterator it = _observers.begin();
+                it != _observers.end(); ++it)
+        {
+            (*it)->remap(new_identifiers);
+        }
+        return new_identifiers;
+    }
+
     void attachObserver(Observer& observer) {
         _observers.push_back(&observer);
     }
@@ -29,8 +29,10 @@
 #include <denali/graph_iterators.h>
 #include <denali/folded.h>
 
+#include <algorithm>
 #include <cmath>
 #include <boost/shared_ptr.hpp>
+#include <limits>
 #include <queue>
 #include <stdexcept>
 #include <vector>
@@ -72,20 +74,33 @@ struct NullProtector
 };
 
 
+/// \brief Told of each collapse and reduction a simplification makes.
+/*!
+ *  Both are called before the change is made. See PersistenceHierarchy.
+ */
+template <typename Context>
+struct NullSimplificationObserver
+{
+    void collapsing(const Context&, typename Context::Edge, double) {}
+    void reducing(const Context&, typename Context::Node) {}
+};
+
+
 class PersistenceSimplifier
 {
     double _threshold;
 
+    /// \brief A leaf in the queue, pruned in order of persistence, then of ID.
     template <typename Node>
-    class PersistencePriority : public Priority
+    class PersistencePriority
     {
         double _persistence;
+        unsigned int _id;
         Node _leaf;
 
     public:
-        PersistencePriority(Node leaf, double persistence)
-            : Priority(1/(persistence+1)), _persistence(persistence),
-              _leaf(leaf) {}
+        PersistencePriority(Node leaf, unsigned int id, double persistence)
+            : _persistence(persistence), _id(id), _leaf(leaf) {}
 
         double persistence() const {
             return _persistence;
@@ -94,16 +109,34 @@ class PersistenceSimplifier
         Node leaf() const {
             return _leaf;
         }
+
+        /// \brief True if the other leaf is to be pruned before this one.
+        bool operator<(const PersistencePriority& other) const {
+            return other._persistence < _persistence ||
+                   (other._persistence == _persistence && other._id < _id);
+        }
     };
 
+    template <typename Context>
+    static void pushLeaf(
+            std::priority_queue<PersistencePriority<typename Context::Node> >& queue,
+            const Context& context,
+            typename Context::Node leaf,
+            double persistence)
+    {
+        queue.push(PersistencePriority<typename Context::Node>(
+                leaf, context.getID(leaf), persistence));
+    }
+
     template <typename Tree>
     static typename Tree::Node getLeaf(const Tree& tree, typename Tree::Edge edge) {
         return tree.degree(tree.u(edge)) == 1 ? tree.u(edge) : tree.v(edge);
     }
 
     /// \brief Simplifies the contour tree in the context.
-    template <typename Context, typename ProtectedNodes>
-    void simplifyCore(Context& context, const ProtectedNodes& protected_nodes)
+    template <typename Context, typename ProtectedNodes, typename Observer>
+    void simplifyCore(Context& context, const ProtectedNodes& protected_nodes,
+                      Observer& observer)
     {
         typedef PersistencePriority<typename Context::Node> Priority;
         typedef typename Context::Node Node;
@@ -122,6 +155,7 @@ class PersistenceSimplifier
         for (typename std::vector<Node>::iterator it = reduce_vector.begin(); 
                 it != reduce_vector.end(); ++it)
         {
+            observer.reducing(context, *it);
             context.reduce(*it);
         }
 
@@ -145,7 +179,7 @@ class PersistenceSimplifier
                 double persistence = computePersistence(context, it.edge());
 
                 // enqueue
-                simplify_queue.push(Priority(leaf, persistence));
+                pushLeaf(simplify_queue, context, leaf, persistence);
             }
         }
 
@@ -156,6 +190,11 @@ class PersistenceSimplifier
             double persistence  = simplify_queue.top().persistence();
             simplify_queue.pop();
 
+            // everything left in the queue is at least as persistent
+            if (persistence > _threshold) {
+                break;
+            }
+
             // make sure the leaf is valid
             if (!context.isNodeValid(leaf)) {
                 continue;
@@ -166,24 +205,28 @@ class PersistenceSimplifier
             Edge edge = neighbor_it.edge();
             Node parent = context.opposite(leaf, edge);
 
-            if (protected_nodes[parent] || protected_nodes[leaf]) {
+            // if the parent has been reduced since the leaf was queued, the
+            // leaf was queued again with the persistence of its new edge
+            if (computePersistence(context, edge) != persistence) {
                 continue;
             }
 
-            if (preserveForReduction(context, edge)) {
+            if (protected_nodes[parent] || protected_nodes[leaf]) {
                 continue;
             }
 
-            if (persistence > _threshold) {
-                break;
+            if (preserveForReduction(context, edge)) {
+                continue;
             }
 
             // collapse the edge
+            observer.collapsing(context, edge, persistence);
             context.collapse(edge);
 
             // if the parent is reducible, reduce it now
             if (isRegular(context, parent)) 
             {
+                observer.reducing(context, parent);
                 Edge edge = context.reduce(parent);
 
                 // add the leaf nodes of the parent to the queue, as they
@@ -193,7 +236,7 @@ class PersistenceSimplifier
 
                 if (context.degree(u) == 1) {
                     double persistence = computePersistence(context, edge);
-                    simplify_queue.push(Priority(u, persistence));
+                    pushLeaf(simplify_queue, context, u, persistence);
                 } else {
                     // add u's leaf neighbors
                     for (UndirectedNeighborIterator<Context> neighbor_it(context, u);
@@ -202,14 +245,14 @@ class PersistenceSimplifier
                         if (context.degree(neighbor_it.neighbor()) == 1)
                         {
                             double persistence = computePersistence(context, neighbor_it.edge());
-                            simplify_queue.push(Priority(neighbor_it.neighbor(), persistence));
+                            pushLeaf(simplify_queue, context, neighbor_it.neighbor(), persistence);
                         }
                     }
                 }
 
                 if (context.degree(v) == 1) {
                     double persistence = computePersistence(context, edge);
-                    simplify_queue.push(Priority(v, persistence));
+                    pushLeaf(simplify_queue, context, v, persistence);
                 } else {
                     // add v's leaf neighbors
                     for (UndirectedNeighborIterator<Context> neighbor_it(context, v);
@@ -218,7 +261,7 @@ class PersistenceSimplifier
                         if (context.degree(neighbor_it.neighbor()) == 1)
                         {
                             double persistence = computePersistence(context, neighbor_it.edge());
-                            simplify_queue.push(Priority(neighbor_it.neighbor(), persistence));
+                            pushLeaf(simplify_queue, context, neighbor_it.neighbor(), persistence);
                         }
                     }
                 }
@@ -232,7 +275,7 @@ class PersistenceSimplifier
                 double persistence = computePersistence(context, neighbor_it.edge());
 
                 // add to the queue
-                simplify_queue.push(Priority(parent, persistence));
+                pushLeaf(simplify_queue, context, parent, persistence);
             }
 
         }
@@ -347,10 +390,18 @@ public:
     /// \brief Simplifies the contour tree in the context.
     template <typename Context>
     void simplify(Context& context)
+    {
+        NullSimplificationObserver<Context> observer;
+        simplify(context, observer);
+    }
+
+    /// \brief Simplifies the contour tree, telling the observer of each change.
+    template <typename Context, typename Observer>
+    void simplify(Context& context, Observer& observer)
     {
         // no nodes are going to be protected
         NullProtector<Context> null_protected;
-        simplifyCore(context, null_protected);
+        simplifyCore(context, null_protected, observer);
     }
 
     /// \brief Simplifies a subtree.
@@ -363,6 +414,17 @@ public:
     void simplifySubtree(Context& context, 
                          typename Context::Node parent,
                          typename Context::Node pivot)
+    {
+        NullSimplificationObserver<Context> observer;
+        simplifySubtree(context, parent, pivot, observer);
+    }
+
+    /// \brief Simplifies a subtree, telling the observer of each change.
+    template <typename Context, typename Observer>
+    void simplifySubtree(Context& context, 
+                         typename Context::Node parent,
+                         typename Context::Node pivot,
+                         Observer& observer)
     {
         // we create a new node map that defaults to false
         StaticNodeMap<Context, bool> protected_nodes(context);
@@ -385,7 +447,7 @@ public:
         protected_nodes[pivot] = false;
 
         // perform the simplification
-        simplifyCore(context, protected_nodes);
+        simplifyCore(context, protected_nodes, observer);
 
     }
 
@@ -410,6 +472,241 @@ double computeMaxPersistence(const Tree& tree)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Persistence Hierarchy
+//
+////////////////////////////////////////////////////////////////////////////////
+
+/// \brief A persistence simplification which can be replayed to any threshold.
+/*!
+ *  compute() simplifies a folded contour tree as far as it will go,
+ *  recording each collapse and reduction together with the smallest
+ *  threshold at which a PersistenceSimplifier would make it: the largest
+ *  persistence collapsed up to that point. These thresholds never
+ *  decrease, so simplifying the original tree to a threshold makes exactly
+ *  the steps whose threshold is no larger -- a prefix of the record.
+ *
+ *  simplify() then moves the tree from one prefix to another, making or
+ *  undoing only the steps in between. Steps are recorded by node ID, so
+ *  the tree's handles may change from call to call, but the tree must not
+ *  be folded or unfolded by anything else while the hierarchy is in use.
+ */
+class PersistenceHierarchy
+{
+    struct Step
+    {
+        // the collapsed leaf, or the reduced node
+        unsigned int node;
+
+        // the node the leaf was collapsed into, or the reduced node's 
+        // neighbors
+        unsigned int u;
+        unsigned int w;
+
+        bool is_collapse;
+        double threshold;
+
+        // the members collapsed into nodes by this step and those before it
+        size_t collapsed_members;
+    };
+
+    struct StepThresholdLess
+    {
+        bool operator()(double threshold, const Step& step) const {
+            return threshold < step.threshold;
+        }
+    };
+
+    std::vector<Step> _steps;
+    size_t _n_applied;
+    size_t _n_nodes;
+
+    template <typename Context>
+    class Recorder
+    {
+        typedef typename Context::Node Node;
+        typedef typename Context::Edge Edge;
+
+        std::vector<Step>& _steps;
+        double _threshold;
+        size_t _collapsed_members;
+
+    public:
+        Recorder(std::vector<Step>& steps)
+            : _steps(steps), _threshold(0), _collapsed_members(0) {}
+
+        void collapsing(const Context& context, Edge edge, double persistence)
+        {
+            // the base is chosen the same way FoldedContourTree::collapse does
+            Node u = context.u(edge);
+            Node v = context.v(edge);
+            Node base = context.degree(u) == 1 ? v : u;
+            Node leaf = context.opposite(base, edge);
+
+            _threshold = std::max(_threshold, persistence);
+            _collapsed_members += context.getNodeMembers(leaf).size() +
+                                  context.getEdgeMembers(edge).size();
+
+            Step step;
+            step.node = context.getID(leaf);
+            step.u = context.getID(base);
+            step.w = step.u;
+            step.is_collapse = true;
+            step.threshold = _threshold;
+            step.collapsed_members = _collapsed_members;
+            _steps.push_back(step);
+        }
+
+        void reducing(const Context& context, Node node)
+        {
+            UndirectedNeighborIterator<Context> it(context, node);
+            Node u = it.neighbor(); ++it;
+            Node w = it.neighbor();
+
+            Step step;
+            step.node = context.getID(node);
+            step.u = context.getID(u);
+            step.w = context.getID(w);
+            step.is_collapse = false;
+            step.threshold = _threshold;
+            step.collapsed_members = _collapsed_members;
+            _steps.push_back(step);
+        }
+    };
+
+    template <typename Context>
+    static void apply(Context& context, const Step& step)
+    {
+        if (step.is_collapse) {
+            context.collapse(context.findEdge(
+                    context.getNode(step.node), context.getNode(step.u)));
+        } else {
+            context.reduce(context.getNode(step.node));
+        }
+    }
+
+    template <typename Context>
+    static void undo(Context& context, const Step& step)
+    {
+        if (step.is_collapse) {
+            // steps are undone in reverse, so the leaf was the last thing 
+            // collapsed into the base
+            context.uncollapse(context.getNode(step.u));
+        } else {
+            context.unreduce(context.findEdge(
+                    context.getNode(step.u), context.getNode(step.w)));
+        }
+    }
+
+public:
+    PersistenceHierarchy() : _n_applied(0), _n_nodes(0) {}
+
+    /// \brief Simplifies the tree completely, recording each step.
+    /*!
+     *  The tree is left fully simplified.
+     */
+    template <typename Context>
+    void compute(Context& context)
+    {
+        _steps.clear();
+        _n_nodes = context.numberOfNodes();
+
+        Recorder<Context> recorder(_steps);
+        PersistenceSimplifier simplifier(std::numeric_limits<double>::infinity());
+        simplifier.simplify(context, recorder);
+
+        _n_applied = _steps.size();
+    }
+
+    /// \brief Simplifies a subtree completely, recording each step.
+    /*!
+     *  See PersistenceSimplifier::simplifySubtree(). The tree is left fully
+     *  simplified.
+     */
+    template <typename Context>
+    void computeSubtree(Context& context,
+                        typename Context::Node parent,
+                        typename Context::Node pivot)
+    {
+        _steps.clear();
+        _n_nodes = context.numberOfNodes();
+
+        Recorder<Context> recorder(_steps);
+        PersistenceSimplifier simplifier(std::numeric_limits<double>::infinity());
+        simplifier.simplifySubtree(context, parent, pivot, recorder);
+
+        _n_applied = _steps.size();
+    }
+
+    /// \brief Simplifies the tree to the threshold.
+    /*!
+     *  The tree must be as compute() or the last call to simplify() left
+     *  it. Only the steps between the two thresholds are made or undone.
+     *
+     *  \returns The number of steps made or undone.
+     */
+    template <typename Context>
+    size_t simplify(Context& context, double threshold)
+    {
+        size_t target = numberOfStepsAt(threshold);
+        size_t n_changed = 0;
+
+        for (; _n_applied < target; ++_n_applied, ++n_changed) {
+            apply(context, _steps[_n_applied]);
+        }
+
+        for (; _n_applied > target; --_n_applied, ++n_changed) {
+            undo(context, _steps[_n_applied-1]);
+        }
+
+        return n_changed;
+    }
+
+    /// \brief The number of collapses and reductions recorded.
+    size_t numberOfSteps() const {
+        return _steps.size();
+    }
+
+    /// \brief The number of steps currently made to the tree.
+    size_t numberOfAppliedSteps() const {
+        return _n_applied;
+    }
+
+    /// \brief The smallest threshold at which the ith step is made.
+    double getStepThreshold(size_t i) const {
+        return _steps[i].threshold;
+    }
+
+    /// \brief The number of steps made when simplifying to the threshold.
+    size_t numberOfStepsAt(double threshold) const
+    {
+        if (threshold < 0) {
+            throw std::runtime_error("Threshold must be nonnegative.");
+        }
+
+        return std::upper_bound(_steps.begin(), _steps.end(), threshold,
+                                StepThresholdLess()) - _steps.begin();
+    }
+
+    /// \brief The number of nodes left after simplifying to the threshold.
+    /*!
+     *  Each step removes a single node.
+     */
+    size_t numberOfNodesAt(double threshold) const {
+        return _n_nodes - numberOfStepsAt(threshold);
+    }
+
+    /// \brief The number of members collapsed into nodes after simplifying
+    /// to the threshold.
+    size_t numberOfCollapsedMembersAt(double threshold) const
+    {
+        size_t n = numberOfStepsAt(threshold);
+        return n == 0 ? 0 : _steps[n-1].collapsed_members;
+    }
+};
+
+
 } // namespace denali
 
 #endif
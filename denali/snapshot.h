@@ -0,0 +1,512 @@
+// Copyright (c) 2014, Justin Eldridge, Mikhail Belkin, and Yusu Wang
+// at The Ohio State University. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef DENALI_SNAPSHOT_H
+#define DENALI_SNAPSHOT_H
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <denali/contour_tree.h>
+#include <denali/graph_iterators.h>
+#include <denali/graph_mixins.h>
+#include <denali/graph_structures.h>
+
+namespace denali {
+
+////////////////////////////////////////////////////////////////////////////
+//
+// ContourTreeSnapshot
+//
+////////////////////////////////////////////////////////////////////////////
+
+/// \brief An immutable, flattened copy of a contour tree.
+/// \ingroup contour_tree
+/*!
+ *  The nodes and edges are stored in a CompactUndirectedGraph, and the
+ *  values, IDs and members in contiguous arrays indexed by node and edge
+ *  identifiers. Nothing is modified after construction, not even a cache,
+ *  so any number of threads may query the same snapshot without locking.
+ *  Copies share the underlying arrays.
+ *
+ *  A snapshot is made from a contour tree with fromContourTree(), read
+ *  from a file with readContourTreeSnapshotFile(), or assembled with a
+ *  ContourTreeSnapshot::Builder.
+ */
+class ContourTreeSnapshot :
+    public
+    ReadableUndirectedGraphMixin <CompactUndirectedGraph,
+    BaseGraphMixin <CompactUndirectedGraph> >
+{
+    typedef
+    ReadableUndirectedGraphMixin <CompactUndirectedGraph,
+                                 BaseGraphMixin <CompactUndirectedGraph> >
+                                 Mixin;
+
+public:
+
+    typedef CompactUndirectedGraph::Node Node;
+    typedef CompactUndirectedGraph::Edge Edge;
+    typedef UndirectedScalarMemberIDGraph::Member Member;
+
+    /// \brief A contiguous range of members.
+    class Members
+    {
+        const Member* _begin;
+        const Member* _end;
+
+    public:
+        typedef Member MemberType;
+        typedef const Member* iterator;
+        typedef const Member* const_iterator;
+
+        Members(const Member* begin, const Member* end)
+            : _begin(begin), _end(end) {}
+
+        const_iterator begin() const {
+            return _begin;
+        }
+
+        const_iterator end() const {
+            return _end;
+        }
+
+        size_t size() const {
+            return _end - _begin;
+        }
+
+        bool empty() const {
+            return _begin == _end;
+        }
+
+        const Member& operator[](size_t i) const {
+            return _begin[i];
+        }
+    };
+
+    class Builder;
+
+private:
+
+    // a node's ID along with its index, ordered by ID
+    typedef std::pair<unsigned int, unsigned int> IDIndex;
+
+    struct Arrays
+    {
+        CompactUndirectedGraph graph;
+
+        std::vector<unsigned int> ids;
+        std::vector<double> values;
+        std::vector<IDIndex> id_to_node;
+
+        // the members of node i are members[node_offsets[i]] up to
+        // members[node_offsets[i+1]], and likewise for the edges
+        std::vector<Member> members;
+        std::vector<size_t> node_offsets;
+        std::vector<size_t> edge_offsets;
+    };
+
+    boost::shared_ptr<const Arrays> _arrays;
+
+    ContourTreeSnapshot(boost::shared_ptr<const Arrays> arrays)
+        : Mixin(arrays->graph), _arrays(arrays) {}
+
+    const Member* membersAt(size_t offset) const {
+        return _arrays->members.empty() ? 0 : &_arrays->members[0] + offset;
+    }
+
+public:
+
+    /// \brief Flatten a contour tree into a snapshot.
+    /*!
+     *  The tree may be anything conforming to concepts::ContourTree. It is
+     *  only read while the snapshot is being built.
+     */
+    template <typename ContourTree>
+    static ContourTreeSnapshot fromContourTree(const ContourTree& tree);
+
+    /// \brief Get a node's scalar value
+    double getValue(Node node) const
+    {
+        return _arrays->values[getNodeIdentifier(node)];
+    }
+
+    /// \brief Get a node's ID
+    unsigned int getID(Node node) const
+    {
+        return _arrays->ids[getNodeIdentifier(node)];
+    }
+
+    /// \brief Retrieve the members of the node
+    Members getNodeMembers(Node node) const
+    {
+        unsigned int i = getNodeIdentifier(node);
+        return Members(membersAt(_arrays->node_offsets[i]),
+                       membersAt(_arrays->node_offsets[i+1]));
+    }
+
+    /// \brief Retrieve a node by its ID.
+    /*!
+     *  \returns The node, or an invalid node if no node has the ID.
+     */
+    Node getNode(unsigned int id) const
+    {
+        const std::vector<IDIndex>& index = _arrays->id_to_node;
+        std::vector<IDIndex>::const_iterator it = std::lower_bound(
+                index.begin(), index.end(), IDIndex(id, 0));
+
+        if (it == index.end() || it->first != id) {
+            return getInvalidNode();
+        }
+
+        return getNodeFromIdentifier(it->second);
+    }
+
+    /// \brief Retrieve the members of the edge.
+    Members getEdgeMembers(Edge edge) const
+    {
+        unsigned int i = getEdgeIdentifier(edge);
+        return Members(membersAt(_arrays->edge_offsets[i]),
+                       membersAt(_arrays->edge_offsets[i+1]));
+    }
+
+    size_t numberNodesPlusMembers() const {
+        return _arrays->members.size();
+    }
+
+    /// \brief The persistence of an edge: the difference of its endpoints' values.
+    double getPersistence(Edge edge) const
+    {
+        return std::abs(getValue(u(edge)) - getValue(v(edge)));
+    }
+
+    /// \brief Collect the members of a subtree.
+    /*!
+     *  As in PersistenceSimplifier::simplifySubtree(), the subtree is every
+     *  node reachable from the pivot without passing through the parent.
+     *  The members of those nodes, of the edges between them, and of the
+     *  edge joining the subtree to the parent are written to `out`. The
+     *  parent's own members are not.
+     *
+     *  The search only touches the subtree, and keeps its state on the
+     *  caller's stack.
+     */
+    template <typename OutputIterator>
+    OutputIterator getSubtreeMembers(
+            Node parent,
+            Node pivot,
+            OutputIterator out) const
+    {
+        // a node to visit, and the node it was reached from
+        std::vector<std::pair<Node, Node> > stack;
+        stack.push_back(std::make_pair(pivot, getInvalidNode()));
+
+        while (!stack.empty())
+        {
+            Node node = stack.back().first;
+            Node previous = stack.back().second;
+            stack.pop_back();
+
+            Members node_members = getNodeMembers(node);
+            out = std::copy(node_members.begin(), node_members.end(), out);
+
+            for (UndirectedNeighborIterator<ContourTreeSnapshot> it(*this, node);
+                    !it.done(); ++it)
+            {
+                Node neighbor = it.neighbor();
+                if (neighbor == previous) {
+                    continue;
+                }
+
+                if (neighbor != parent) {
+                    stack.push_back(std::make_pair(neighbor, node));
+                }
+
+                // every edge is reached once, from its end nearer the pivot
+                Members edge_members = getEdgeMembers(it.edge());
+                out = std::copy(edge_members.begin(), edge_members.end(), out);
+            }
+        }
+
+        return out;
+    }
+
+};
+
+
+/// \brief Assembles a ContourTreeSnapshot.
+/// \ingroup contour_tree
+/*!
+ *  Offers the part of the UndirectedScalarMemberIDGraph interface used to
+ *  build a tree, so that the same code can fill either one; in particular,
+ *  ContourTreeFormatParser reads a contour tree file straight into a
+ *  builder. Nodes and edges are handles into the builder's own arrays,
+ *  and are only meaningful until finish() is called.
+ */
+class ContourTreeSnapshot::Builder
+{
+public:
+
+    typedef unsigned int Node;
+    typedef unsigned int Edge;
+    typedef ContourTreeSnapshot::Member Member;
+
+private:
+
+    std::vector<unsigned int> _ids;
+    std::vector<double> _values;
+    std::vector<unsigned int> _edges;
+
+    // the members, in insertion order, along with their owners
+    std::vector<Member> _node_members;
+    std::vector<unsigned int> _node_member_owners;
+    std::vector<Member> _edge_members;
+    std::vector<unsigned int> _edge_member_owners;
+
+    // sorted lazily, the first time a node is looked up by ID
+    mutable std::vector<IDIndex> _id_to_node;
+    mutable bool _id_to_node_sorted;
+
+    static const unsigned int INVALID = (unsigned int) -1;
+
+    void sortIDs() const
+    {
+        if (!_id_to_node_sorted) {
+            std::sort(_id_to_node.begin(), _id_to_node.end());
+            _id_to_node_sorted = true;
+        }
+    }
+
+    /// \brief Append the members to `members`, grouped by owner.
+    /*!
+     *  Members of the same owner keep their relative order. The members of
+     *  owner i end up at positions `offsets[slot[i]]` up to
+     *  `offsets[slot[i]+1]`, where the offsets are relative to the
+     *  previous end of `members`.
+     */
+    static void groupMembers(
+            const std::vector<Member>& ungrouped,
+            const std::vector<unsigned int>& owners,
+            const std::vector<unsigned int>& slot,
+            std::vector<Member>& members,
+            std::vector<size_t>& offsets)
+    {
+        size_t start = members.size();
+
+        offsets.assign(slot.size() + 1, 0);
+        for (size_t i=0; i<owners.size(); ++i) {
+            offsets[slot[owners[i]] + 1]++;
+        }
+
+        offsets[0] = start;
+        for (size_t i=0; i<slot.size(); ++i) {
+            offsets[i+1] += offsets[i];
+        }
+
+        members.resize(start + ungrouped.size(), Member(0, 0.));
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i=0; i<ungrouped.size(); ++i) {
+            members[fill[slot[owners[i]]]++] = ungrouped[i];
+        }
+    }
+
+public:
+
+    Builder() : _id_to_node_sorted(true) {}
+
+    /// \brief Reserve room for the given number of nodes and edges.
+    void reserve(size_t n_nodes, size_t n_edges)
+    {
+        _ids.reserve(n_nodes);
+        _values.reserve(n_nodes);
+        _node_members.reserve(n_nodes);
+        _node_member_owners.reserve(n_nodes);
+        _id_to_node.reserve(n_nodes);
+        _edges.reserve(2 * n_edges);
+    }
+
+    /// \brief Add a node. As in a contour tree, the node is its own member.
+    Node addNode(unsigned int id, double value)
+    {
+        Node node = _ids.size();
+        _ids.push_back(id);
+        _values.push_back(value);
+        _id_to_node.push_back(IDIndex(id, node));
+        _id_to_node_sorted = false;
+
+        insertNodeMember(node, Member(id, value));
+        return node;
+    }
+
+    /// \brief Add several nodes at once.
+    void addNodes(const unsigned int* ids, const double* values, size_t n_nodes)
+    {
+        // grow geometrically, as reserve() allocates exactly
+        size_t needed = _ids.size() + n_nodes;
+        if (needed > _ids.capacity()) {
+            reserve(std::max(needed, 2 * _ids.capacity()), _edges.size() / 2);
+        }
+
+        for (size_t i=0; i<n_nodes; ++i) {
+            addNode(ids[i], values[i]);
+        }
+    }
+
+    /// \brief Retrieve a node by its ID.
+    /*!
+     *  \returns The node, or an invalid node if no node has the ID.
+     */
+    Node getNode(unsigned int id) const
+    {
+        sortIDs();
+
+        std::vector<IDIndex>::const_iterator it = std::lower_bound(
+                _id_to_node.begin(), _id_to_node.end(), IDIndex(id, 0));
+
+        if (it == _id_to_node.end() || it->first != id) {
+            return INVALID;
+        }
+
+        return it->second;
+    }
+
+    /// \brief Add an edge between two nodes of the builder.
+    Edge addEdge(Node u, Node v)
+    {
+        if (u >= _ids.size() || v >= _ids.size()) {
+            throw std::runtime_error("Edge refers to a nonexistent node.");
+        }
+
+        _edges.push_back(u);
+        _edges.push_back(v);
+        return _edges.size() / 2 - 1;
+    }
+
+    /// \brief Insert a member into the node's member set.
+    void insertNodeMember(Node node, Member member)
+    {
+        _node_members.push_back(member);
+        _node_member_owners.push_back(node);
+    }
+
+    /// \brief Insert a member into the edge's member set.
+    void insertEdgeMember(Edge edge, Member member)
+    {
+        _edge_members.push_back(member);
+        _edge_member_owners.push_back(edge);
+    }
+
+    /// \brief Build the snapshot, leaving the builder empty.
+    ContourTreeSnapshot finish()
+    {
+        if (_ids.size() != _edges.size() / 2 + 1) {
+            throw std::runtime_error("The snapshot does not appear to be a tree.");
+        }
+
+        boost::shared_ptr<Arrays> arrays(new Arrays);
+
+        size_t n_edges = _edges.size() / 2;
+        std::vector<unsigned int> edge_identifiers(n_edges);
+        arrays->graph.build(_ids.size(), n_edges ? &_edges[0] : 0, n_edges,
+                            n_edges ? &edge_identifiers[0] : 0);
+
+        // the nodes keep the order in which they were added
+        std::vector<unsigned int> node_identifiers(_ids.size());
+        for (size_t i=0; i<node_identifiers.size(); ++i) {
+            node_identifiers[i] = i;
+        }
+
+        arrays->ids.swap(_ids);
+        arrays->values.swap(_values);
+
+        sortIDs();
+        arrays->id_to_node.swap(_id_to_node);
+
+        arrays->members.reserve(_node_members.size() + _edge_members.size());
+        groupMembers(_node_members, _node_member_owners, node_identifiers,
+                     arrays->members, arrays->node_offsets);
+        groupMembers(_edge_members, _edge_member_owners, edge_identifiers,
+                     arrays->members, arrays->edge_offsets);
+
+        *this = Builder();
+
+        return ContourTreeSnapshot(arrays);
+    }
+
+};
+
+
+template <typename ContourTree>
+ContourTreeSnapshot ContourTreeSnapshot::fromContourTree(const ContourTree& tree)
+{
+    typedef typename ContourTree::Members Members;
+
+    Builder builder;
+    builder.reserve(tree.numberOfNodes(), tree.numberOfEdges());
+
+    // the builder's nodes, by the tree's node identifiers
+    std::vector<Builder::Node> nodes(tree.getMaxNodeIdentifier() + 1);
+
+    for (NodeIterator<ContourTree> it(tree); !it.done(); ++it)
+    {
+        Builder::Node node = builder.addNode(
+                tree.getID(it.node()), tree.getValue(it.node()));
+        nodes[tree.getNodeIdentifier(it.node())] = node;
+
+        // the node was made its own member, so the rest are added after it
+        const Members& members = tree.getNodeMembers(it.node());
+        for (typename Members::const_iterator m_it = members.begin();
+                m_it != members.end(); ++m_it) {
+            if (m_it->getID() != tree.getID(it.node())) {
+                builder.insertNodeMember(node, Member(m_it->getID(), m_it->getValue()));
+            }
+        }
+    }
+
+    for (EdgeIterator<ContourTree> it(tree); !it.done(); ++it)
+    {
+        Builder::Edge edge = builder.addEdge(
+                nodes[tree.getNodeIdentifier(tree.u(it.edge()))],
+                nodes[tree.getNodeIdentifier(tree.v(it.edge()))]);
+
+        const Members& members = tree.getEdgeMembers(it.edge());
+        for (typename Members::const_iterator m_it = members.begin();
+                m_it != members.end(); ++m_it) {
+            builder.insertEdgeMember(edge, Member(m_it->getID(), m_it->getValue()));
+        }
+    }
+
+    return builder.finish();
+}
+
+
+} // namespace denali
+
+#endif
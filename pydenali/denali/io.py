@@ -23,10 +23,13 @@
 # ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 # POSSIBILITY OF SUCH DAMAGE.
 
+import array as _array
 import itertools as _itertools
 from StringIO import StringIO as _StringIO
 import networkx as _networkx
 import os as _os
+import struct as _struct
+import sys as _sys
 
 
 def _read_vertex_definitions(string):
@@ -336,3 +339,247 @@ def write_edges(fileobj, edges):
     """
     for u,v in edges:
         fileobj.write("{}\t{}\n".format(u,v))
+
+
+# the header of a binary vertex or edge file: magic string, format version,
+# a reserved word, and the number of records, all little-endian
+_BINARY_HEADER = "<8sIIQ"
+_BINARY_VERSION = 1
+
+
+def _write_binary_array(fileobj, magic, arr, n_records):
+    if _sys.byteorder == "big":
+        arr.byteswap()
+
+    fileobj.write(_struct.pack(_BINARY_HEADER, magic, _BINARY_VERSION, 0,
+                               n_records))
+    fileobj.write(arr.tostring())
+
+
+def write_binary_vertices(fileobj, vertex_values):
+    """Writes the contiguous vertex values to the file in binary format.
+
+    :param fileobj: The file-like object where the output will be written.
+        It must be opened in binary mode.
+    :type fileobj: File-like
+
+    :param vertex_values: The values of the vertices.
+    :type vertex_values: List-like
+
+    The ids of the vertices are implicit, as in `write_vertices()`. ctree
+    reads binary vertex files much faster than text ones.
+    """
+    values = _array.array("d", vertex_values)
+    _write_binary_array(fileobj, "DNLVERT\0", values, len(values))
+
+
+def write_binary_edges(fileobj, edges):
+    """Writes the edges to the file in binary format.
+
+    :param fileobj: The file-like object where the output will be written.
+        It must be opened in binary mode.
+    :type fileobj: File-like
+
+    :param edges: The edges as pairs of vertex ids.
+    :type edges: List-like
+
+    ``edges`` can be a python list of 2-tuples or 2-lists, or a numpy array
+    with 2 columns. Vertex ids must fit in 32 bits.
+    """
+    typecode = "I" if _array.array("I").itemsize == 4 else "L"
+    ids = _array.array(typecode, _itertools.chain.from_iterable(
+        (int(u), int(v)) for u,v in edges))
+    _write_binary_array(fileobj, "DNLEDGE\0", ids, len(ids) // 2)
+
+
+# the header of a binary contour tree file: magic string, format version,
+# flags, and the numbers of nodes, edges and edge members
+_BINARY_TREE_HEADER = "<8sIIQQQ"
+_BINARY_TREE_VERSION = 1
+_BINARY_TREE_COMPRESSED_VERSION = 2
+
+# flags of a version 2 file
+_BINARY_TREE_COMPRESSED_MEMBERS = 1
+_BINARY_TREE_FLOAT32_VALUES = 2
+
+
+def _uint32_array(values):
+    typecode = "I" if _array.array("I").itemsize == 4 else "L"
+    return _array.array(typecode, values)
+
+
+def _pack_uint64s(values):
+    """Packs a list of integers as little-endian 64 bit unsigned integers.
+
+    `array` has no 64 bit typecode under Python 2, so `struct` is used.
+    """
+    return _struct.pack("<%dQ" % len(values), *values)
+
+
+def _unpack_uint64s(data):
+    """Unpacks a string of little-endian 64 bit unsigned integers."""
+    return _struct.unpack("<%dQ" % (len(data) // 8), data)
+
+
+def _write_binary_section(fileobj, arr):
+    """Writes an array little-endian, padded with zeros to 8 bytes."""
+    if _sys.byteorder == "big":
+        arr.byteswap()
+
+    data = arr.tostring()
+    fileobj.write(data)
+    fileobj.write("\0" * (-len(data) % 8))
+
+
+def _read_varints(data):
+    """Yields the unsigned varints in a string of bytes."""
+    value = 0
+    shift = 0
+    for byte in bytearray(data):
+        value |= (byte & 0x7f) << shift
+        if byte & 0x80:
+            shift += 7
+        else:
+            yield value
+            value = 0
+            shift = 0
+
+
+def _decode_members(data, float32):
+    """Decodes one edge's compressed members to a dict of id: value.
+
+    Each member is the zigzag-encoded difference of its id from the last
+    member's, followed by that of the bits of its value.
+    """
+    if float32:
+        bits_mask, bits_format, value_format = 0xffffffff, "<I", "<f"
+    else:
+        bits_mask, bits_format, value_format = 2**64 - 1, "<Q", "<d"
+
+    members = {}
+    member_id = 0
+    bits = 0
+    varints = _read_varints(data)
+    for id_delta, bits_delta in _itertools.izip(varints, varints):
+        member_id = (member_id + ((id_delta >> 1) ^ -(id_delta & 1))) & 0xffffffff
+        bits = (bits + ((bits_delta >> 1) ^ -(bits_delta & 1))) & bits_mask
+        members[member_id] = _struct.unpack(
+            value_format, _struct.pack(bits_format, bits))[0]
+    return members
+
+
+def write_binary_tree(fileobj, tree):
+    """Writes a tree in denali's binary ``.dtree`` format.
+
+    **Note**: This function requires that the `networkx` package is installed.
+
+    :param fileobj: A file-like object that will be written to. It must be
+        opened in binary mode.
+    :type fileobj: File-like
+
+    :param tree: The tree to be written.
+    :type tree: `networkx` graph
+
+    The ``tree`` must have the same attributes as described in `read_tree()`.
+    Node and member ids must fit in 32 bits. The binary format holds the
+    same information as the text format written by `write_tree()`, but
+    denali loads it much faster, and values are stored without rounding.
+    """
+    nodes = list(tree)
+    index = dict((node, i) for i, node in enumerate(nodes))
+    edges = list(tree.edges_iter(data=True))
+
+    offsets = [0]
+    member_ids = []
+    member_values = []
+    for u, v, data in edges:
+        for member_id, member_value in data['members'].iteritems():
+            member_ids.append(int(member_id))
+            member_values.append(member_value)
+        offsets.append(len(member_ids))
+
+    fileobj.write(_struct.pack(_BINARY_TREE_HEADER, "DNLTREE\0",
+                               _BINARY_TREE_VERSION, 0,
+                               len(nodes), len(edges), len(member_ids)))
+
+    _write_binary_section(fileobj, _uint32_array(int(node) for node in nodes))
+    _write_binary_section(fileobj, _array.array(
+        "d", (tree.node[node]['value'] for node in nodes)))
+    _write_binary_section(fileobj, _uint32_array(_itertools.chain.from_iterable(
+        (index[u], index[v]) for u, v, data in edges)))
+    fileobj.write(_pack_uint64s(offsets))
+    _write_binary_section(fileobj, _uint32_array(member_ids))
+    _write_binary_section(fileobj, _array.array("d", member_values))
+
+
+def read_binary_tree(fileobj):
+    """Reads a binary ``.dtree`` file-like object to a networkx tree object.
+
+    **Note**: This function requires that the `networkx` package is installed.
+
+    :param fileobj: A file-like object, opened in binary mode, holding a
+        tree in the binary format written by `write_binary_tree()` or by
+        ``ctree --binary``, with or without ``--compress``.
+    :type fileobj: File-like
+    :returns: A `networkx` undirected graph, as described in `read_tree()`.
+    """
+    header_size = _struct.calcsize(_BINARY_TREE_HEADER)
+    magic, version, flags, n_nodes, n_edges, n_members = _struct.unpack(
+        _BINARY_TREE_HEADER, fileobj.read(header_size))
+
+    if magic != "DNLTREE\0":
+        raise ValueError("Not a binary contour tree file.")
+    if version not in (_BINARY_TREE_VERSION, _BINARY_TREE_COMPRESSED_VERSION):
+        raise ValueError(
+            "Unsupported binary contour tree version {}.".format(version))
+
+    compressed = version == _BINARY_TREE_COMPRESSED_VERSION and \
+        flags & _BINARY_TREE_COMPRESSED_MEMBERS
+    float32 = flags & _BINARY_TREE_FLOAT32_VALUES
+
+    def read_section(arr, n):
+        n_bytes = n * arr.itemsize
+        data = fileobj.read(n_bytes)
+        if len(data) != n_bytes:
+            raise ValueError("The binary contour tree file is truncated.")
+        arr.fromstring(data)
+        if _sys.byteorder == "big":
+            arr.byteswap()
+        fileobj.read(-n_bytes % 8)
+        return arr
+
+    ids = read_section(_uint32_array([]), n_nodes)
+    values = read_section(_array.array("d"), n_nodes)
+    endpoints = read_section(_uint32_array([]), 2 * n_edges)
+    offsets_data = fileobj.read(8 * (n_edges + 1))
+    if len(offsets_data) != 8 * (n_edges + 1):
+        raise ValueError("The binary contour tree file is truncated.")
+    offsets = _unpack_uint64s(offsets_data)
+
+    if compressed:
+        # the offsets count bytes into the encoded members
+        member_bytes = fileobj.read(offsets[-1])
+        if len(member_bytes) != offsets[-1]:
+            raise ValueError("The binary contour tree file is truncated.")
+    else:
+        member_ids = read_section(_uint32_array([]), n_members)
+        member_values = read_section(_array.array("d"), n_members)
+
+    tree = _networkx.Graph()
+    for node_id, value in zip(ids, values):
+        tree.add_node(node_id, value=value)
+
+    for i in range(n_edges):
+        u = ids[endpoints[2*i]]
+        v = ids[endpoints[2*i + 1]]
+        tree.add_edge(u, v)
+
+        if compressed:
+            tree.edge[u][v]['members'] = _decode_members(
+                member_bytes[offsets[i]:offsets[i+1]], float32)
+        else:
+            members = range(offsets[i], offsets[i+1])
+            tree.edge[u][v]['members'] = dict(
+                (member_ids[m], member_values[m]) for m in members)
+
+    return tree
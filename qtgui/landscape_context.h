@@ -373,12 +373,14 @@ public:
 template <typename ContourTree, template <class T> class LandscapeBuilderTemplate>
 class ConcreteLandscapeContext : public LandscapeContext
 {
-    typedef denali::FoldedContourTree<ContourTree> FoldedContourTree;
+    // the folded tree is never compacted here, so its maps needn't observe it
+    typedef denali::LazyMaps Maps;
+    typedef denali::FoldedContourTree<ContourTree, Maps> FoldedContourTree;
     typedef LandscapeBuilderTemplate<FoldedContourTree> LandscapeBuilder;
     typedef typename LandscapeBuilder::LandscapeType Landscape;
     typedef denali::ColorMap ColorMap;
     typedef denali::WeightMap WeightMap;
-    typedef denali::ObservingEdgeMap<FoldedContourTree, double> ReductionMap;
+    typedef typename Maps::template EdgeMap<FoldedContourTree, double>::Type ReductionMap;
 
     boost::shared_ptr<ContourTree> _contour_tree;
     boost::shared_ptr<LandscapeBuilder> _landscape_builder;
@@ -399,6 +401,23 @@ class ConcreteLandscapeContext : public LandscapeContext
     bool _child_in_reduction;
     bool _members_in_reduction;
 
+    // reused by every search of the folded tree, so that clicking around
+    // a large landscape doesn't allocate and clear a search each time.
+    // Const methods share it too, so the context is not thread-safe, even
+    // for reading: callers must serialize all access to it, as MainWindow
+    // does with waitForLiveRefine(). For the same reason, no search may be
+    // started while another is still being iterated
+    typedef typename denali::UndirectedBFSIterator<FoldedContourTree>::Workspace
+            BFSWorkspace;
+    mutable BFSWorkspace _bfs_workspace;
+
+    // the last subtree simplified, recorded so that simplifying it again
+    // to another threshold only makes or undoes the steps in between
+    denali::PersistenceHierarchy _hierarchy;
+    size_t _hierarchy_parent;
+    size_t _hierarchy_child;
+    bool _has_hierarchy;
+
     virtual double getColorMapValue(unsigned int id) const
     {
         ColorMap::const_iterator it = (*_color_map).find(id);
@@ -541,7 +560,10 @@ public:
             _reduction_map(new ReductionMap(_folded_tree)),
             _parent_in_reduction(true),
             _child_in_reduction(true),
-            _members_in_reduction(true)
+            _members_in_reduction(true),
+            _hierarchy_parent(0),
+            _hierarchy_child(0),
+            _has_hierarchy(false)
     {
         _max_persistence = computeMaxPersistence(*_contour_tree);
         
@@ -694,14 +716,22 @@ public:
             size_t child_id,
             double persistence)
     {
-        typename FoldedContourTree::Node parent_node, child_node;
-        parent_node = _folded_tree.getNode(parent_id);
-        child_node  = _folded_tree.getNode(child_id);
+        if (!_has_hierarchy || parent_id != _hierarchy_parent ||
+                child_id != _hierarchy_child)
+        {
+            typename FoldedContourTree::Node parent_node, child_node;
+            parent_node = _folded_tree.getNode(parent_id);
+            child_node  = _folded_tree.getNode(child_id);
+
+            expandSubtree(_folded_tree, parent_node, child_node, _bfs_workspace);
+            _hierarchy.computeSubtree(_folded_tree, parent_node, child_node);
 
-        expandSubtree(_folded_tree, parent_node, child_node);
-        denali::PersistenceSimplifier simplifier(persistence); 
+            _hierarchy_parent = parent_id;
+            _hierarchy_child = child_id;
+            _has_hierarchy = true;
+        }
 
-        simplifier.simplifySubtree(_folded_tree, parent_node, child_node);
+        _hierarchy.simplify(_folded_tree, persistence);
     }
 
     /// \brief Sets the weight map, assuming ownership of the memory.
@@ -833,29 +863,32 @@ public:
         child_node  = _folded_tree.getNode(child_id);
 
         // expand the tree
-        expandSubtree(_folded_tree, parent_node, child_node);
+        expandSubtree(_folded_tree, parent_node, child_node, _bfs_workspace);
+        _has_hierarchy = false;
 
-        typedef denali::UndirectedScalarMemberIDGraph Graph;
-        denali::StaticNodeMap<FoldedContourTree, Graph::Node> old_to_new(_folded_tree);
+        // the new tree keeps its members the same way as this one
+        typedef typename ContourTree::Graph Graph;
+        denali::StaticNodeMap<FoldedContourTree, typename Graph::Node> old_to_new(_folded_tree);
 
         // now we do a BFS inside of the expansion and build a new contour tree
         boost::shared_ptr<Graph> new_tree = boost::shared_ptr<Graph>(new Graph);
 
         double child_value = _folded_tree.getValue(child_node);
-        Graph::Node new_node = new_tree->addNode(child_id, child_value);
+        typename Graph::Node new_node = new_tree->addNode(child_id, child_value);
         old_to_new[child_node] = new_node;
 
-        for (denali::UndirectedBFSIterator<FoldedContourTree> it(_folded_tree, parent_node, child_node);
+        for (denali::UndirectedBFSIterator<FoldedContourTree> it(
+                    _folded_tree, parent_node, child_node, _bfs_workspace);
                 !it.done(); ++it)
         {
             unsigned int node_id = _folded_tree.getID(it.child());
             double node_value = _folded_tree.getValue(it.child());
-            Graph::Node new_node = new_tree->addNode(node_id, node_value);
+            typename Graph::Node new_node = new_tree->addNode(node_id, node_value);
 
             old_to_new[it.child()] = new_node;
 
-            Graph::Node new_parent = old_to_new[it.parent()];
-            Graph::Edge edge = new_tree->addEdge(new_node, new_parent);
+            typename Graph::Node new_parent = old_to_new[it.parent()];
+            typename Graph::Edge edge = new_tree->addEdge(new_node, new_parent);
 
             // now insert the members
             const typename FoldedContourTree::Members& old_members = 
@@ -867,14 +900,14 @@ public:
                 unsigned int member_id = (*m_it).getID();
                 double member_value = (*m_it).getValue();
 
-                Graph::Member new_member(member_id, member_value);
+                typename Graph::Member new_member(member_id, member_value);
 
                 new_tree->insertEdgeMember(edge, new_member);
             }
         }
 
-        denali::ContourTree* new_contour_tree = 
-                new denali::ContourTree(denali::ContourTree::fromPrecomputed(new_tree));
+        ContourTree* new_contour_tree = 
+                new ContourTree(ContourTree::fromPrecomputed(new_tree));
 
         ConcreteLandscapeContext* new_context = 
                 new ConcreteLandscapeContext(new_contour_tree);
@@ -948,7 +981,7 @@ public:
         Members member_set;
 
         denali::UndirectedBFSIterator<FoldedContourTree> 
-                it(_folded_tree, parent_node, child_node);
+                it(_folded_tree, parent_node, child_node, _bfs_workspace);
 
         for (; !it.done(); ++it)
         {
@@ -999,7 +1032,7 @@ public:
         Node root_child_node  = _folded_tree.getNode(root_child);
 
         denali::UndirectedBFSIterator<FoldedContourTree> 
-                it(_folded_tree, root_parent_node, root_child_node);
+                it(_folded_tree, root_parent_node, root_child_node, _bfs_workspace);
 
         for (; !it.done(); ++it)
         {
@@ -1026,7 +1059,7 @@ public:
         Node root_child_node  = _folded_tree.getNode(root_child);
 
         denali::UndirectedBFSIterator<FoldedContourTree> 
-                it(_folded_tree, root_parent_node, root_child_node);
+                it(_folded_tree, root_parent_node, root_child_node, _bfs_workspace);
 
         for (; !it.done(); ++it)
         {
@@ -1060,8 +1093,10 @@ public:
         for (typename Neighbors::const_iterator it = root_neighbors.begin();
                 it != root_neighbors.end(); ++it)
         {
-            denali::expandSubtree(_folded_tree, root, *it);
+            denali::expandSubtree(_folded_tree, root, *it, _bfs_workspace);
         }
+
+        _has_hierarchy = false;
     }
 
 
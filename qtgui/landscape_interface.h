@@ -247,27 +247,32 @@ void LandscapeMeshBuilder(void* args)
     double min_z = context.getMinPoint().z();
     double z_range = max_z - min_z;
 
-    for (size_t i=0; i<context.numberOfPoints(); ++i)
+    // the landscape is rebuilt on every move of the persistence slider, so
+    // the arrays are sized up front and no cell objects are made
+    size_t n_points = context.numberOfPoints();
+    points->SetNumberOfPoints(n_points);
+
+    for (size_t i=0; i<n_points; ++i)
     {
         Point point = context.getPoint(i);
 
         // normalize the height
         double normalized_z = (point.z() - min_z) / z_range;
 
-        points->InsertNextPoint(point.x(), point.y(), normalized_z);
+        points->SetPoint(i, point.x(), point.y(), normalized_z);
     }
 
-    for (size_t i=0; i<context.numberOfTriangles(); ++i)
+    size_t n_triangles = context.numberOfTriangles();
+    triangles->Allocate(triangles->EstimateSize(n_triangles, 3));
+
+    for (size_t i=0; i<n_triangles; ++i)
     {
         // get the triangle from the landscape
         Triangle tri = context.getTriangle(i);
 
         // and add it to the cell array
-        vtkSmartPointer<vtkTriangle> vtk_tri = vtkSmartPointer<vtkTriangle>::New();
-        vtk_tri->GetPointIds()->SetId(1, tri.i());
-        vtk_tri->GetPointIds()->SetId(2, tri.j());
-        vtk_tri->GetPointIds()->SetId(0, tri.k());
-        triangles->InsertNextCell(vtk_tri);
+        vtkIdType ids[3] = { tri.k(), tri.i(), tri.j() };
+        triangles->InsertNextCell(3, ids);
     }
 
     // set the output
@@ -36,6 +36,9 @@
 
 MainWindow::MainWindow() :
     _max_persistence_slider_value(100),
+    _has_live_subtree(false), _live_parent(0), _live_child(0),
+    _live_refining(false), _live_refine_pending(false),
+    _building_landscape(false),
     _color_map_dialog(new ColorMapDialog(this)),
     _callbacks_dialog(new CallbacksDialog(this)),
     _choose_root_dialog(new ChooseRootDialog(this)),
@@ -74,6 +77,11 @@ MainWindow::MainWindow() :
     connect(_mainwindow.pushButtonRefineSubtree, SIGNAL(clicked()),
             this, SLOT(refineSubtree()));
 
+    // the slider's valueChanged() is not connected to refineLiveSubtree()
+    // yet: see refineLiveSubtree()
+    connect(&_live_refine_watcher, SIGNAL(finished()),
+            this, SLOT(finishLiveRefine()));
+
     // Weight maps
     ////////////////////////////////////////////////////////////////////////////
 
@@ -151,8 +159,19 @@ MainWindow::MainWindow() :
 }
 
 
+MainWindow::~MainWindow()
+{
+    // the refinement holds a raw pointer to the context, which is about to
+    // be destroyed along with the window
+    _live_refine_watcher.waitForFinished();
+}
+
+
 void MainWindow::setContext(LandscapeContext* context)
 {
+    waitForLiveRefine();
+    forgetLiveSubtree();
+
     _landscape_context = boost::shared_ptr<LandscapeContext>(context);
 
     // invalidate the color map
@@ -176,21 +195,78 @@ void MainWindow::setContext(LandscapeContext* context)
 }
 
 
-denali::ContourTree* readAndAllocateContourTree(std::string filename)
+// only the nodes and edges are read up front; each edge's members are read
+// from the file the first time they're needed
+denali::LazyContourTree* readAndAllocateContourTree(std::string filename)
+{
+    return new denali::LazyContourTree(denali::readLazyContourTreeFile(filename.c_str()));
+}
+
+
+/// \brief The node chosen to root the landscape at, as set in the dialog.
+/*!
+ *  Read on the GUI thread, so that the root can be found after the tree
+ *  has been simplified in the background.
+ */
+class LandscapeRootChoice
+{
+    bool _minimum;
+    bool _maximum;
+    size_t _other;
+
+public:
+    LandscapeRootChoice(const ChooseRootDialog& dialog)
+        : _minimum(dialog.isMinimumNodeChecked()),
+          _maximum(dialog.isMaximumNodeChecked()),
+          _other(dialog.getOtherNode()) {}
+
+    size_t getRootID(LandscapeContext& context) const
+    {
+        if (_minimum) {
+            return context.getMinNodeID();
+        } else if (_maximum) {
+            return context.getMaxNodeID();
+        } else {
+            return _other;
+        }
+    }
+};
+
+
+// simplifies the subtree and rebuilds the landscape, off of the GUI thread.
+// Returns an error message, or an empty string on success: an exception
+// must not escape the worker, or it would abort the GUI thread. The
+// context's landscape is only replaced once the new one is built
+std::string refineAndBuildLandscape(
+        LandscapeContext* context,
+        size_t parent,
+        size_t child,
+        double persistence,
+        LandscapeRootChoice root)
 {
-    return new denali::ContourTree(denali::readContourTreeFile(filename.c_str()));
+    try
+    {
+        context->simplifySubtreeByPersistence(parent, child, persistence);
+        context->buildLandscape(root.getRootID(*context));
+    }
+    catch (std::exception& e)
+    {
+        return e.what();
+    }
+
+    return std::string();
 }
 
 
 void MainWindow::openContourTreeFile()
 {
-    typedef denali::ContourTree ContourTree;
+    typedef denali::LazyContourTree ContourTree;
     typedef ConcreteLandscapeContext
             <ContourTree, denali::RectangularLandscapeBuilder> Context;
 
     // open a file dialog to get the filename
     QString qfilename = QFileDialog::getOpenFileName(
-            this, tr("Open Contour Tree File"), "", tr("Files(*.tree)"));
+            this, tr("Open Contour Tree File"), "", tr("Files(*.tree *.dtree)"));
 
     // convert the filename to a std::string
     std::string filename = qfilename.toUtf8().constData();
@@ -276,24 +352,17 @@ void MainWindow::changeLandscapeRoot()
     // check that there is actually a context
     if (!_landscape_context) return;
 
-    size_t root_id;
-    if (_choose_root_dialog->isMinimumNodeChecked()) 
-    {
-        root_id = _landscape_context->getMinNodeID();
-    } 
-    else if (_choose_root_dialog->isMaximumNodeChecked()) 
-    {
-        root_id = _landscape_context->getMaxNodeID();
-    }
-    else
-    {
-        root_id = _choose_root_dialog->getOtherNode();
-    }
+    waitForLiveRefine();
+
+    size_t root_id = LandscapeRootChoice(*_choose_root_dialog).getRootID(
+            *_landscape_context);
 
     std::stringstream message;
     message << "The landscape is now rooted at node " << root_id << ".";
     this->setStatus(message.str());
 
+    _building_landscape = true;
+
     QFuture<void> result = 
             QtConcurrent::run(&*_landscape_context, &LandscapeContext::buildLandscape, root_id);
 
@@ -310,12 +379,23 @@ void MainWindow::changeLandscapeRoot()
         QApplication::processEvents();
     }
 
+    _building_landscape = false;
+
     emit landscapeChanged();
+
+    // the slider may have been moved while the landscape was built
+    if (_live_refine_pending) {
+        refineLiveSubtree();
+    }
 }
 
 
 void MainWindow::receiveCellSelection(unsigned int cell)
 {
+    // the landscape on screen is about to be replaced, so the cell may 
+    // not be the one the user sees
+    if (_live_refining || _building_landscape) return;
+
     _cell_selection = cell;
     emit cellSelected(cell);
 }
@@ -327,6 +407,11 @@ void MainWindow::updateCellSelection(unsigned int cell)
     size_t parent, child;
     _landscape_context->getComponentParentChild(cell, parent, child);
 
+    // dragging the persistence slider now refines this subtree
+    _has_live_subtree = true;
+    _live_parent = parent;
+    _live_child = child;
+
     double parent_value = _landscape_context->getValue(parent);
     double child_value  = _landscape_context->getValue(child);
 
@@ -365,11 +450,16 @@ void MainWindow::enablePersistenceSlider()
     this->updatePersistence(0);
 }
 
+double MainWindow::getSliderPersistence(int value) const
+{
+    return ((double) value)/_max_persistence_slider_value * 
+            _landscape_context->getMaxPersistence();
+}
+
 void MainWindow::updatePersistence(int value)
 {
     // compute the persistence level
-    double persistence = ((double) value)/_max_persistence_slider_value * 
-            _landscape_context->getMaxPersistence();
+    double persistence = getSliderPersistence(value);
     
     // set the label to this persistence
     std::stringstream label;
@@ -378,6 +468,102 @@ void MainWindow::updatePersistence(int value)
 }
 
 
+/// \brief Refines the selected subtree to the slider's persistence.
+/*!
+ *  Only the simplification is incremental. The landscape is rebuilt and
+ *  re-meshed as a whole once the subtree is refined, as the rectangular
+ *  layout and the mesh are built for the full tree. Until only the
+ *  refined subtree's region of the mesh is rebuilt, this would cost as
+ *  much per slider step as clicking Refine Subtree, so the slider is not
+ *  connected to it.
+ */
+void MainWindow::refineLiveSubtree()
+{
+    if (!_landscape_context || !_has_live_subtree) return;
+
+    // only one refinement runs at a time, and not while the landscape is
+    // being built. If the slider moves in the meantime, the latest value is
+    // used once it is done, and the values in between are skipped
+    if (_live_refining || _building_landscape)
+    {
+        _live_refine_pending = true;
+        return;
+    }
+
+    _live_refining = true;
+    _live_refine_pending = false;
+
+    double persistence = getSliderPersistence(
+            _mainwindow.horizontalSliderPersistence->value());
+
+    _live_refine_watcher.setFuture(QtConcurrent::run(
+            refineAndBuildLandscape, &*_landscape_context, 
+            _live_parent, _live_child, persistence,
+            LandscapeRootChoice(*_choose_root_dialog)));
+}
+
+
+void MainWindow::finishLiveRefine()
+{
+    // waitForLiveRefine() may have finished it already
+    if (!_live_refining) return;
+
+    _live_refining = false;
+
+    std::string error = _live_refine_watcher.result();
+    if (!error.empty())
+    {
+        // the previous landscape is left on screen, and the slider stops
+        // refining the subtree
+        forgetLiveSubtree();
+
+        QString message = QString::fromStdString(
+                std::string("There was a problem refining the subtree: ") +
+                error);
+
+        QMessageBox msgbox;
+        msgbox.setIcon(QMessageBox::Warning);
+        msgbox.setText(message);
+        msgbox.exec();
+        return;
+    }
+
+    emit landscapeChanged();
+
+    if (_live_refine_pending) {
+        refineLiveSubtree();
+    }
+}
+
+
+/// \brief Blocks until the live refinement, if any, has been drawn.
+/*!
+ *  Anything which reads or changes the context must call this first, as
+ *  the refinement changes the context on another thread.
+ */
+void MainWindow::waitForLiveRefine()
+{
+    if (!_live_refining) return;
+
+    _live_refine_watcher.waitForFinished();
+    _live_refine_pending = false;
+    finishLiveRefine();
+}
+
+
+/// \brief Stops the persistence slider from refining the selected subtree.
+/*!
+ *  Must be called whenever the tree is changed by anything other than the
+ *  live refinement, as the selected parent and child may no longer be
+ *  adjacent afterwards.
+ */
+void MainWindow::forgetLiveSubtree()
+{
+    _has_live_subtree = false;
+    _live_refine_pending = false;
+}
+
+
 void MainWindow::enableRefineSubtree()
 {
     _mainwindow.pushButtonRefineSubtree->setEnabled(true);
@@ -390,6 +576,8 @@ void MainWindow::disableRefineSubtree()
 
 void MainWindow::refineSubtree()
 {
+    waitForLiveRefine();
+
     // get the parent and child nodes of the selection
     size_t parent, child;
     _landscape_context->getComponentParentChild(_cell_selection, parent, child);
@@ -400,6 +588,7 @@ void MainWindow::refineSubtree()
             _landscape_context->getMaxPersistence();
 
     _landscape_context->simplifySubtreeByPersistence(parent, child, persistence);
+    forgetLiveSubtree();
 
     // we need to rebuild the landscape
     changeLandscapeRoot();
@@ -428,6 +617,8 @@ void MainWindow::disableClearWeightMap()
 
 void MainWindow::loadWeightMapFile()
 {
+    waitForLiveRefine();
+
     // open a file dialog to get the filename
     QString qfilename = QFileDialog::getOpenFileName(
             this, tr("Open Weight Map File"), "", tr("Files(*.weights)"));
@@ -471,6 +662,8 @@ void MainWindow::loadWeightMapFile()
 
 void MainWindow::clearWeightMap()
 {
+    waitForLiveRefine();
+
     boost::shared_ptr<denali::WeightMap> null_map;
     _landscape_context->setWeightMap(null_map);
 
@@ -502,6 +695,8 @@ void MainWindow::disableClearColorMap()
 
 void MainWindow::configureColorMap()
 {
+    waitForLiveRefine();
+
     // the reduction is automatically recalculated if a new color map 
     // or reduction functor is specified, and the other is non-null.
     // we set both to be null to prevent this from happening.
@@ -633,6 +828,8 @@ void MainWindow::configureColorMap()
 
 void MainWindow::clearColorMap()
 {
+    waitForLiveRefine();
+
     _use_color_map = false;
     _landscape_context->setColorMap(boost::shared_ptr<denali::ColorMap>());
     _landscape_context->setColorReduction(boost::shared_ptr<Reduction>());
@@ -677,6 +874,8 @@ std::string MainWindow::prepareCallback(
         QTemporaryFile& tempfile,
         bool provide_subtree)
 {
+    waitForLiveRefine();
+
     // Factors out the common steps in launching a blocking or non-blocking 
     // callback, such as writing the selection file. Returns the command to
     // run.
@@ -987,6 +1186,8 @@ void MainWindow::disableRebaseLandscape()
 
 void MainWindow::rebaseLandscape()
 {
+    waitForLiveRefine();
+
     // get the parent and child nodes of the selection
     size_t parent, child;
     _landscape_context->getComponentParentChild(_cell_selection, parent, child);
@@ -1019,7 +1220,10 @@ void MainWindow::disableExpandLandscape()
 
 void MainWindow::expandLandscape()
 {
+    waitForLiveRefine();
+
     _landscape_context->expandLandscape();
+    forgetLiveSubtree();
 
     // we need to rebuild the landscape
     changeLandscapeRoot();
@@ -1034,6 +1238,8 @@ void MainWindow::enableChooseRoot()
 
 void MainWindow::chooseRoot()
 {
+    waitForLiveRefine();
+
     if (_choose_root_dialog->exec() == QDialog::Accepted)
     {
         // if a root other than min or max is specified, we have to verify 
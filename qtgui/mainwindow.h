@@ -45,6 +45,7 @@ class MainWindow : public QMainWindow, public LandscapeEventObserver
 public:
     
     MainWindow();
+    ~MainWindow();
 
     void setContext(LandscapeContext*);
     void receiveCellSelection(unsigned int);
@@ -74,6 +75,9 @@ public slots:
     void enablePersistenceSlider();
     void updatePersistence(int);
 
+    void refineLiveSubtree();
+    void finishLiveRefine();
+
     void enableRefineSubtree();
     void disableRefineSubtree();
 
@@ -122,6 +126,10 @@ signals:
 
 private:
 
+    double getSliderPersistence(int) const;
+    void waitForLiveRefine();
+    void forgetLiveSubtree();
+
     Ui::MainWindow _mainwindow;
     boost::shared_ptr<LandscapeContext> _landscape_context;
     boost::shared_ptr<LandscapeInterface> _landscape_interface;
@@ -129,6 +137,21 @@ private:
     int _max_persistence_slider_value;
     unsigned int _cell_selection;
 
+    // the subtree which is refined as the persistence slider is dragged
+    bool _has_live_subtree;
+    size_t _live_parent;
+    size_t _live_child;
+
+    // the refinement running in the background, and whether the slider has
+    // moved since it was started. The refinement's result is an error
+    // message, empty if it succeeded
+    QFutureWatcher<std::string> _live_refine_watcher;
+    bool _live_refining;
+    bool _live_refine_pending;
+
+    // whether the landscape is being rebuilt by changeLandscapeRoot()
+    bool _building_landscape;
+
     ColorMapDialog* _color_map_dialog;
     CallbacksDialog* _callbacks_dialog;
     ChooseRootDialog* _choose_root_dialog;
@@ -0,0 +1,240 @@
+// Compares the speed of denali::DisjointSetForest with the implementation it
+// replaced, on the union-find operations performed by the join and split
+// sweeps of Carr's algorithm.
+//
+// usage: disjoint_set_benchmark <vertex value file> <edge file> [repetitions]
+
+#include <ctime>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <denali/contour_tree.h>
+#include <denali/fileio.h>
+
+// The disjoint set forest used before the flat-array version: recursive
+// path compression, union by rank, and extremes stored as elements.
+template <typename TotalOrder>
+class ReferenceDisjointSetForest
+{
+    const TotalOrder& order;
+    std::vector<unsigned int> parent;
+    std::vector<unsigned int> rank;
+    std::vector<unsigned int> max_element;
+    std::vector<unsigned int> min_element;
+
+public:
+
+    ReferenceDisjointSetForest(const TotalOrder& order)
+        : order(order),
+          parent(order.size()),
+          rank(order.size()),
+          max_element(order.size()),
+          min_element(order.size())
+    {
+        for (size_t i=0; i<order.size(); ++i) {
+            parent[i] = i;
+            max_element[i] = i;
+            min_element[i] = i;
+            rank[i] = 0;
+        }
+    }
+
+
+    unsigned int
+    findSet(unsigned int x)
+    {
+        if (this->parent[x] != x) {
+            this->parent[x] = findSet(this->parent[x]);
+        }
+
+        return this->parent[x];
+    }
+
+    unsigned int
+    findMax(unsigned int x)
+    {
+        return this->max_element[this->findSet(x)];
+    }
+
+
+    unsigned int
+    findMin(unsigned int x)
+    {
+        return this->min_element[this->findSet(x)];
+    }
+
+
+    void
+    setUnion(unsigned int x, unsigned int y)
+    {
+        this->link(this->findSet(x), this->findSet(y));
+    }
+
+
+private:
+    void
+    link(unsigned int x, unsigned int y)
+    {
+
+        unsigned int max_x_id = this->order.elementToPosition(this->max_element[x]);
+        unsigned int min_x_id = this->order.elementToPosition(this->min_element[x]);
+        unsigned int max_y_id = this->order.elementToPosition(this->max_element[y]);
+        unsigned int min_y_id = this->order.elementToPosition(this->min_element[y]);
+
+        if (this->rank[x] > this->rank[y]) {
+            this->parent[y] = x;
+
+            if (max_x_id < max_y_id) {
+                this->max_element[x] = this->max_element[y];
+            }
+
+            if (min_x_id > min_y_id) {
+                this->min_element[x] = this->min_element[y];
+            }
+
+        } else {
+            this->parent[x] = y;
+
+            if (this->rank[x] == this->rank[y]) {
+                this->rank[y] += 1;
+            }
+
+            if (max_y_id < max_x_id) {
+                this->max_element[y] = this->max_element[x];
+            }
+
+            if (min_y_id > min_x_id) {
+                this->min_element[y] = this->min_element[x];
+            }
+        }
+    }
+};
+
+
+// performs the unions and finds of a join sweep, followed by those of a split
+// sweep, returning a checksum of the extremes found
+template <typename Forest>
+unsigned long int sweep(
+    const denali::CompactScalarSimplicialComplex& plex,
+    const denali::TotalOrder& order)
+{
+    typedef denali::CompactScalarSimplicialComplex Plex;
+    typedef denali::UndirectedNeighborIterator<Plex> NeighborIt;
+
+    unsigned long int checksum = 0;
+
+    Forest join_forest(order);
+    for (size_t i=0; i<order.size(); ++i) {
+        unsigned int vi = order.positionToElement(i);
+
+        for (NeighborIt it(plex, plex.getNode(vi)); !it.done(); ++it) {
+            unsigned int vj = plex.getID(it.neighbor());
+
+            if (order.elementToPosition(vj) < i &&
+                    join_forest.findSet(vi) != join_forest.findSet(vj)) {
+                checksum += join_forest.findMax(vj);
+                join_forest.setUnion(vi, vj);
+            }
+        }
+    }
+
+    Forest split_forest(order);
+    for (size_t i=order.size(); i-- > 0; ) {
+        unsigned int vi = order.positionToElement(i);
+
+        for (NeighborIt it(plex, plex.getNode(vi)); !it.done(); ++it) {
+            unsigned int vj = plex.getID(it.neighbor());
+
+            if (order.elementToPosition(vj) > i &&
+                    split_forest.findSet(vi) != split_forest.findSet(vj)) {
+                checksum += split_forest.findMin(vj);
+                split_forest.setUnion(vi, vj);
+            }
+        }
+    }
+
+    return checksum;
+}
+
+
+template <typename Forest>
+double timeSweeps(
+    const denali::CompactScalarSimplicialComplex& plex,
+    const denali::TotalOrder& order,
+    int repetitions,
+    unsigned long int& checksum)
+{
+    std::clock_t start = std::clock();
+    for (int i=0; i<repetitions; ++i) {
+        checksum = sweep<Forest>(plex, order);
+    }
+    return double(std::clock() - start) / CLOCKS_PER_SEC / repetitions;
+}
+
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: disjoint_set_benchmark <vertex value file> "
+                  << "<edge file> [repetitions]" << std::endl;
+        return 1;
+    }
+
+    int repetitions = argc > 3 ? atoi(argv[3]) : 5;
+    if (repetitions < 1) {
+        repetitions = 1;
+    }
+
+    denali::CompactScalarSimplicialComplex plex;
+    try {
+        if (denali::isBinaryVertexFile(argv[1])) {
+            denali::readBinaryVertexFile(argv[1], plex);
+        } else {
+            denali::readSimplicialVertexFile(argv[1], plex);
+        }
+
+        if (denali::isBinaryEdgeFile(argv[2])) {
+            denali::readBinaryEdgeFile(argv[2], plex);
+        } else {
+            denali::readSimplicialEdgeFile(argv[2], plex);
+            plex.freeze();
+        }
+    }
+    catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<double> values(plex.numberOfNodes());
+    for (size_t i=0; i<values.size(); ++i) {
+        values[i] = plex.getValue(plex.getNode(i));
+    }
+
+    denali::RandomAccessValueSorter<std::vector<double> > sorter(values);
+    denali::TotalOrder order = denali::TotalOrder::compute(values, sorter);
+
+    typedef denali::TotalOrder Order;
+
+    unsigned long int reference_checksum;
+    double reference_time = timeSweeps<ReferenceDisjointSetForest<Order> >(
+            plex, order, repetitions, reference_checksum);
+
+    unsigned long int checksum;
+    double time = timeSweeps<denali::DisjointSetForest<Order> >(
+            plex, order, repetitions, checksum);
+
+    std::cout << plex.numberOfNodes() << " vertices, "
+              << plex.numberOfEdges() << " edges, "
+              << repetitions << " repetitions" << std::endl;
+    std::cout << "reference forest: " << reference_time << " s per sweep pair" << std::endl;
+    std::cout << "flat forest:      " << time << " s per sweep pair" << std::endl;
+    std::cout << "speedup:          " << reference_time / time << std::endl;
+
+    if (checksum != reference_checksum) {
+        std::cerr << "Error: the forests disagree." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Times repeated simplify/expand cycles of a denali::FoldedContourTree, as
+// made when dragging the persistence slider back and forth. Each cycle
+// replays a persistence hierarchy all the way down and back up, so that
+// every fold is collapsed or reduced and then unfolded again. Heap
+// allocations made during the cycles are counted, too.
+//
+// usage: fold_tree_benchmark <tree file> [cycles]
+
+#include <ctime>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <new>
+
+#include <denali/fileio.h>
+#include <denali/folded.h>
+#include <denali/simplify.h>
+
+static size_t n_allocations = 0;
+
+// The replacements are declared without exception specifications, since
+// the dynamic ones are rejected by C++17 and noexcept is unknown to C++98.
+static void* countedAllocate(std::size_t size)
+{
+    ++n_allocations;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void* p)
+{
+    std::free(p);
+}
+
+void operator delete[](void* p)
+{
+    std::free(p);
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: fold_tree_benchmark <tree file> [cycles]" << std::endl;
+        return 1;
+    }
+
+    int cycles = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    typedef denali::FoldedContourTree<denali::ContourTree> FoldedContourTree;
+
+    denali::ContourTree contour_tree = denali::readContourTreeFile(argv[1]);
+    FoldedContourTree folded_tree(contour_tree);
+
+    denali::PersistenceHierarchy hierarchy;
+    hierarchy.compute(folded_tree);
+
+    double top = std::numeric_limits<double>::infinity();
+
+    // one cycle beforehand, so that the folds have grown to their full size
+    hierarchy.simplify(folded_tree, 0);
+    hierarchy.simplify(folded_tree, top);
+
+    size_t allocations_before = n_allocations;
+    std::clock_t start = std::clock();
+
+    size_t steps = 0;
+    for (int i=0; i<cycles; ++i) {
+        steps += hierarchy.simplify(folded_tree, 0);
+        steps += hierarchy.simplify(folded_tree, top);
+    }
+
+    double seconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+    size_t allocations = n_allocations - allocations_before;
+
+    std::cout << contour_tree.numberOfNodes() << " nodes, "
+              << hierarchy.numberOfSteps() << " steps" << std::endl;
+    std::cout << cycles << " cycles, " << steps << " steps replayed" << std::endl;
+    std::cout << "time:        " << seconds << " s" << std::endl;
+    std::cout << "per cycle:   " << seconds / cycles * 1000 << " ms" << std::endl;
+    std::cout << "allocations: " << allocations << std::endl;
+
+    return 0;
+}
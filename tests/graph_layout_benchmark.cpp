@@ -0,0 +1,135 @@
+// Compares the array of structs and struct of arrays layouts of
+// denali::VectorDirectedGraphImplementation on a breadth-first search and
+// on Carr's algorithm over the same simplicial complex.
+//
+// usage: graph_layout_benchmark <vertex value file> <edge file> [repetitions]
+
+#include <ctime>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <denali/contour_tree.h>
+#include <denali/fileio.h>
+
+template <typename Graph>
+double timeBFS(
+    const denali::ScalarSimplicialComplexBase<Graph>& plex,
+    int repetitions,
+    size_t& visited)
+{
+    std::clock_t start = std::clock();
+    for (int i=0; i<repetitions; ++i) {
+        visited = 0;
+        denali::UndirectedBFSIterator<denali::ScalarSimplicialComplexBase<Graph> >
+            it(plex, plex.getNode(0));
+        for (; !it.done(); ++it) {
+            visited++;
+        }
+    }
+    return double(std::clock() - start) / CLOCKS_PER_SEC / repetitions;
+}
+
+
+template <typename Graph>
+double timeCarrsAlgorithm(
+    const denali::ScalarSimplicialComplexBase<Graph>& plex,
+    int repetitions,
+    size_t& tree_size)
+{
+    std::clock_t start = std::clock();
+    for (int i=0; i<repetitions; ++i) {
+        denali::UndirectedScalarMemberIDGraphBase<Graph> tree;
+        denali::CarrsAlgorithm().compute(plex, tree);
+        tree_size = tree.numberOfNodes();
+    }
+    return double(std::clock() - start) / CLOCKS_PER_SEC / repetitions;
+}
+
+
+template <typename Graph>
+void benchmark(
+    const char* name,
+    const std::vector<double>& values,
+    const std::vector<unsigned int>& edges,
+    int repetitions)
+{
+    denali::ScalarSimplicialComplexBase<Graph> plex;
+    plex.addNodes(&values[0], values.size());
+    plex.addEdges(edges.empty() ? 0 : &edges[0], edges.size() / 2);
+
+    size_t visited;
+    double bfs_time = timeBFS(plex, repetitions, visited);
+
+    size_t tree_size;
+    double carr_time = timeCarrsAlgorithm(plex, repetitions, tree_size);
+
+    std::cout << name << ": bfs " << bfs_time << " s (" << visited
+              << " edges), carr " << carr_time << " s (" << tree_size
+              << " tree nodes)" << std::endl;
+}
+
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3) {
+        std::cerr << "usage: graph_layout_benchmark <vertex value file> "
+                  << "<edge file> [repetitions]" << std::endl;
+        return 1;
+    }
+
+    int repetitions = argc > 3 ? atoi(argv[3]) : 3;
+    if (repetitions < 1) {
+        repetitions = 1;
+    }
+
+    // read the complex once, and build each layout from the same arrays
+    denali::CompactScalarSimplicialComplex plex;
+    try {
+        if (denali::isBinaryVertexFile(argv[1])) {
+            denali::readBinaryVertexFile(argv[1], plex);
+        } else {
+            denali::readSimplicialVertexFile(argv[1], plex);
+        }
+
+        if (denali::isBinaryEdgeFile(argv[2])) {
+            denali::readBinaryEdgeFile(argv[2], plex);
+        } else {
+            denali::readSimplicialEdgeFile(argv[2], plex);
+            plex.freeze();
+        }
+    }
+    catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (plex.numberOfNodes() == 0) {
+        std::cerr << "Error: the complex is empty." << std::endl;
+        return 1;
+    }
+
+    std::vector<double> values(plex.numberOfNodes());
+    for (size_t i=0; i<values.size(); ++i) {
+        values[i] = plex.getValue(plex.getNode(i));
+    }
+
+    std::vector<unsigned int> edges;
+    edges.reserve(2 * plex.numberOfEdges());
+    for (denali::EdgeIterator<denali::CompactScalarSimplicialComplex> it(plex);
+            !it.done(); ++it) {
+        edges.push_back(plex.getID(plex.u(it.edge())));
+        edges.push_back(plex.getID(plex.v(it.edge())));
+    }
+
+    std::cout << values.size() << " vertices, " << edges.size() / 2
+              << " edges, " << repetitions << " repetitions" << std::endl;
+
+    benchmark<denali::UndirectedGraph>(
+            "array of structs", values, edges, repetitions);
+
+    benchmark<denali::StructOfArraysUndirectedGraph>(
+            "struct of arrays", values, edges, repetitions);
+
+    return 0;
+}
@@ -1,6 +1,12 @@
 #include <UnitTest++.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
 
+#include <sstream>
 #include <string>
 #include <set>
 #include <vector>
@@ -9,16 +15,19 @@
 #include <denali/concepts/graph_attributes.h>
 #include <denali/concepts/contour_tree.h>
 #include <denali/concepts/landscape.h>
+#include <denali/compressed_members.h>
 #include <denali/fileio.h>
 #include <denali/graph_mixins.h>
 #include <denali/graph_maps.h>
 #include <denali/graph_iterators.h>
 #include <denali/graph_structures.h>
 #include <denali/contour_tree.h>
+#include <denali/external.h>
 #include <denali/landscape.h>
 #include <denali/rectangular_landscape.h>
 #include <denali/simplify.h>
 #include <denali/folded.h>
+#include <denali/snapshot.h>
 
 double wenger_vertex_values[] =
 // 0   1   2   3   4   5   6   7   8   9  10  11
@@ -57,6 +66,62 @@ void printContourTree(const ContourTree& tree)
 }
 
 
+/// Makes a random tree on `n_nodes` nodes with integer values, so that
+/// there are ties, and up to three members on each edge.
+boost::shared_ptr<denali::UndirectedScalarMemberIDGraph>
+makeRandomTree(size_t n_nodes, unsigned int seed)
+{
+    typedef denali::UndirectedScalarMemberIDGraph Graph;
+    boost::shared_ptr<Graph> graph(new Graph);
+
+    std::srand(seed);
+    std::vector<Graph::Node> nodes;
+    unsigned int member_id = n_nodes;
+
+    for (size_t i=0; i<n_nodes; ++i) {
+        nodes.push_back(graph->addNode(i, std::rand() % 100));
+
+        if (i > 0) {
+            Graph::Edge edge = graph->addEdge(nodes[i], nodes[std::rand() % i]);
+            for (int j = std::rand() % 4; j > 0; --j) {
+                graph->insertEdgeMember(edge,
+                        Graph::Member(member_id++, std::rand() % 100));
+            }
+        }
+    }
+
+    return graph;
+}
+
+
+/// The IDs and member counts of every node and edge in a folded tree.
+template <typename FoldedTree>
+std::set< std::vector<unsigned int> > foldedTreeSignature(const FoldedTree& tree)
+{
+    std::set< std::vector<unsigned int> > signature;
+
+    for (denali::NodeIterator<FoldedTree> it(tree); !it.done(); ++it) {
+        std::vector<unsigned int> node;
+        node.push_back(tree.getID(it.node()));
+        node.push_back(tree.getNodeMembers(it.node()).size());
+        signature.insert(node);
+    }
+
+    for (denali::EdgeIterator<FoldedTree> it(tree); !it.done(); ++it) {
+        unsigned int u = tree.getID(tree.u(it.edge()));
+        unsigned int v = tree.getID(tree.v(it.edge()));
+
+        std::vector<unsigned int> edge;
+        edge.push_back(std::min(u,v));
+        edge.push_back(std::max(u,v));
+        edge.push_back(tree.getEdgeMembers(it.edge()).size());
+        signature.insert(edge);
+    }
+
+    return signature;
+}
+
+
 TEST(Mixins)
 {
     denali::concepts::checkConcept
@@ -153,10 +218,9 @@ SUITE(GraphStructures)
 
     }
 
-    TEST(DirectedGraph)
+    template <typename Graph>
+    void checkDirectedGraph()
     {
-        typedef denali::DirectedGraph Graph;
-
         denali::concepts::checkConcept
         <
         denali::concepts::WritableReadableDirectedGraph,
@@ -182,30 +246,30 @@ SUITE(GraphStructures)
         > ();
 
         Graph graph;
-        Graph::Node n1 = graph.addNode();
-        Graph::Node n2 = graph.addNode();
-        Graph::Node n3 = graph.addNode();
-        Graph::Node n4 = graph.addNode();
-        Graph::Node n5 = graph.addNode();
+        typename Graph::Node n1 = graph.addNode();
+        typename Graph::Node n2 = graph.addNode();
+        typename Graph::Node n3 = graph.addNode();
+        typename Graph::Node n4 = graph.addNode();
+        typename Graph::Node n5 = graph.addNode();
 
         CHECK(graph.isNodeValid(n1));
         CHECK(graph.isNodeValid(n5));
 
-        Graph::Arc a12 = graph.addArc(n1, n2);
+        typename Graph::Arc a12 = graph.addArc(n1, n2);
         graph.addArc(n1, n3);
 
         CHECK(graph.isArcValid(a12));
 
-        Graph::Node first_node = graph.getFirstNode();
+        typename Graph::Node first_node = graph.getFirstNode();
         CHECK(graph.isNodeValid(first_node));
 
-        Graph::Node next_node = graph.getNextNode(first_node);
+        typename Graph::Node next_node = graph.getNextNode(first_node);
         CHECK(graph.isNodeValid(next_node));
 
-        Graph::Arc first_arc = graph.getFirstArc();
+        typename Graph::Arc first_arc = graph.getFirstArc();
         CHECK(graph.isArcValid(first_arc));
 
-        Graph::Arc next_arc = graph.getNextArc(first_arc);
+        typename Graph::Arc next_arc = graph.getNextArc(first_arc);
         CHECK(graph.isArcValid(next_arc));
 
         CHECK_EQUAL((size_t) 2, graph.degree(n1));
@@ -241,8 +305,8 @@ SUITE(GraphStructures)
             CHECK_EQUAL(42, node_map[it.node()]);
         }
 
-        Graph::Node n6 = graph.addNode();
-        Graph::Arc a23 = graph.addArc(n2,n3);
+        typename Graph::Node n6 = graph.addNode();
+        typename Graph::Arc a23 = graph.addArc(n2,n3);
         graph.addArc(n3,n4);
         graph.addArc(n4,n5);
 
@@ -293,13 +357,20 @@ SUITE(GraphStructures)
 
     }
 
+    TEST(DirectedGraph)
+    {
+        checkDirectedGraph<denali::DirectedGraph>();
+    }
 
-
-    TEST(UndirectedGraph)
+    TEST(StructOfArraysDirectedGraph)
     {
+        checkDirectedGraph<denali::StructOfArraysDirectedGraph>();
+    }
 
-        typedef denali::UndirectedGraph Graph;
 
+    template <typename Graph>
+    void checkUndirectedGraph()
+    {
         denali::concepts::checkConcept
         <
         denali::concepts::WritableReadableUndirectedGraph,
@@ -323,11 +394,11 @@ SUITE(GraphStructures)
                > ();
 
         Graph graph;
-        Graph::Node n1 = graph.addNode();
-        Graph::Node n2 = graph.addNode();
-        Graph::Node n3 = graph.addNode();
+        typename Graph::Node n1 = graph.addNode();
+        typename Graph::Node n2 = graph.addNode();
+        typename Graph::Node n3 = graph.addNode();
         graph.addNode();
-        Graph::Node n5 = graph.addNode();
+        typename Graph::Node n5 = graph.addNode();
 
         CHECK(graph.isNodeValid(n1));
         CHECK(graph.isNodeValid(n5));
@@ -339,6 +410,285 @@ SUITE(GraphStructures)
         CHECK(!graph.isEdgeValid(graph.findEdge(n3,n1)));
     }
 
+    TEST(UndirectedGraph)
+    {
+        checkUndirectedGraph<denali::UndirectedGraph>();
+    }
+
+    TEST(StructOfArraysUndirectedGraph)
+    {
+        checkUndirectedGraph<denali::StructOfArraysUndirectedGraph>();
+    }
+
+
+    TEST(Compact)
+    {
+        typedef denali::UndirectedGraph Graph;
+
+        Graph graph;
+        denali::ObservingNodeMap<Graph, int> node_ids(graph);
+        denali::ObservingEdgeMap<Graph, std::vector<int> > edge_lists(graph);
+
+        std::vector<Graph::Node> nodes;
+        for (int i=0; i<10; ++i) {
+            nodes.push_back(graph.addNode());
+            node_ids[nodes[i]] = i;
+        }
+
+        for (int i=1; i<10; ++i) {
+            Graph::Edge edge = graph.addEdge(nodes[i-1], nodes[i]);
+            edge_lists[edge].push_back(i);
+        }
+
+        // remove every other node, leaving only the odd ones
+        for (int i=0; i<10; i+=2) {
+            graph.removeNode(nodes[i]);
+        }
+        Graph::Edge edge = graph.addEdge(nodes[1], nodes[9]);
+        edge_lists[edge].assign(1, 42);
+
+        std::vector<int> order;
+        for (denali::NodeIterator<Graph> it(graph); !it.done(); ++it) {
+            order.push_back(node_ids[it.node()]);
+        }
+
+        graph.compact();
+
+        CHECK_EQUAL(5u, graph.numberOfNodes());
+        CHECK_EQUAL(5u, graph.getMaxNodeIdentifier());
+        CHECK_EQUAL(1u, graph.numberOfEdges());
+        CHECK_EQUAL(1u, graph.getMaxEdgeIdentifier());
+
+        // the nodes are renumbered in iteration order, and keep their values
+        size_t i = 0;
+        for (denali::NodeIterator<Graph> it(graph); !it.done(); ++it, ++i) {
+            CHECK_EQUAL(i, (size_t) graph.getNodeIdentifier(it.node()));
+            CHECK_EQUAL(order[i], node_ids[it.node()]);
+        }
+
+        edge = graph.getFirstEdge();
+        CHECK_EQUAL((size_t) 1, edge_lists[edge].size());
+        CHECK_EQUAL(42, edge_lists[edge][0]);
+        CHECK_EQUAL(1, node_ids[graph.u(edge)]);
+        CHECK_EQUAL(9, node_ids[graph.v(edge)]);
+
+        // the graph can grow again
+        Graph::Node node = graph.addNode();
+        node_ids[node] = 10;
+        CHECK_EQUAL(5u, graph.getNodeIdentifier(node));
+    }
+
+
+    TEST(HideAndShow)
+    {
+        typedef denali::UndirectedGraph Graph;
+
+        Graph graph;
+        denali::ObservingNodeMap<Graph, int> node_ids(graph);
+
+        // a path of five nodes
+        std::vector<Graph::Node> nodes;
+        for (int i=0; i<5; ++i) {
+            nodes.push_back(graph.addNode());
+            node_ids[nodes[i]] = i;
+        }
+
+        std::vector<Graph::Edge> edges;
+        for (int i=1; i<5; ++i) {
+            edges.push_back(graph.addEdge(nodes[i-1], nodes[i]));
+        }
+
+        // hiding a node hides its edges, but keeps their slots
+        graph.hideNode(nodes[2]);
+        CHECK(!graph.isNodeValid(nodes[2]));
+        CHECK(!graph.isEdgeValid(edges[1]));
+        CHECK(!graph.isEdgeValid(edges[2]));
+        CHECK_EQUAL(4u, graph.numberOfNodes());
+        CHECK_EQUAL(2u, graph.numberOfEdges());
+        CHECK_EQUAL(1u, graph.degree(nodes[1]));
+
+        // new nodes don't take the hidden slot
+        Graph::Node node = graph.addNode();
+        CHECK(node != nodes[2]);
+        graph.removeNode(node);
+
+        // an edge can be shown between other nodes than before
+        graph.hideEdge(edges[0]);
+        graph.showEdge(edges[0], nodes[1], nodes[3]);
+        CHECK(graph.findEdge(nodes[1], nodes[3]) == edges[0]);
+        CHECK_EQUAL(0u, graph.degree(nodes[0]));
+        CHECK_EQUAL(2u, graph.degree(nodes[3]));
+
+        graph.hideEdge(edges[0]);
+        graph.showNode(nodes[2]);
+        graph.showEdge(edges[0], nodes[0], nodes[1]);
+        graph.showEdge(edges[1], nodes[1], nodes[2]);
+        graph.showEdge(edges[2], nodes[2], nodes[3]);
+        CHECK_EQUAL(5u, graph.numberOfNodes());
+        CHECK_EQUAL(4u, graph.numberOfEdges());
+        CHECK_EQUAL(2, node_ids[nodes[2]]);
+        CHECK(graph.findEdge(nodes[2], nodes[3]) == edges[2]);
+
+        // compacting releases the slots of hidden nodes and edges
+        graph.hideNode(nodes[4]);
+        graph.compact();
+        CHECK_EQUAL(4u, graph.getMaxNodeIdentifier());
+        CHECK_EQUAL(3u, graph.getMaxEdgeIdentifier());
+
+        std::vector<int> ids;
+        for (denali::NodeIterator<Graph> it(graph); !it.done(); ++it) {
+            ids.push_back(node_ids[it.node()]);
+        }
+        std::sort(ids.begin(), ids.end());
+        CHECK_EQUAL(4u, ids.size());
+        CHECK_EQUAL(3, ids.back());
+    }
+
+
+    TEST(LazyMaps)
+    {
+        typedef denali::UndirectedGraph Graph;
+
+        Graph graph;
+        denali::LazyNodeMap<Graph, int> node_ids(graph);
+        denali::LazyEdgeMap<Graph, std::vector<int> > edge_lists(graph);
+        node_ids.reserve(10);
+        edge_lists.reserve(9);
+
+        // the maps grow as they are written to
+        std::vector<Graph::Node> nodes;
+        for (int i=0; i<10; ++i) {
+            nodes.push_back(graph.addNode());
+            node_ids[nodes[i]] = i;
+        }
+
+        for (int i=1; i<10; ++i) {
+            Graph::Edge edge = graph.addEdge(nodes[i-1], nodes[i]);
+            edge_lists[edge].push_back(i);
+        }
+
+        // and read back as default values where nothing was written
+        Graph::Node unwritten = graph.addNode();
+        CHECK_EQUAL(0, node_ids[unwritten]);
+        graph.removeNode(unwritten);
+
+        for (int i=0; i<10; i+=2) {
+            graph.removeNode(nodes[i]);
+        }
+
+        std::vector<int> order;
+        for (denali::NodeIterator<Graph> it(graph); !it.done(); ++it) {
+            order.push_back(node_ids[it.node()]);
+        }
+
+        unsigned int generation = graph.getGeneration();
+        graph.compact();
+        CHECK_EQUAL(generation + 1, graph.getGeneration());
+
+        // the maps weren't told of the compaction, so they refuse to be read
+        CHECK_THROW(node_ids[graph.getFirstNode()], std::runtime_error);
+
+        // until they are remapped, here by rebuilding the identifiers
+        std::vector<int> new_ids(10, -1);
+        for (size_t i=0; i<order.size(); ++i) {
+            new_ids[order[i]] = i;
+        }
+        node_ids.remap(new_ids);
+
+        size_t i = 0;
+        for (denali::NodeIterator<Graph> it(graph); !it.done(); ++it, ++i) {
+            CHECK_EQUAL(order[i], node_ids[it.node()]);
+        }
+
+        edge_lists.remap(std::vector<int>());
+        CHECK_EQUAL(0u, graph.numberOfEdges());
+
+        Graph::Node node = graph.addNode();
+        node_ids[node] = 10;
+        CHECK_EQUAL(10, node_ids[node]);
+    }
+
+
+    struct NotificationCounter : public denali::UndirectedGraph::Observer
+    {
+        denali::UndirectedGraph& graph;
+        int notifications;
+
+        NotificationCounter(denali::UndirectedGraph& graph)
+            : graph(graph), notifications(0)
+        {
+            graph.attachNodeObserver(*this);
+        }
+
+        ~NotificationCounter()
+        {
+            graph.detachNodeObserver(*this);
+        }
+
+        void notify()
+        {
+            notifications++;
+        }
+    };
+
+
+    TEST(GraphBatch)
+    {
+        typedef denali::UndirectedGraph Graph;
+
+        Graph graph;
+        NotificationCounter counter(graph);
+        denali::ObservingNodeMap<Graph, int> node_ids(graph);
+
+        std::vector<Graph::Node> nodes;
+        graph.addNodes(100, std::back_inserter(nodes));
+
+        // the observers hear about the nodes once, and are sized correctly
+        CHECK_EQUAL(1, counter.notifications);
+        CHECK_EQUAL((size_t) 100, nodes.size());
+        CHECK_EQUAL(100u, graph.numberOfNodes());
+
+        for (size_t i=0; i<nodes.size(); ++i) {
+            node_ids[nodes[i]] = i;
+        }
+
+        std::vector<std::pair<Graph::Node, Graph::Node> > edges;
+        for (size_t i=1; i<nodes.size(); ++i) {
+            edges.push_back(std::make_pair(nodes[i-1], nodes[i]));
+        }
+        graph.addEdges(edges.begin(), edges.end());
+
+        CHECK_EQUAL(99u, graph.numberOfEdges());
+        CHECK(graph.isEdgeValid(graph.findEdge(nodes[41], nodes[42])));
+
+        // nested batches notify once, when the outermost one ends
+        {
+            denali::GraphBatch<Graph> outer(graph);
+            graph.addNode();
+            {
+                denali::GraphBatch<Graph> inner(graph);
+                graph.addNode();
+            }
+            CHECK_EQUAL(1, counter.notifications);
+        }
+        CHECK_EQUAL(2, counter.notifications);
+
+        // without a batch, every node is announced
+        graph.addNode();
+        CHECK_EQUAL(3, counter.notifications);
+
+        CHECK_EQUAL(42, node_ids[nodes[42]]);
+
+        // reserving a little more at a time doubles the capacity
+        std::vector<int> values;
+        denali::reserveGeometrically(values, 100);
+        CHECK_EQUAL((size_t) 100, values.capacity());
+        denali::reserveGeometrically(values, 110);
+        CHECK_EQUAL((size_t) 200, values.capacity());
+        denali::reserveGeometrically(values, 150);
+        CHECK_EQUAL((size_t) 200, values.capacity());
+    }
+
 
     TEST(UndirectedBFSIterator)
     {
@@ -373,6 +723,114 @@ SUITE(GraphStructures)
         }
         */
 
+        std::vector<int> full_order;
+        for (denali::UndirectedBFSIterator<Graph> it(graph, nodes[0]);
+                !it.done(); ++it) {
+            full_order.push_back(node_ids[it.child()]);
+        }
+        // node 10 is isolated
+        CHECK_EQUAL((size_t) 11, full_order.size());
+
+        std::vector<int> partial_order;
+        for (denali::UndirectedBFSIterator<Graph> it(graph, nodes[0], nodes[2]);
+                !it.done(); ++it) {
+            partial_order.push_back(node_ids[it.child()]);
+        }
+        CHECK_EQUAL((size_t) 5, partial_order.size());
+
+        // a reused workspace gives the same searches
+        denali::UndirectedBFSIterator<Graph>::Workspace workspace;
+        for (int repetition=0; repetition<3; ++repetition)
+        {
+            std::vector<int> order;
+            for (denali::UndirectedBFSIterator<Graph> it(graph, nodes[0], workspace);
+                    !it.done(); ++it) {
+                order.push_back(node_ids[it.child()]);
+            }
+            CHECK(full_order == order);
+
+            order.clear();
+            for (denali::UndirectedBFSIterator<Graph> it(
+                        graph, nodes[0], nodes[2], workspace);
+                    !it.done(); ++it) {
+                order.push_back(node_ids[it.child()]);
+            }
+            CHECK(partial_order == order);
+        }
+    }
+
+    TEST(RingQueue)
+    {
+        denali::RingQueue<int> queue;
+        int next_in = 0;
+        int next_out = 0;
+
+        // interleave pushes and pops so that the queue wraps as it grows
+        for (int round=0; round<50; ++round) {
+            for (int i=0; i<round % 7 + 2; ++i) {
+                queue.push(next_in++);
+            }
+            for (int i=0; i<round % 5 + 1 && !queue.empty(); ++i) {
+                CHECK_EQUAL(next_out++, queue.front());
+                queue.pop();
+            }
+        }
+
+        CHECK_EQUAL((size_t) (next_in - next_out), queue.size());
+        while (!queue.empty()) {
+            CHECK_EQUAL(next_out++, queue.front());
+            queue.pop();
+        }
+
+        queue.push(42);
+        queue.clear();
+        CHECK(queue.empty());
+    }
+
+    TEST(ConnectedComponents)
+    {
+        typedef denali::UndirectedGraph Graph;
+
+        Graph graph;
+        std::vector<Graph::Node> nodes;
+        for (int i=0; i<10; ++i) {
+            nodes.push_back(graph.addNode());
+        }
+
+        // {0, 5, 9}, {1, 2, 3, 4}, {6}, {8}, and 7 is removed
+        unsigned int edges[][2] =
+        {   {0,5}, {9,5}, {4,2}, {1,3}, {3,2}, {7,8}
+        };
+
+        for (size_t i=0; i<6; ++i) {
+            graph.addEdge(nodes[edges[i][0]], nodes[edges[i][1]]);
+        }
+        graph.removeNode(nodes[7]);
+
+        CHECK(!denali::isConnected(graph));
+
+        std::vector<unsigned int> labels;
+        CHECK_EQUAL(4u, denali::labelConnectedComponents(graph, labels));
+
+        unsigned int expected[] = {0, 1, 1, 1, 1, 0, 2, (unsigned int) -1, 3, 0};
+        for (int i=0; i<10; ++i) {
+            CHECK_EQUAL(expected[i], labels[i]);
+        }
+
+        // splitting the nodes between threads gives the same labels
+        for (unsigned int n_threads=2; n_threads<=4; ++n_threads) {
+            std::vector<unsigned int> threaded_labels;
+            CHECK_EQUAL(4u, denali::labelConnectedComponents(
+                    graph, threaded_labels, n_threads));
+            CHECK(labels == threaded_labels);
+        }
+
+        graph.addEdge(nodes[0], nodes[1]);
+        graph.addEdge(nodes[6], nodes[9]);
+        graph.addEdge(nodes[8], nodes[2]);
+        CHECK(denali::isConnected(graph));
+
+        CHECK(denali::isConnected(Graph()));
     }
 }
 
@@ -402,6 +860,76 @@ SUITE(ContourTree)
 
         CHECK_EQUAL((size_t) n_wenger_vertices, plex.numberOfNodes());
         CHECK_EQUAL((size_t) n_wenger_edges, plex.numberOfEdges());
+
+        // the same complex, built in bulk
+        denali::ScalarSimplicialComplex bulk;
+        bulk.addNodes(wenger_vertex_values, n_wenger_vertices);
+        bulk.addEdges(&wenger_edges[0][0], n_wenger_edges);
+
+        CHECK_EQUAL((size_t) n_wenger_vertices, bulk.numberOfNodes());
+        CHECK_EQUAL((size_t) n_wenger_edges, bulk.numberOfEdges());
+
+        for (size_t i=0; i<n_wenger_vertices; ++i) {
+            CHECK_EQUAL(wenger_vertex_values[i], bulk.getValue(bulk.getNode(i)));
+            CHECK_EQUAL((unsigned int) i, bulk.getID(bulk.getNode(i)));
+        }
+
+        unsigned int bad_edge[] = {0, n_wenger_vertices};
+        CHECK_THROW(bulk.addEdges(bad_edge, 1), std::runtime_error);
+    }
+
+    TEST(CompactScalarSimplicialComplex)
+    {
+        denali::concepts::checkConcept
+        <
+        denali::concepts::ScalarSimplicialComplex,
+               denali::CompactScalarSimplicialComplex
+               > ();
+
+        denali::ScalarSimplicialComplex plex;
+        denali::CompactScalarSimplicialComplex compact;
+
+        for (size_t i=0; i<n_wenger_vertices; ++i) {
+            plex.addNode(wenger_vertex_values[i]);
+            compact.addNode(wenger_vertex_values[i]);
+        }
+
+        for (size_t i=0; i<n_wenger_edges; ++i) {
+            plex.addEdge(
+                plex.getNode(wenger_edges[i][0]),
+                plex.getNode(wenger_edges[i][1]));
+            compact.addEdge(
+                compact.getNode(wenger_edges[i][0]),
+                compact.getNode(wenger_edges[i][1]));
+        }
+
+        compact.freeze();
+
+        CHECK_EQUAL((size_t) n_wenger_vertices, compact.numberOfNodes());
+        CHECK_EQUAL((size_t) n_wenger_edges, compact.numberOfEdges());
+
+        // neighbors are visited in the same order as in the general complex
+        typedef denali::CompactScalarSimplicialComplex Compact;
+        typedef denali::ScalarSimplicialComplex Plex;
+        for (size_t i=0; i<n_wenger_vertices; ++i)
+        {
+            Plex::Node node = plex.getNode(i);
+            Compact::Node compact_node = compact.getNode(i);
+
+            CHECK_EQUAL(plex.degree(node), compact.degree(compact_node));
+            CHECK_EQUAL(plex.getValue(node), compact.getValue(compact_node));
+
+            denali::UndirectedNeighborIterator<Plex> it(plex, node);
+            denali::UndirectedNeighborIterator<Compact> compact_it(compact, compact_node);
+            for (; !it.done() && !compact_it.done(); ++it, ++compact_it)
+            {
+                CHECK_EQUAL(plex.getID(it.neighbor()),
+                            compact.getID(compact_it.neighbor()));
+                CHECK_EQUAL(compact.getID(compact_it.neighbor()),
+                            compact.getID(compact.opposite(compact_node, compact_it.edge())));
+            }
+            CHECK(it.done() && compact_it.done());
+        }
     }
 
     TEST(UndirectedScalarMemberIDGraph)
@@ -414,6 +942,27 @@ SUITE(ContourTree)
 
         typedef denali::UndirectedScalarMemberIDGraph Graph;
         Graph graph;
+
+        // dense IDs
+        for (unsigned int i=0; i<100; ++i) {
+            graph.addNode(i, i);
+        }
+
+        CHECK_EQUAL(42u, graph.getID(graph.getNode(42)));
+        CHECK(!graph.isNodeValid(graph.getNode(100)));
+
+        graph.removeNode(graph.getNode(42));
+        CHECK(!graph.isNodeValid(graph.getNode(42)));
+
+        // a sparse ID forces the switch to hashing
+        Graph::Node far = graph.addNode(4000000000u, 1);
+        CHECK(far == graph.getNode(4000000000u));
+        CHECK_EQUAL(7u, graph.getID(graph.getNode(7)));
+        CHECK(!graph.isNodeValid(graph.getNode(42)));
+
+        graph.clear();
+        CHECK(!graph.isNodeValid(graph.getNode(7)));
+        CHECK(!graph.isNodeValid(graph.getNode(4000000000u)));
     }
 
     TEST(TotalOrder)
@@ -425,6 +974,39 @@ SUITE(ContourTree)
                > ();
     }
 
+    TEST(TotalOrderParallel)
+    {
+        // many repeated values, so that ties must be broken consistently
+        std::vector<double> values(100000);
+        for (size_t i=0; i<values.size(); ++i) {
+            values[i] = (i * 7919) % 1013;
+        }
+
+        denali::RandomAccessValueSorter<std::vector<double> > sorter(values);
+
+        denali::TotalOrder serial = denali::TotalOrder::compute(values, sorter, 1);
+
+        for (unsigned int n_threads=2; n_threads<=5; ++n_threads)
+        {
+            denali::TotalOrder parallel =
+                denali::TotalOrder::compute(values, sorter, n_threads);
+
+            bool same = true;
+            for (size_t i=0; i<values.size(); ++i) {
+                same = same && (serial.positionToElement(i) == parallel.positionToElement(i));
+                same = same && (serial.elementToPosition(i) == parallel.elementToPosition(i));
+            }
+            CHECK(same);
+        }
+
+        // ties are broken by index
+        for (size_t i=1; i<values.size(); ++i) {
+            unsigned int u = serial.positionToElement(i-1);
+            unsigned int v = serial.positionToElement(i);
+            CHECK(values[u] < values[v] || (values[u] == values[v] && u < v));
+        }
+    }
+
     TEST(CarrsAlgorithm)
     {
         denali::concepts::checkConcept
@@ -452,15 +1034,8 @@ SUITE(ContourTree)
 
     }
 
-    TEST(ContourTree)
+    TEST(CarrsAlgorithmThreaded)
     {
-        denali::concepts::checkConcept
-        <
-        denali::concepts::ContourTree,
-               denali::ContourTree
-               > ();
-
-
         denali::ScalarSimplicialComplex plex;
 
         for (size_t i=0; i<n_wenger_vertices; ++i) {
@@ -473,67 +1048,574 @@ SUITE(ContourTree)
                 plex.getNode(wenger_edges[i][1]));
         }
 
-        denali::CarrsAlgorithm alg;
-        denali::ContourTree tree =
-            denali::ContourTree::compute(plex, alg);
+        typedef denali::UndirectedScalarMemberIDGraph Graph;
 
+        denali::CarrsAlgorithm serial_alg;
+        Graph serial_graph;
+        serial_alg.compute(plex, serial_graph);
+
+        denali::CarrsAlgorithm threaded_alg;
+        threaded_alg.setNumberOfThreads(2);
+        Graph threaded_graph;
+        threaded_alg.compute(plex, threaded_graph);
+
+        // the trees should be identical, down to the order of the edges
+        CHECK_EQUAL(serial_graph.numberOfEdges(), threaded_graph.numberOfEdges());
+
+        denali::EdgeIterator<Graph> serial_it(serial_graph);
+        denali::EdgeIterator<Graph> threaded_it(threaded_graph);
+        for (; !serial_it.done() && !threaded_it.done(); ++serial_it, ++threaded_it)
+        {
+            CHECK_EQUAL(serial_graph.getID(serial_graph.u(serial_it.edge())),
+                        threaded_graph.getID(threaded_graph.u(threaded_it.edge())));
+            CHECK_EQUAL(serial_graph.getID(serial_graph.v(serial_it.edge())),
+                        threaded_graph.getID(threaded_graph.v(threaded_it.edge())));
+            CHECK_EQUAL(serial_graph.getEdgeMembers(serial_it.edge()).size(),
+                        threaded_graph.getEdgeMembers(threaded_it.edge()).size());
+        }
     }
 
-}
-
-
-SUITE(Landscape)
-{
-
-    TEST(LandscapeTree)
+    TEST(RemoveRegularNodes)
     {
-        denali::ScalarSimplicialComplex plex;
+        /*
+                7   8
+                |   |
+                6   |
+                |   |
+                5   |
+                 \ /
+                  4
+                  |
+                  3
+                  |
+                  2
+                  |
+                  1
+                  |
+                  0
+        */
+        // 1, 2 and 3 are a chain between two critical nodes, and 5 and 6
+        // a chain ending at a leaf. The edge from 5 to 6 carries member 9
+        typedef denali::UndirectedScalarMemberIDGraph Graph;
+        typedef Graph::Node Node;
+        typedef Graph::Members Members;
 
-        for (size_t i=0; i<n_wenger_vertices; ++i) {
-            plex.addNode(wenger_vertex_values[i]);
+        std::vector<double> values;
+        for (unsigned int i=0; i<9; ++i) {
+            values.push_back(i);
         }
+        values.push_back(5.5);
 
-        for (size_t i=0; i<n_wenger_edges; ++i) {
-            plex.addEdge(
-                plex.getNode(wenger_edges[i][0]),
-                plex.getNode(wenger_edges[i][1]));
+        denali::RandomAccessValueSorter<std::vector<double> > sorter(values);
+        denali::TotalOrder order = denali::TotalOrder::compute(values, sorter);
+
+        Graph graph;
+        std::vector<Node> nodes;
+        for (unsigned int i=0; i<9; ++i) {
+            nodes.push_back(graph.addNode(i, values[i]));
         }
 
-        denali::CarrsAlgorithm alg;
-        denali::ContourTree tree =
-            denali::ContourTree::compute(plex, alg);
+        graph.addEdge(nodes[0], nodes[1]);
+        graph.addEdge(nodes[1], nodes[2]);
+        graph.addEdge(nodes[2], nodes[3]);
+        graph.addEdge(nodes[3], nodes[4]);
+        graph.addEdge(nodes[4], nodes[5]);
+        graph.insertEdgeMember(graph.addEdge(nodes[5], nodes[6]),
+                               Graph::Member(9, values[9]));
+        graph.addEdge(nodes[6], nodes[7]);
+        graph.addEdge(nodes[4], nodes[8]);
+
+        denali::CarrsAlgorithm::removeRegularNodes(graph, order);
+
+        CHECK_EQUAL((size_t) 4, graph.numberOfNodes());
+        CHECK_EQUAL((size_t) 3, graph.numberOfEdges());
+
+        // the members of each edge at 4, by the ID of its other end
+        std::map<unsigned int, std::set<unsigned int> > members;
+        for (denali::UndirectedNeighborIterator<Graph> it(graph, graph.getNode(4));
+                !it.done(); ++it)
+        {
+            std::set<unsigned int>& ids = members[graph.getID(it.neighbor())];
+            const Members& edge_members = graph.getEdgeMembers(it.edge());
+            for (Members::const_iterator m_it = edge_members.begin();
+                    m_it != edge_members.end(); ++m_it) {
+                ids.insert(m_it->getID());
+            }
+            CHECK_EQUAL(edge_members.size(), ids.size());
+        }
 
-        denali::LandscapeTree<denali::ContourTree> lscape(tree, tree.getNode(4));
+        CHECK_EQUAL((size_t) 3, members.size());
 
-        denali::LandscapeWeights<denali::LandscapeTree<denali::ContourTree> > weights(lscape);
+        std::set<unsigned int> lower;
+        lower.insert(1);
+        lower.insert(2);
+        lower.insert(3);
+        CHECK(members[0] == lower);
 
-        CHECK_EQUAL(12, weights.getTotalNodeWeight(lscape.getRoot()));
+        std::set<unsigned int> upper;
+        upper.insert(5);
+        upper.insert(6);
+        upper.insert(9);
+        CHECK(members[7] == upper);
 
+        CHECK(members[8].empty());
     }
-}
 
-SUITE(RectangularLandscape)
-{
-    TEST(RectangularLandscape)
+    TEST(ExternalCarrsAlgorithm)
     {
         denali::ScalarSimplicialComplex plex;
 
+        // a tiny memory limit, so that the edges are spilled into several runs
+        denali::ExternalScalarSimplicialComplex external(".", 64);
+
         for (size_t i=0; i<n_wenger_vertices; ++i) {
             plex.addNode(wenger_vertex_values[i]);
+            external.addNode(wenger_vertex_values[i]);
         }
 
         for (size_t i=0; i<n_wenger_edges; ++i) {
             plex.addEdge(
                 plex.getNode(wenger_edges[i][0]),
                 plex.getNode(wenger_edges[i][1]));
+            external.addEdge(
+                external.getNode(wenger_edges[i][0]),
+                external.getNode(wenger_edges[i][1]));
         }
 
-        denali::CarrsAlgorithm alg;
-        denali::ContourTree tree =
-            denali::ContourTree::compute(plex, alg);
+        external.freeze();
 
-        typedef denali::RectangularLandscape<denali::ContourTree> RectangularLandscape;
-        RectangularLandscape rlscape(tree, tree.getNode(4));
+        typedef denali::UndirectedScalarMemberIDGraph Graph;
+
+        denali::CarrsAlgorithm alg;
+        Graph graph;
+        alg.compute(plex, graph);
+
+        denali::ExternalCarrsAlgorithm external_alg;
+        Graph external_graph;
+        external_alg.compute(external, external_graph);
+
+        // the trees should be identical, down to the order of the edges
+        CHECK_EQUAL(graph.numberOfEdges(), external_graph.numberOfEdges());
+
+        denali::EdgeIterator<Graph> it(graph);
+        denali::EdgeIterator<Graph> external_it(external_graph);
+        for (; !it.done() && !external_it.done(); ++it, ++external_it)
+        {
+            CHECK_EQUAL(graph.getID(graph.u(it.edge())),
+                        external_graph.getID(external_graph.u(external_it.edge())));
+            CHECK_EQUAL(graph.getID(graph.v(it.edge())),
+                        external_graph.getID(external_graph.v(external_it.edge())));
+            CHECK_EQUAL(graph.getEdgeMembers(it.edge()).size(),
+                        external_graph.getEdgeMembers(external_it.edge()).size());
+        }
+    }
+
+    TEST(ContourTree)
+    {
+        denali::concepts::checkConcept
+        <
+        denali::concepts::ContourTree,
+               denali::ContourTree
+               > ();
+
+
+        denali::ScalarSimplicialComplex plex;
+
+        for (size_t i=0; i<n_wenger_vertices; ++i) {
+            plex.addNode(wenger_vertex_values[i]);
+        }
+
+        for (size_t i=0; i<n_wenger_edges; ++i) {
+            plex.addEdge(
+                plex.getNode(wenger_edges[i][0]),
+                plex.getNode(wenger_edges[i][1]));
+        }
+
+        denali::CarrsAlgorithm alg;
+        denali::ContourTree tree =
+            denali::ContourTree::compute(plex, alg);
+
+    }
+
+    TEST(BridgeComponents)
+    {
+        // two copies of the wenger complex, the second shifted up by 100
+        denali::CompactScalarSimplicialComplex plex;
+
+        for (size_t copy=0; copy<2; ++copy) {
+            for (size_t i=0; i<n_wenger_vertices; ++i) {
+                plex.addNode(wenger_vertex_values[i] + 100*copy);
+            }
+        }
+
+        for (size_t copy=0; copy<2; ++copy) {
+            for (size_t i=0; i<n_wenger_edges; ++i) {
+                plex.addEdge(
+                    plex.getNode(wenger_edges[i][0] + n_wenger_vertices*copy),
+                    plex.getNode(wenger_edges[i][1] + n_wenger_vertices*copy));
+            }
+        }
+
+        plex.freeze();
+
+        std::vector<unsigned int> labels;
+        unsigned int n_components = denali::labelConnectedComponents(plex, labels);
+        CHECK_EQUAL(2u, n_components);
+
+        denali::CompactScalarSimplicialComplex::Node root =
+            denali::bridgeComponents(plex, labels, n_components);
+        plex.freeze();
+
+        CHECK_EQUAL(2*n_wenger_vertices, plex.getID(root));
+        CHECK_EQUAL(2*n_wenger_edges + 2, plex.numberOfEdges());
+        CHECK(denali::isConnected(plex));
+
+        // the minimum, 16, less the range of values, 166 - 16
+        CHECK_EQUAL(-134., plex.getValue(root));
+
+        denali::CarrsAlgorithm alg;
+        denali::ContourTree tree = denali::ContourTree::compute(plex, alg);
+
+        // each copy's tree has 9 nodes, but its minimum is no longer a leaf
+        CHECK_EQUAL(17u, tree.numberOfNodes());
+        CHECK_EQUAL(2u, tree.degree(tree.getNode(plex.getID(root))));
+    }
+
+    // the IDs of the members in the subtree of a ContourTree, found by BFS
+    std::vector<unsigned int> subtreeMemberIDs(
+            const denali::ContourTree& tree,
+            denali::ContourTree::Node parent,
+            denali::ContourTree::Node pivot)
+    {
+        typedef denali::ContourTree::Members Members;
+        std::vector<unsigned int> ids;
+
+        const Members& pivot_members = tree.getNodeMembers(pivot);
+        const Members& edge_members = tree.getEdgeMembers(tree.findEdge(parent, pivot));
+        for (size_t i=0; i<pivot_members.size(); ++i) {
+            ids.push_back(pivot_members[i].getID());
+        }
+        for (size_t i=0; i<edge_members.size(); ++i) {
+            ids.push_back(edge_members[i].getID());
+        }
+
+        for (denali::UndirectedBFSIterator<denali::ContourTree> it(tree, parent, pivot);
+                !it.done(); ++it)
+        {
+            const Members& node_members = tree.getNodeMembers(it.child());
+            const Members& edge_members = tree.getEdgeMembers(it.edge());
+            for (size_t i=0; i<node_members.size(); ++i) {
+                ids.push_back(node_members[i].getID());
+            }
+            for (size_t i=0; i<edge_members.size(); ++i) {
+                ids.push_back(edge_members[i].getID());
+            }
+        }
+
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    std::vector<unsigned int> subtreeMemberIDs(
+            const denali::ContourTreeSnapshot& snapshot,
+            denali::ContourTreeSnapshot::Node parent,
+            denali::ContourTreeSnapshot::Node pivot)
+    {
+        std::vector<denali::ContourTreeSnapshot::Member> members;
+        snapshot.getSubtreeMembers(parent, pivot, std::back_inserter(members));
+
+        std::vector<unsigned int> ids;
+        for (size_t i=0; i<members.size(); ++i) {
+            ids.push_back(members[i].getID());
+        }
+
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    // answers every subtree query on the snapshot, counting wrong answers
+    struct SnapshotReader
+    {
+        const denali::ContourTreeSnapshot& snapshot;
+        const std::vector<std::vector<unsigned int> >& expected;
+        int& mismatches;
+
+        SnapshotReader(
+                const denali::ContourTreeSnapshot& snapshot,
+                const std::vector<std::vector<unsigned int> >& expected,
+                int& mismatches)
+            : snapshot(snapshot), expected(expected), mismatches(mismatches) {}
+
+        void operator()()
+        {
+            typedef denali::ContourTreeSnapshot Snapshot;
+            for (int repetition=0; repetition<100; ++repetition)
+            {
+                size_t i = 0;
+                for (denali::EdgeIterator<Snapshot> it(snapshot); !it.done(); ++it)
+                {
+                    Snapshot::Node u = snapshot.u(it.edge());
+                    Snapshot::Node v = snapshot.v(it.edge());
+                    if (subtreeMemberIDs(snapshot, u, v) != expected[i++] ||
+                        subtreeMemberIDs(snapshot, v, u) != expected[i++]) {
+                        mismatches++;
+                    }
+                }
+            }
+        }
+    };
+
+    TEST(ContourTreeSnapshot)
+    {
+        denali::concepts::checkConcept
+        <
+        denali::concepts::ContourTree,
+               denali::ContourTreeSnapshot
+               > ();
+
+        denali::ScalarSimplicialComplex plex;
+
+        for (size_t i=0; i<n_wenger_vertices; ++i) {
+            plex.addNode(wenger_vertex_values[i]);
+        }
+
+        for (size_t i=0; i<n_wenger_edges; ++i) {
+            plex.addEdge(
+                plex.getNode(wenger_edges[i][0]),
+                plex.getNode(wenger_edges[i][1]));
+        }
+
+        denali::CarrsAlgorithm alg;
+        denali::ContourTree tree = denali::ContourTree::compute(plex, alg);
+
+        typedef denali::ContourTreeSnapshot Snapshot;
+        Snapshot snapshot = Snapshot::fromContourTree(tree);
+
+        CHECK_EQUAL(tree.numberOfNodes(), snapshot.numberOfNodes());
+        CHECK_EQUAL(tree.numberOfEdges(), snapshot.numberOfEdges());
+        CHECK_EQUAL(tree.numberNodesPlusMembers(), snapshot.numberNodesPlusMembers());
+        CHECK(!snapshot.isNodeValid(snapshot.getNode(1000)));
+
+        for (denali::NodeIterator<denali::ContourTree> it(tree); !it.done(); ++it)
+        {
+            Snapshot::Node node = snapshot.getNode(tree.getID(it.node()));
+            CHECK(snapshot.isNodeValid(node));
+            CHECK_EQUAL(tree.getID(it.node()), snapshot.getID(node));
+            CHECK_EQUAL(tree.getValue(it.node()), snapshot.getValue(node));
+            CHECK_EQUAL(tree.getNodeMembers(it.node()).size(),
+                        snapshot.getNodeMembers(node).size());
+            CHECK_EQUAL(tree.degree(it.node()), snapshot.degree(node));
+        }
+
+        // every edge's members and persistence, and the subtrees on either
+        // side of it
+        std::vector<std::vector<unsigned int> > expected;
+        for (denali::EdgeIterator<denali::ContourTree> it(tree); !it.done(); ++it)
+        {
+            denali::ContourTree::Node u = tree.u(it.edge());
+            denali::ContourTree::Node v = tree.v(it.edge());
+            Snapshot::Node snapshot_u = snapshot.getNode(tree.getID(u));
+            Snapshot::Node snapshot_v = snapshot.getNode(tree.getID(v));
+
+            Snapshot::Edge edge = snapshot.findEdge(snapshot_u, snapshot_v);
+            CHECK(snapshot.isEdgeValid(edge));
+
+            const denali::ContourTree::Members& members = tree.getEdgeMembers(it.edge());
+            Snapshot::Members snapshot_members = snapshot.getEdgeMembers(edge);
+            CHECK_EQUAL(members.size(), snapshot_members.size());
+            for (size_t i=0; i<members.size() && i<snapshot_members.size(); ++i) {
+                CHECK_EQUAL(members[i].getID(), snapshot_members[i].getID());
+            }
+
+            CHECK_EQUAL(
+                denali::PersistenceSimplifier::computePersistence(tree, it.edge()),
+                snapshot.getPersistence(edge));
+
+            CHECK(subtreeMemberIDs(tree, u, v) ==
+                  subtreeMemberIDs(snapshot, snapshot_u, snapshot_v));
+            CHECK(subtreeMemberIDs(tree, v, u) ==
+                  subtreeMemberIDs(snapshot, snapshot_v, snapshot_u));
+        }
+
+        // the same queries, from several threads at once
+        for (denali::EdgeIterator<Snapshot> it(snapshot); !it.done(); ++it)
+        {
+            Snapshot::Node u = snapshot.u(it.edge());
+            Snapshot::Node v = snapshot.v(it.edge());
+            expected.push_back(subtreeMemberIDs(snapshot, u, v));
+            expected.push_back(subtreeMemberIDs(snapshot, v, u));
+        }
+
+        const int n_threads = 4;
+        std::vector<int> mismatches(n_threads, 0);
+        boost::thread_group readers;
+        for (int i=0; i<n_threads; ++i) {
+            readers.create_thread(SnapshotReader(snapshot, expected, mismatches[i]));
+        }
+        readers.join_all();
+
+        for (int i=0; i<n_threads; ++i) {
+            CHECK_EQUAL(0, mismatches[i]);
+        }
+    }
+
+    TEST(CompressedMemberList)
+    {
+        typedef denali::ContourTree::Graph::Member Member;
+
+        // deltas of either sign, and ids and values needing every byte
+        std::vector<Member> members;
+        members.push_back(Member(7, 1.5));
+        members.push_back(Member(3, -1.5));
+        members.push_back(Member(4294967295u, 1e300));
+        members.push_back(Member(0, -0.));
+        members.push_back(Member(100, 0.1));
+
+        denali::CompressedMemberList<Member> lossless;
+        denali::CompressedMemberList<Member, denali::Float32Values> single;
+        CHECK(lossless.empty());
+        CHECK(lossless.begin() == lossless.end());
+
+        lossless.insert(lossless.end(), members.begin(), members.end());
+        for (size_t i=0; i<members.size(); ++i) {
+            single.push_back(members[i]);
+        }
+
+        CHECK_EQUAL(members.size(), lossless.size());
+        CHECK_EQUAL(members.size(), single.size());
+
+        size_t i = 0;
+        denali::CompressedMemberList<Member, denali::Float32Values>::const_iterator
+            s_it = single.begin();
+        for (denali::CompressedMemberList<Member>::const_iterator it = lossless.begin();
+                it != lossless.end(); ++it, ++s_it, ++i) {
+            CHECK_EQUAL(members[i].getID(), it->getID());
+            CHECK_EQUAL(members[i].getValue(), it->getValue());
+            CHECK_EQUAL(members[i].getID(), s_it->getID());
+            CHECK_EQUAL((double) (float) members[i].getValue(), s_it->getValue());
+        }
+        CHECK_EQUAL(members.size(), i);
+        CHECK(s_it == single.end());
+
+        // only appending is allowed
+        CHECK_THROW(lossless.insert(lossless.begin(), members.begin(), members.end()),
+                    std::logic_error);
+
+        lossless.clear();
+        CHECK(lossless.empty());
+        lossless.push_back(Member(5, 2.));
+        CHECK_EQUAL(5u, lossless.begin()->getID());
+    }
+
+    TEST(CompressedContourTree)
+    {
+        denali::concepts::checkConcept
+        <
+        denali::concepts::ContourTree,
+               denali::CompressedContourTree<>
+               > ();
+
+        denali::ScalarSimplicialComplex plex;
+
+        for (size_t i=0; i<n_wenger_vertices; ++i) {
+            plex.addNode(wenger_vertex_values[i]);
+        }
+
+        for (size_t i=0; i<n_wenger_edges; ++i) {
+            plex.addEdge(plex.getNode(wenger_edges[i][0]),
+                         plex.getNode(wenger_edges[i][1]));
+        }
+
+        denali::CarrsAlgorithm carrs_algorithm;
+        denali::ContourTree ct = denali::ContourTree::compute(plex, carrs_algorithm);
+
+        denali::CompressedContourTree<> compressed =
+            denali::CompressedContourTree<>::fromContourTree(ct);
+
+        CHECK_EQUAL(ct.numberOfNodes(), compressed.numberOfNodes());
+        CHECK_EQUAL(ct.numberOfEdges(), compressed.numberOfEdges());
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), compressed.numberNodesPlusMembers());
+
+        typedef denali::CompressedContourTree<>::Members Members;
+        for (denali::EdgeIterator<denali::ContourTree> it(ct); !it.done(); ++it)
+        {
+            denali::CompressedContourTree<>::Edge edge = compressed.findEdge(
+                    compressed.getNode(ct.getID(ct.u(it.edge()))),
+                    compressed.getNode(ct.getID(ct.v(it.edge()))));
+
+            // members decode in their original order
+            const denali::ContourTree::Members& expected = ct.getEdgeMembers(it.edge());
+            const Members& members = compressed.getEdgeMembers(edge);
+            CHECK_EQUAL(expected.size(), members.size());
+
+            size_t i = 0;
+            for (Members::const_iterator m_it = members.begin();
+                    m_it != members.end() && i < expected.size(); ++m_it, ++i) {
+                CHECK_EQUAL(expected[i].getID(), m_it->getID());
+                CHECK_EQUAL(expected[i].getValue(), m_it->getValue());
+            }
+        }
+
+        // folding works on the compressed members as well
+        denali::FoldedContourTree<denali::CompressedContourTree<> > folded(compressed);
+        CHECK_EQUAL(ct.numberOfNodes(), folded.numberOfNodes());
+    }
+
+}
+
+
+SUITE(Landscape)
+{
+
+    TEST(LandscapeTree)
+    {
+        denali::ScalarSimplicialComplex plex;
+
+        for (size_t i=0; i<n_wenger_vertices; ++i) {
+            plex.addNode(wenger_vertex_values[i]);
+        }
+
+        for (size_t i=0; i<n_wenger_edges; ++i) {
+            plex.addEdge(
+                plex.getNode(wenger_edges[i][0]),
+                plex.getNode(wenger_edges[i][1]));
+        }
+
+        denali::CarrsAlgorithm alg;
+        denali::ContourTree tree =
+            denali::ContourTree::compute(plex, alg);
+
+        denali::LandscapeTree<denali::ContourTree> lscape(tree, tree.getNode(4));
+
+        denali::LandscapeWeights<denali::LandscapeTree<denali::ContourTree> > weights(lscape);
+
+        CHECK_EQUAL(12, weights.getTotalNodeWeight(lscape.getRoot()));
+
+    }
+}
+
+SUITE(RectangularLandscape)
+{
+    TEST(RectangularLandscape)
+    {
+        denali::ScalarSimplicialComplex plex;
+
+        for (size_t i=0; i<n_wenger_vertices; ++i) {
+            plex.addNode(wenger_vertex_values[i]);
+        }
+
+        for (size_t i=0; i<n_wenger_edges; ++i) {
+            plex.addEdge(
+                plex.getNode(wenger_edges[i][0]),
+                plex.getNode(wenger_edges[i][1]));
+        }
+
+        denali::CarrsAlgorithm alg;
+        denali::ContourTree tree =
+            denali::ContourTree::compute(plex, alg);
+
+        typedef denali::RectangularLandscape<denali::ContourTree> RectangularLandscape;
+        RectangularLandscape rlscape(tree, tree.getNode(4));
 
     }
 
@@ -542,6 +1624,40 @@ SUITE(RectangularLandscape)
 
 SUITE(fileio)
 {
+    // records every line given to it by a TabularFileParser
+    struct LineCollector
+    {
+        std::vector<std::vector<std::string> > lines;
+
+        void insert(const denali::TabularLine& line)
+        {
+            lines.push_back(std::vector<std::string>(line.begin(), line.end()));
+        }
+    };
+
+    TEST(TabularFileParser)
+    {
+        std::string long_field(3 << 20, 'x');
+        std::stringstream stream;
+        stream << "1\t2  3\n\n  4 \n" << long_field << "\t5\n6";
+
+        LineCollector collector;
+        denali::TabularFileParser parser;
+        parser.parse(stream, collector);
+
+        CHECK_EQUAL((size_t) 5, collector.lines.size());
+        CHECK_EQUAL((size_t) 3, collector.lines[0].size());
+        CHECK_EQUAL("3", collector.lines[0][2]);
+        CHECK_EQUAL((size_t) 0, collector.lines[1].size());
+        CHECK_EQUAL((size_t) 1, collector.lines[2].size());
+        CHECK_EQUAL("4", collector.lines[2][0]);
+        CHECK_EQUAL((size_t) 2, collector.lines[3].size());
+        CHECK(long_field == collector.lines[3][0]);
+        CHECK_EQUAL("5", collector.lines[3][1]);
+        CHECK_EQUAL((size_t) 1, collector.lines[4].size());
+        CHECK_EQUAL("6", collector.lines[4][0]);
+    }
+
     TEST(readContourTree)
     {
 
@@ -550,6 +1666,315 @@ SUITE(fileio)
         CHECK_EQUAL((size_t) 9, ct.numberOfNodes());
         CHECK_EQUAL((size_t) 8, ct.numberOfEdges());
     }
+
+    TEST(readContourTreeSnapshot)
+    {
+        denali::ContourTree ct = denali::readContourTreeFile("wenger_tree");
+        denali::ContourTreeSnapshot snapshot =
+            denali::readContourTreeSnapshotFile("wenger_tree");
+
+        CHECK_EQUAL(ct.numberOfNodes(), snapshot.numberOfNodes());
+        CHECK_EQUAL(ct.numberOfEdges(), snapshot.numberOfEdges());
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), snapshot.numberNodesPlusMembers());
+
+        for (denali::EdgeIterator<denali::ContourTree> it(ct); !it.done(); ++it)
+        {
+            denali::ContourTreeSnapshot::Edge edge = snapshot.findEdge(
+                    snapshot.getNode(ct.getID(ct.u(it.edge()))),
+                    snapshot.getNode(ct.getID(ct.v(it.edge()))));
+
+            CHECK(snapshot.isEdgeValid(edge));
+            CHECK_EQUAL(ct.getEdgeMembers(it.edge()).size(),
+                        snapshot.getEdgeMembers(edge).size());
+        }
+
+        std::stringstream not_a_tree;
+        not_a_tree << "3\n0\t1.0\n1\t2.0\n2\t3.0\n0\t1\n";
+        CHECK_THROW(denali::readContourTreeSnapshotFromStream(not_a_tree),
+                    std::runtime_error);
+    }
+
+    TEST(BinaryVertexEdgeFiles)
+    {
+        denali::BinaryVertexFileWriter vertex_writer("wenger_vertices.bin");
+        denali::readSimplicialVertexFile("wenger_vertices", vertex_writer);
+        vertex_writer.close();
+
+        denali::BinaryEdgeFileWriter edge_writer("wenger_edges.bin");
+        denali::readSimplicialEdgeFile("wenger_edges", edge_writer);
+        edge_writer.close();
+
+        CHECK(denali::isBinaryVertexFile("wenger_vertices.bin"));
+        CHECK(denali::isBinaryEdgeFile("wenger_edges.bin"));
+        CHECK(!denali::isBinaryVertexFile("wenger_vertices"));
+        CHECK(!denali::isBinaryVertexFile("wenger_edges.bin"));
+
+        denali::ScalarSimplicialComplex text;
+        denali::readSimplicialVertexFile("wenger_vertices", text);
+        denali::readSimplicialEdgeFile("wenger_edges", text);
+
+        denali::ScalarSimplicialComplex plex;
+        denali::readBinaryVertexFile("wenger_vertices.bin", plex);
+        denali::readBinaryEdgeFile("wenger_edges.bin", plex);
+
+        denali::CompactScalarSimplicialComplex compact;
+        denali::readBinaryVertexFile("wenger_vertices.bin", compact);
+        denali::readBinaryEdgeFile("wenger_edges.bin", compact);
+
+        CHECK_EQUAL(text.numberOfNodes(), plex.numberOfNodes());
+        CHECK_EQUAL(text.numberOfEdges(), plex.numberOfEdges());
+        CHECK_EQUAL(text.numberOfNodes(), compact.numberOfNodes());
+        CHECK_EQUAL(text.numberOfEdges(), compact.numberOfEdges());
+
+        for (size_t i=0; i<text.numberOfNodes(); ++i) {
+            CHECK_EQUAL(text.getValue(text.getNode(i)), plex.getValue(plex.getNode(i)));
+            CHECK_EQUAL(text.getValue(text.getNode(i)), compact.getValue(compact.getNode(i)));
+        }
+
+        // the wrong kind of file is rejected
+        CHECK_THROW(denali::readBinaryEdgeFile("wenger_vertices.bin", plex),
+                    std::runtime_error);
+    }
+
+    TEST(BinaryContourTreeFile)
+    {
+        denali::ContourTree ct = denali::readContourTreeFile("wenger_tree");
+        denali::writeBinaryContourTreeFile("wenger_tree.dtree", ct);
+
+        CHECK(denali::isBinaryContourTreeFile("wenger_tree.dtree"));
+        CHECK(!denali::isBinaryContourTreeFile("wenger_tree"));
+
+        // the binary file is detected by both readers
+        denali::ContourTree binary = denali::readContourTreeFile("wenger_tree.dtree");
+        denali::ContourTreeSnapshot snapshot =
+            denali::readContourTreeSnapshotFile("wenger_tree.dtree");
+
+        CHECK_EQUAL(ct.numberOfNodes(), binary.numberOfNodes());
+        CHECK_EQUAL(ct.numberOfEdges(), binary.numberOfEdges());
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), binary.numberNodesPlusMembers());
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), snapshot.numberNodesPlusMembers());
+
+        for (denali::NodeIterator<denali::ContourTree> it(ct); !it.done(); ++it)
+        {
+            unsigned int id = ct.getID(it.node());
+            CHECK_EQUAL(ct.getValue(it.node()), binary.getValue(binary.getNode(id)));
+            CHECK_EQUAL(ct.getValue(it.node()), snapshot.getValue(snapshot.getNode(id)));
+        }
+
+        for (denali::EdgeIterator<denali::ContourTree> it(ct); !it.done(); ++it)
+        {
+            unsigned int u = ct.getID(ct.u(it.edge()));
+            unsigned int v = ct.getID(ct.v(it.edge()));
+
+            denali::ContourTree::Edge edge = binary.findEdge(
+                    binary.getNode(u), binary.getNode(v));
+            CHECK(binary.isEdgeValid(edge));
+
+            // members are kept in order, with their exact values
+            const denali::ContourTree::Members& expected = ct.getEdgeMembers(it.edge());
+            const denali::ContourTree::Members& members = binary.getEdgeMembers(edge);
+            CHECK_EQUAL(expected.size(), members.size());
+            for (size_t i=0; i<expected.size() && i<members.size(); ++i) {
+                CHECK_EQUAL(expected[i].getID(), members[i].getID());
+                CHECK_EQUAL(expected[i].getValue(), members[i].getValue());
+            }
+
+            denali::ContourTreeSnapshot::Edge snapshot_edge = snapshot.findEdge(
+                    snapshot.getNode(u), snapshot.getNode(v));
+            CHECK_EQUAL(expected.size(), snapshot.getEdgeMembers(snapshot_edge).size());
+        }
+
+        // a truncated file is rejected
+        {
+            std::ifstream in("wenger_tree.dtree", std::ios::binary);
+            std::string bytes((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+            std::ofstream out("wenger_tree_truncated.dtree", std::ios::binary);
+            out.write(bytes.data(), bytes.size() - 8);
+        }
+        CHECK_THROW(denali::readContourTreeFile("wenger_tree_truncated.dtree"),
+                    std::runtime_error);
+
+        // so is a file whose member offsets don't start at zero
+        {
+            std::ifstream in("wenger_tree.dtree", std::ios::binary);
+            std::string bytes((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+
+            // the offsets follow the header, node IDs, node values and edges
+            size_t n_nodes = ct.numberOfNodes();
+            size_t offsets = 40 + (4*n_nodes + 7) / 8 * 8 + 8*n_nodes +
+                             8*ct.numberOfEdges();
+            bytes[offsets] = 1;
+
+            std::ofstream out("wenger_tree_bad_offsets.dtree", std::ios::binary);
+            out.write(bytes.data(), bytes.size());
+        }
+        CHECK_THROW(denali::readContourTreeFile("wenger_tree_bad_offsets.dtree"),
+                    std::runtime_error);
+        CHECK_THROW(denali::readContourTreeSnapshotFile("wenger_tree_bad_offsets.dtree"),
+                    std::runtime_error);
+    }
+
+    TEST(CompressedContourTreeFile)
+    {
+        denali::ContourTree ct = denali::readContourTreeFile("wenger_tree");
+        denali::writeBinaryContourTreeFile("wenger_tree_lossless.dtree", ct,
+                denali::BINARY_TREE_COMPRESSED_MEMBERS);
+        denali::writeBinaryContourTreeFile("wenger_tree_float32.dtree", ct,
+                denali::BINARY_TREE_COMPRESSED_MEMBERS |
+                denali::BINARY_TREE_FLOAT32_VALUES);
+
+        // float32 values must come with compressed members
+        CHECK_THROW(denali::writeBinaryContourTreeFile("wenger_tree_bad.dtree", ct,
+                    denali::BINARY_TREE_FLOAT32_VALUES), std::runtime_error);
+
+        // compressed files are read by the usual readers, and into
+        // compressed trees
+        denali::ContourTree lossless = denali::readContourTreeFile("wenger_tree_lossless.dtree");
+        denali::ContourTree float32 = denali::readContourTreeFile("wenger_tree_float32.dtree");
+        denali::CompressedContourTree<> compressed =
+            denali::readCompressedContourTreeFile<denali::LosslessValues>(
+                    "wenger_tree_lossless.dtree");
+
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), lossless.numberNodesPlusMembers());
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), float32.numberNodesPlusMembers());
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), compressed.numberNodesPlusMembers());
+
+        typedef denali::CompressedContourTree<>::Members CompressedMembers;
+        for (denali::EdgeIterator<denali::ContourTree> it(ct); !it.done(); ++it)
+        {
+            unsigned int u = ct.getID(ct.u(it.edge()));
+            unsigned int v = ct.getID(ct.v(it.edge()));
+
+            const denali::ContourTree::Members& expected = ct.getEdgeMembers(it.edge());
+            const denali::ContourTree::Members& exact = lossless.getEdgeMembers(
+                    lossless.findEdge(lossless.getNode(u), lossless.getNode(v)));
+            const denali::ContourTree::Members& rounded = float32.getEdgeMembers(
+                    float32.findEdge(float32.getNode(u), float32.getNode(v)));
+            const CompressedMembers& encoded = compressed.getEdgeMembers(
+                    compressed.findEdge(compressed.getNode(u), compressed.getNode(v)));
+
+            CHECK_EQUAL(expected.size(), exact.size());
+            CHECK_EQUAL(expected.size(), rounded.size());
+            CHECK_EQUAL(expected.size(), encoded.size());
+
+            CompressedMembers::const_iterator e_it = encoded.begin();
+            for (size_t i=0; i<expected.size() && i<exact.size() &&
+                    i<rounded.size() && e_it != encoded.end(); ++i, ++e_it) {
+                CHECK_EQUAL(expected[i].getID(), exact[i].getID());
+                CHECK_EQUAL(expected[i].getValue(), exact[i].getValue());
+                CHECK_EQUAL(expected[i].getID(), rounded[i].getID());
+                CHECK_EQUAL((double) (float) expected[i].getValue(), rounded[i].getValue());
+                CHECK_EQUAL(expected[i].getID(), e_it->getID());
+                CHECK_EQUAL(expected[i].getValue(), e_it->getValue());
+            }
+        }
+
+        // the text file can be read into a compressed tree too
+        denali::CompressedContourTree<denali::Float32Values> from_text =
+            denali::readCompressedContourTreeFile<denali::Float32Values>("wenger_tree");
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), from_text.numberNodesPlusMembers());
+
+        // a truncated file is rejected
+        {
+            std::ifstream in("wenger_tree_lossless.dtree", std::ios::binary);
+            std::string bytes((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+            std::ofstream out("wenger_tree_truncated.dtree", std::ios::binary);
+            out.write(bytes.data(), bytes.size() - 1);
+        }
+        CHECK_THROW(denali::readContourTreeFile("wenger_tree_truncated.dtree"),
+                    std::runtime_error);
+
+        // a varint too long for its type is rejected
+        std::vector<unsigned char> overlong(12, 0xff);
+        overlong.push_back(0x01);
+        boost::uint64_t bits = 0;
+        boost::uint32_t id = 0;
+        CHECK_THROW(denali::readVarintDelta(&overlong[0], bits), std::runtime_error);
+        CHECK_THROW(denali::readVarintDelta(&overlong[0], id), std::runtime_error);
+    }
+
+    TEST(LazyContourTreeFile)
+    {
+        denali::concepts::checkConcept
+        <
+        denali::concepts::ContourTree,
+               denali::LazyContourTree
+               > ();
+
+        denali::ContourTree ct = denali::readContourTreeFile("wenger_tree");
+        denali::LazyContourTree lazy = denali::readLazyContourTreeFile("wenger_tree");
+
+        CHECK_EQUAL(ct.numberOfNodes(), lazy.numberOfNodes());
+        CHECK_EQUAL(ct.numberOfEdges(), lazy.numberOfEdges());
+        CHECK_EQUAL(ct.numberNodesPlusMembers(), lazy.numberNodesPlusMembers());
+
+        typedef denali::LazyContourTree::Members Members;
+        for (denali::EdgeIterator<denali::ContourTree> it(ct); !it.done(); ++it)
+        {
+            denali::LazyContourTree::Edge edge = lazy.findEdge(
+                    lazy.getNode(ct.getID(ct.u(it.edge()))),
+                    lazy.getNode(ct.getID(ct.v(it.edge()))));
+
+            const denali::ContourTree::Members& expected = ct.getEdgeMembers(it.edge());
+            const Members& members = lazy.getEdgeMembers(edge);
+
+            // the members are counted, but not read, until they're iterated over
+            CHECK_EQUAL(expected.size(), members.size());
+            CHECK_EQUAL(!expected.empty(), members.isPending());
+
+            size_t i = 0;
+            for (Members::const_iterator m_it = members.begin();
+                    m_it != members.end() && i < expected.size(); ++m_it, ++i) {
+                CHECK_EQUAL(expected[i].getID(), m_it->getID());
+                CHECK_EQUAL(expected[i].getValue(), m_it->getValue());
+            }
+            CHECK_EQUAL(expected.size(), i);
+            CHECK(!members.isPending());
+        }
+
+        // a malformed member is reported when the edge is read
+        {
+            std::ofstream out("wenger_tree_malformed");
+            out << "2\n0\t1.0\n1\t2.0\n0\t1\t2\tnonsense\n";
+        }
+        denali::LazyContourTree malformed =
+            denali::readLazyContourTreeFile("wenger_tree_malformed");
+        CHECK_EQUAL(1u, malformed.getEdgeMembers(malformed.getFirstEdge()).size());
+        CHECK_THROW(malformed.loadMembers(), std::runtime_error);
+
+        // a failed read keeps none of the members, and is tried again
+        {
+            std::ofstream out("wenger_tree_malformed");
+            out << "2\n0\t1.0\n1\t2.0\n0\t1\t2\t1.5\t3\tnonsense\n";
+        }
+        denali::LazyContourTree partial =
+            denali::readLazyContourTreeFile("wenger_tree_malformed");
+        const Members& partial_members =
+            partial.getEdgeMembers(partial.getFirstEdge());
+        CHECK_THROW(partial.loadMembers(), std::runtime_error);
+        CHECK(partial_members.isPending());
+        CHECK_THROW(partial.loadMembers(), std::runtime_error);
+        CHECK(partial_members.isPending());
+
+        // blank lines after the edges are skipped by both readers
+        {
+            std::ofstream out("wenger_tree_blank");
+            out << "2\n0\t1.0\n1\t2.0\n0\t1\t2\t1.5\n\n \t\n";
+        }
+        denali::ContourTree blank = denali::readContourTreeFile("wenger_tree_blank");
+        denali::LazyContourTree lazy_blank =
+            denali::readLazyContourTreeFile("wenger_tree_blank");
+        CHECK_EQUAL(1u, blank.numberOfEdges());
+        CHECK_EQUAL(1u, lazy_blank.numberOfEdges());
+
+        const Members& blank_members =
+            lazy_blank.getEdgeMembers(lazy_blank.getFirstEdge());
+        CHECK_EQUAL(1u, blank_members.size());
+        CHECK_EQUAL(2u, blank_members.begin()->getID());
+    }
 }
 
 
@@ -633,6 +2058,133 @@ SUITE(Simplify)
     }
 
 
+    TEST(StaleQueueEntry)
+    {
+        /*
+                  4   5
+                   \ /
+                    3   2
+                     \ /
+                      1
+                      |
+                      0
+        */
+        // 5 is pruned first, and 3 is reduced, so 4's edge now runs to 1
+        // and is more persistent than the threshold. 4 was queued with its
+        // old edge, and that entry mustn't prune it
+        typedef denali::UndirectedScalarMemberIDGraph Graph;
+        typedef Graph::Node Node;
+        typedef denali::FoldedContourTree<denali::ContourTree> FoldedContourTree;
+
+        boost::shared_ptr<Graph> graph =
+                boost::shared_ptr<Graph>(new Graph);
+
+        Node n0 = graph->addNode(0,-10);
+        Node n1 = graph->addNode(1,0);
+        Node n2 = graph->addNode(2,100);
+        Node n3 = graph->addNode(3,5);
+        Node n4 = graph->addNode(4,7);
+        Node n5 = graph->addNode(5,6);
+
+        graph->addEdge(n0, n1);
+        graph->addEdge(n1, n2);
+        graph->addEdge(n1, n3);
+        graph->addEdge(n3, n4);
+        graph->addEdge(n3, n5);
+
+        denali::ContourTree contour_tree = denali::ContourTree::fromPrecomputed(graph);
+        FoldedContourTree folded_tree(contour_tree);
+
+        denali::PersistenceSimplifier simplifier(3);
+        simplifier.simplify(folded_tree);
+
+        std::set<unsigned int> ids;
+        for (denali::NodeIterator<FoldedContourTree> it(folded_tree);
+                !it.done(); ++it) {
+            ids.insert(folded_tree.getID(it.node()));
+        }
+
+        CHECK_EQUAL((size_t) 4, ids.size());
+        CHECK(ids.count(4));
+        CHECK(!ids.count(3));
+        CHECK(!ids.count(5));
+    }
+
+
+    TEST(PersistenceHierarchy)
+    {
+        typedef denali::UndirectedScalarMemberIDGraph Graph;
+        typedef denali::FoldedContourTree<denali::ContourTree> FoldedContourTree;
+
+        boost::shared_ptr<Graph> graph = makeRandomTree(300, 7);
+        denali::ContourTree contour_tree = denali::ContourTree::fromPrecomputed(graph);
+
+        FoldedContourTree folded_tree(contour_tree);
+        denali::PersistenceHierarchy hierarchy;
+        hierarchy.compute(folded_tree);
+
+        CHECK(hierarchy.numberOfSteps() > 0);
+        CHECK_EQUAL(hierarchy.numberOfSteps(), hierarchy.numberOfAppliedSteps());
+
+        // down to nothing, then back up, comparing with a fresh 
+        // simplification each time
+        double thresholds[] = { 60, 20, 5, 0, 3, 40, 100, 10 };
+        for (size_t i=0; i<sizeof(thresholds)/sizeof(double); ++i)
+        {
+            hierarchy.simplify(folded_tree, thresholds[i]);
+
+            FoldedContourTree expected(contour_tree);
+            denali::PersistenceSimplifier simplifier(thresholds[i]);
+            simplifier.simplify(expected);
+
+            CHECK(foldedTreeSignature(expected) == foldedTreeSignature(folded_tree));
+            CHECK_EQUAL(expected.numberOfNodes(), folded_tree.numberOfNodes());
+            CHECK_EQUAL(expected.numberOfNodes(), 
+                        hierarchy.numberOfNodesAt(thresholds[i]));
+        }
+
+        // nothing changes when the threshold doesn't cross a step
+        CHECK_EQUAL((size_t) 0, hierarchy.simplify(folded_tree, 10));
+
+        CHECK(hierarchy.numberOfCollapsedMembersAt(0) <=
+              hierarchy.numberOfCollapsedMembersAt(100));
+        CHECK_THROW(hierarchy.numberOfStepsAt(-1), std::runtime_error);
+    }
+
+    TEST(SubtreePersistenceHierarchy)
+    {
+        typedef denali::UndirectedScalarMemberIDGraph Graph;
+        typedef denali::FoldedContourTree<denali::ContourTree> FoldedContourTree;
+        typedef FoldedContourTree::Node Node;
+
+        boost::shared_ptr<Graph> graph = makeRandomTree(300, 11);
+        denali::ContourTree contour_tree = denali::ContourTree::fromPrecomputed(graph);
+
+        // the subtree hanging off of node 0 through its first neighbor
+        FoldedContourTree folded_tree(contour_tree);
+        Node parent = folded_tree.getNode(0);
+        Node pivot = denali::UndirectedNeighborIterator<FoldedContourTree>(
+                folded_tree, parent).neighbor();
+        unsigned int pivot_id = folded_tree.getID(pivot);
+
+        denali::PersistenceHierarchy hierarchy;
+        hierarchy.computeSubtree(folded_tree, parent, pivot);
+
+        double thresholds[] = { 50, 2, 30, 0, 100 };
+        for (size_t i=0; i<sizeof(thresholds)/sizeof(double); ++i)
+        {
+            hierarchy.simplify(folded_tree, thresholds[i]);
+
+            FoldedContourTree expected(contour_tree);
+            denali::PersistenceSimplifier simplifier(thresholds[i]);
+            simplifier.simplifySubtree(expected, expected.getNode(0),
+                                       expected.getNode(pivot_id));
+
+            CHECK(foldedTreeSignature(expected) == foldedTreeSignature(folded_tree));
+        }
+    }
+
+
 
 }
 
@@ -733,6 +2285,222 @@ SUITE(Folded)
         Edge e37 = folded_tree.findEdge(folded_tree.getNode(3), folded_tree.getNode(7));
         CHECK_EQUAL((size_t) 3, folded_tree.getEdgeMembers(e37).size());
 
+        // compacting releases the removed slots, but keeps the folds intact
+        size_t n_nodes = folded_tree.numberOfNodes();
+        folded_tree.compact();
+        CHECK_EQUAL(n_nodes, (size_t) folded_tree.getMaxNodeIdentifier());
+
+        e37 = folded_tree.findEdge(folded_tree.getNode(3), folded_tree.getNode(7));
+        CHECK_EQUAL((size_t) 3, folded_tree.getEdgeMembers(e37).size());
+        CHECK(!folded_tree.isNodeValid(folded_tree.getNode(10)));
+
+        Node n10 = folded_tree.unreduce(e37);
+        CHECK_EQUAL(10u, folded_tree.getID(n10));
+        CHECK_EQUAL((size_t) 2, folded_tree.getNodeMembers(n10).size());
+
+        folded_tree.uncollapse(n10);
+        CHECK_EQUAL((size_t) 1, folded_tree.getNodeMembers(folded_tree.getNode(10)).size());
+        CHECK_EQUAL((size_t) 1, folded_tree.getNodeMembers(folded_tree.getNode(9)).size());
+    }
+
+    TEST(LazyFoldedContourTree)
+    {
+        denali::ScalarSimplicialComplex plex;
+
+        for (size_t i=0; i<n_wenger_vertices; ++i) {
+            plex.addNode(wenger_vertex_values[i]);
+        }
+
+        for (size_t i=0; i<n_wenger_edges; ++i) {
+            plex.addEdge(
+                plex.getNode(wenger_edges[i][0]),
+                plex.getNode(wenger_edges[i][1]));
+        }
+
+        typedef denali::ContourTree ContourTree;
+
+        denali::CarrsAlgorithm alg;
+        ContourTree tree = ContourTree::compute(plex, alg);
+
+        typedef denali::FoldedContourTree<ContourTree, denali::LazyMaps>
+                FoldedContourTree;
+
+        FoldedContourTree folded_tree(tree);
+        denali::LazyEdgeMap<FoldedContourTree, double> weights(folded_tree);
+
+        typedef FoldedContourTree::Node Node;
+        typedef FoldedContourTree::Edge Edge;
+
+        Node n9 = folded_tree.getNode(9);
+        Node n10 = folded_tree.getNode(10);
+
+        folded_tree.collapse(folded_tree.findEdge(n9, n10));
+        folded_tree.reduce(n10);
+
+        Edge e37 = folded_tree.findEdge(folded_tree.getNode(3), folded_tree.getNode(7));
+        weights[e37] = 2.5;
+        CHECK_EQUAL((size_t) 3, folded_tree.getEdgeMembers(e37).size());
+        CHECK_CLOSE(2.5, weights[e37], 1e-12);
+
+        // the tree's own lazy fold maps are remapped by compact()
+        folded_tree.compact();
+
+        e37 = folded_tree.findEdge(folded_tree.getNode(3), folded_tree.getNode(7));
+        CHECK_EQUAL((size_t) 3, folded_tree.getEdgeMembers(e37).size());
+        CHECK_THROW(weights[e37], std::runtime_error);
+
+        n10 = folded_tree.unreduce(e37);
+        CHECK_EQUAL(10u, folded_tree.getID(n10));
+        CHECK_EQUAL((size_t) 2, folded_tree.getNodeMembers(n10).size());
+
+        folded_tree.uncollapse(n10);
+        CHECK_EQUAL((size_t) 1, folded_tree.getNodeMembers(folded_tree.getNode(10)).size());
+        CHECK_EQUAL((size_t) 1, folded_tree.getNodeMembers(folded_tree.getNode(9)).size());
+    }
+
+    TEST(FoldedMembersCoverTree)
+    {
+        typedef denali::UndirectedScalarMemberIDGraph Graph;
+        typedef denali::ContourTree ContourTree;
+        typedef denali::FoldedContourTree<ContourTree> FoldedContourTree;
+        typedef FoldedContourTree::Members Members;
+
+        boost::shared_ptr<Graph> graph = makeRandomTree(300, 3);
+        ContourTree contour_tree = ContourTree::fromPrecomputed(graph);
+
+        // every node and member of the contour tree
+        std::vector<unsigned int> expected;
+        for (denali::NodeIterator<ContourTree> it(contour_tree); !it.done(); ++it) {
+            const ContourTree::Members& members = contour_tree.getNodeMembers(it.node());
+            for (ContourTree::Members::const_iterator m_it = members.begin();
+                    m_it != members.end(); ++m_it) {
+                expected.push_back(m_it->getID());
+            }
+        }
+        for (denali::EdgeIterator<ContourTree> it(contour_tree); !it.done(); ++it) {
+            const ContourTree::Members& members = contour_tree.getEdgeMembers(it.edge());
+            for (ContourTree::Members::const_iterator m_it = members.begin();
+                    m_it != members.end(); ++m_it) {
+                expected.push_back(m_it->getID());
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+
+        FoldedContourTree folded_tree(contour_tree);
+        denali::PersistenceHierarchy hierarchy;
+        hierarchy.compute(folded_tree);
+
+        // however the tree is folded, the visible nodes and edges hold each
+        // member exactly once
+        double thresholds[] = { 100, 0, 30, 60, 10 };
+        for (size_t i=0; i<sizeof(thresholds)/sizeof(double); ++i)
+        {
+            hierarchy.simplify(folded_tree, thresholds[i]);
+
+            std::vector<unsigned int> ids;
+            for (denali::NodeIterator<FoldedContourTree> it(folded_tree); !it.done(); ++it) {
+                const Members& members = folded_tree.getNodeMembers(it.node());
+                size_t n = 0;
+                for (Members::const_iterator m_it = members.begin();
+                        m_it != members.end(); ++m_it, ++n) {
+                    ids.push_back(m_it->getID());
+                }
+                CHECK_EQUAL(members.size(), n);
+            }
+            for (denali::EdgeIterator<FoldedContourTree> it(folded_tree); !it.done(); ++it) {
+                const Members& members = folded_tree.getEdgeMembers(it.edge());
+                size_t n = 0;
+                for (Members::const_iterator m_it = members.begin();
+                        m_it != members.end(); ++m_it, ++n) {
+                    ids.push_back(m_it->getID());
+                }
+                CHECK_EQUAL(members.size(), n);
+            }
+
+            std::sort(ids.begin(), ids.end());
+            CHECK(expected == ids);
+        }
+    }
+
+    TEST(FoldTreeReusesFolds)
+    {
+        denali::FoldTree tree;
+        typedef denali::FoldTree::Node Node;
+        typedef denali::FoldTree::Edge Edge;
+
+        // 0 -- 1 -- 2 -- 3, with a leaf 4 hanging off of 1
+        std::vector<Node> nodes;
+        for (int i=0; i<5; ++i) {
+            nodes.push_back(tree.addNode());
+        }
+        tree.addEdge(nodes[0], nodes[1]);
+        tree.addEdge(nodes[1], nodes[2]);
+        tree.addEdge(nodes[2], nodes[3]);
+        Edge e14 = tree.addEdge(nodes[1], nodes[4]);
+
+        tree.collapse(e14);
+        CHECK(!tree.isNodeValid(nodes[4]));
+        Edge e02 = tree.reduce(nodes[1]);
+        CHECK(tree.findEdge(nodes[0], nodes[2]) == e02);
+        Edge e03 = tree.reduce(nodes[2]);
+        CHECK(tree.findEdge(nodes[0], nodes[3]) == e03);
+
+        size_t n_edge_folds = tree.numberOfEdgeFolds();
+        size_t max_node = tree.getMaxNodeIdentifier();
+        size_t max_edge = tree.getMaxEdgeIdentifier();
+
+        // unfolding and folding again makes no new folds, nodes or edges
+        for (int i=0; i<3; ++i)
+        {
+            CHECK(tree.unreduce(e03) == nodes[2]);
+            CHECK(tree.unreduce(e02) == nodes[1]);
+            CHECK(tree.uncollapse(nodes[1]) == e14);
+            CHECK_EQUAL(5u, tree.numberOfNodes());
+            CHECK_EQUAL(4u, tree.numberOfEdges());
+
+            tree.collapse(e14);
+            CHECK(tree.reduce(nodes[1]) == e02);
+            CHECK(tree.reduce(nodes[2]) == e03);
+
+            CHECK_EQUAL(n_edge_folds, tree.numberOfEdgeFolds());
+            CHECK_EQUAL(max_node, (size_t) tree.getMaxNodeIdentifier());
+            CHECK_EQUAL(max_edge, (size_t) tree.getMaxEdgeIdentifier());
+        }
+
+        tree.unreduce(e03);
+        tree.unreduce(e02);
+        tree.uncollapse(nodes[1]);
+
+        // a node reduced between other neighbors than before reuses its
+        // fold, too
+        Edge e13 = tree.reduce(nodes[2]);
+        CHECK(tree.findEdge(nodes[1], nodes[3]) == e13);
+        CHECK_EQUAL(n_edge_folds, tree.numberOfEdgeFolds());
+        tree.unreduce(e13);
+        CHECK_EQUAL(2u, tree.degree(nodes[2]));
+
+        // after compacting, the hidden nodes and edges are given new slots
+        tree.collapse(e14);
+        tree.reduce(nodes[1]);
+        tree.compact();
+        CHECK_EQUAL(3u, tree.getMaxNodeIdentifier());
+        CHECK_EQUAL(2u, tree.getMaxEdgeIdentifier());
+
+        Edge reduced = tree.getFirstEdge();
+        if (!tree.hasReduced(tree.getEdgeFold(reduced))) {
+            reduced = tree.getNextEdge(reduced);
+        }
+
+        Node n1 = tree.unreduce(reduced);
+        tree.uncollapse(n1);
+        CHECK_EQUAL(5u, tree.numberOfNodes());
+        CHECK_EQUAL(4u, tree.numberOfEdges());
+        CHECK_EQUAL(3u, tree.degree(n1));
+
+        // the reduced edge is hidden, keeping its slot for the next
+        // reduction of n1
+        CHECK_EQUAL(5u, tree.getMaxNodeIdentifier());
+        CHECK_EQUAL(5u, tree.getMaxEdgeIdentifier());
     }
 
     TEST(FoldIterator)